@@ -18,6 +18,7 @@
 */
 
 #include <math.h>
+#include <string.h>
 #include <gtk/gtk.h>
 
 #include <wdsp.h>
@@ -180,6 +181,24 @@ void bpsk_add_iq_samples(BPSK *bpsk,double i_sample,double q_sample) {
   }
 }
 
+void bpsk_add_iq_block(BPSK *bpsk,double *iq,int count) {
+  int n;
+  while(count>0) {
+    n=bpsk->buffer_size-bpsk->samples;
+    if(n>count) n=count;
+    memcpy(&bpsk->input_buffer[bpsk->samples*2],iq,n*2*sizeof(double));
+    bpsk->samples+=n;
+    iq+=n*2;
+    count-=n;
+    if(bpsk->samples>=bpsk->buffer_size) {
+      g_mutex_lock(&bpsk->mutex);
+      Spectrum0(1, bpsk->channel, 0, 0, bpsk->input_buffer);
+      g_mutex_unlock(&bpsk->mutex);
+      bpsk->samples=0;
+    }
+  }
+}
+
 BPSK *create_bpsk(int channel,int band) {
   BPSK *bpsk=g_new0(BPSK,1);
 
@@ -39,5 +39,6 @@ typedef struct _bpsk {
 extern BPSK *create_bpsk(int channel,int band);
 extern void destroy_bpsk(BPSK *bpsk);
 extern void bpsk_add_iq_samples(BPSK *bpsk,double i_sample,double q_sample);
+extern void bpsk_add_iq_block(BPSK *bpsk,double *iq,int count);
 
 #endif
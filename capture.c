@@ -0,0 +1,301 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "capture.h"
+
+#define CAPTURE_FILE_BUFFER (1024*1024)
+
+char *capture_filename=NULL;
+char *replay_filename=NULL;
+gboolean replay_fast=FALSE;
+
+static gboolean read_header(FILE *file,CAPTURE_HEADER *header) {
+  if(fread(header,sizeof(CAPTURE_HEADER),1,file)!=1) {
+    return FALSE;
+  }
+  if(memcmp(header->magic,CAPTURE_MAGIC,sizeof(header->magic))!=0 || header->version!=CAPTURE_VERSION) {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+CAPTURE *capture_new(const char *filename,DISCOVERED *d) {
+  CAPTURE *capture;
+  FILE *file=fopen(filename,"wb");
+  if(file==NULL) {
+    fprintf(stderr,"capture_new: cannot create %s: %s\n",filename,strerror(errno));
+    return NULL;
+  }
+  setvbuf(file,NULL,_IOFBF,CAPTURE_FILE_BUFFER);
+
+  capture=g_new0(CAPTURE,1);
+  capture->file=file;
+  capture->replay=FALSE;
+  memcpy(capture->header.magic,CAPTURE_MAGIC,sizeof(capture->header.magic));
+  capture->header.version=CAPTURE_VERSION;
+  capture->header.protocol=d->protocol;
+  capture->header.device=d->device;
+  capture->header.supported_receivers=d->supported_receivers;
+  capture->header.supported_transmitters=d->supported_transmitters;
+  capture->header.adcs=d->adcs;
+  capture->header.frequency_min=d->frequency_min;
+  capture->header.frequency_max=d->frequency_max;
+  g_strlcpy(capture->header.name,d->name,sizeof(capture->header.name));
+  g_strlcpy(capture->header.software_version,d->software_version,sizeof(capture->header.software_version));
+  fwrite(&capture->header,sizeof(CAPTURE_HEADER),1,file);
+  capture->start_time=-1;
+  fprintf(stderr,"capture_new: capturing to %s\n",filename);
+  return capture;
+}
+
+//
+// append the first count datagrams of the last batch
+// they all get the time the batch was returned
+//
+void capture_packets(CAPTURE *capture,UDP_BATCH *batch,int count) {
+  CAPTURE_RECORD record;
+  gint64 now=g_get_monotonic_time();
+  int i;
+
+  if(capture->start_time<0) {
+    capture->start_time=now;
+  }
+  memset(&record,0,sizeof(record));
+  record.time=now-capture->start_time;
+  for(i=0;i<count;i++) {
+    PACKET *packet=batch->packets[i];
+    record.port=packet->port;
+    record.length=packet->length;
+    fwrite(&record,sizeof(record),1,capture->file);
+    fwrite(packet->buffer,1,packet->length,capture->file);
+    capture->packets++;
+    capture->bytes+=packet->length;
+  }
+}
+
+//
+// check every record once so a bad capture is reported here rather than
+// on every pass, a truncated last record is left out of the replay
+//
+static gboolean replay_scan(CAPTURE *replay,const char *filename,int buffer_size) {
+  CAPTURE_RECORD record;
+  long position=replay->data_offset;
+  glong records=0;
+
+  while(fread(&record,sizeof(record),1,replay->file)==1) {
+    if(record.length>buffer_size) {
+      fprintf(stderr,"replay_new: %s: %d byte record too large for %d byte buffer\n",filename,record.length,buffer_size);
+      return FALSE;
+    }
+    if(fseek(replay->file,record.length,SEEK_CUR)!=0 || ftell(replay->file)>replay->file_length) {
+      break;
+    }
+    position+=sizeof(record)+record.length;
+    records++;
+  }
+  if(position!=replay->file_length) {
+    fprintf(stderr,"replay_new: %s: ignoring %ld bytes after the last complete record\n",filename,replay->file_length-position);
+  }
+  if(records==0) {
+    fprintf(stderr,"replay_new: %s has no packets\n",filename);
+    return FALSE;
+  }
+  replay->data_end=position;
+  replay->records=records;
+  fseek(replay->file,replay->data_offset,SEEK_SET);
+  return TRUE;
+}
+
+CAPTURE *replay_new(const char *filename,gboolean fast,int buffer_size) {
+  CAPTURE *replay;
+  FILE *file=fopen(filename,"rb");
+  if(file==NULL) {
+    fprintf(stderr,"replay_new: cannot open %s: %s\n",filename,strerror(errno));
+    return NULL;
+  }
+  setvbuf(file,NULL,_IOFBF,CAPTURE_FILE_BUFFER);
+
+  replay=g_new0(CAPTURE,1);
+  replay->file=file;
+  replay->replay=TRUE;
+  replay->fast=fast;
+  if(!read_header(file,&replay->header)) {
+    fprintf(stderr,"replay_new: %s is not a capture file\n",filename);
+    fclose(file);
+    g_free(replay);
+    return NULL;
+  }
+  replay->data_offset=ftell(file);
+  fseek(file,0,SEEK_END);
+  replay->file_length=ftell(file);
+  fseek(file,replay->data_offset,SEEK_SET);
+  if(!replay_scan(replay,filename,buffer_size)) {
+    fclose(file);
+    g_free(replay);
+    return NULL;
+  }
+  replay->position=replay->data_offset;
+  replay->start_time=-1;
+  fprintf(stderr,"replay_new: replaying %ld packets from %s (%s)\n",replay->records,filename,fast?"maximum speed":"real time");
+  return replay;
+}
+
+//
+// read the next record header, rewinding to the start of the data at the
+// end of the file so a capture can be replayed for as long as needed
+//
+static gboolean replay_peek(CAPTURE *replay) {
+  if(replay->have_next) return TRUE;
+  if(replay->position>=replay->data_end) {
+    if(replay->start_time>=0) {
+      gint64 elapsed=g_get_monotonic_time()-replay->start_time;
+      replay->passes++;
+      fprintf(stderr,"replay: pass %ld: %ld packets %ld bytes in %ld usec (%.1f Mbit/s)\n",
+              replay->passes,replay->packets,replay->bytes,(long)elapsed,
+              elapsed>0?(double)replay->bytes*8.0/(double)elapsed:0.0);
+    }
+    replay->packets=0;
+    replay->bytes=0;
+    replay->start_time=-1;
+    fseek(replay->file,replay->data_offset,SEEK_SET);
+    replay->position=replay->data_offset;
+  }
+  if(fread(&replay->next,sizeof(CAPTURE_RECORD),1,replay->file)!=1) {
+    return FALSE;
+  }
+  replay->position+=sizeof(CAPTURE_RECORD);
+  replay->have_next=TRUE;
+  return TRUE;
+}
+
+//
+// fill the batch from the capture as udp_batch_receive() would from a
+// socket: at least one datagram, plus any others that are already due
+// in real time mode datagrams are released at their captured times
+// returns the number of datagrams or -1 if the file can no longer be read,
+// replay_new() has already checked the records
+//
+int replay_receive(CAPTURE *replay,UDP_BATCH *batch) {
+  int slots;
+  int count=0;
+  gint64 now;
+
+  slots=udp_batch_refill(batch);
+  if(slots==0) {
+    batch->count=0;
+    batch->dropped++;
+    return 0;
+  }
+
+  while(count<slots) {
+    PACKET *packet=batch->packets[count];
+    if(!replay_peek(replay)) {
+      errno=EIO;
+      batch->count=0;
+      return -1;
+    }
+    if(replay->start_time<0) {
+      replay->start_time=g_get_monotonic_time()-replay->next.time;
+    }
+    if(!replay->fast) {
+      now=g_get_monotonic_time();
+      if(replay->start_time+replay->next.time>now) {
+        if(count>0) break;
+        g_usleep(replay->start_time+replay->next.time-now);
+      }
+    }
+    if(fread(packet->buffer,1,replay->next.length,replay->file)!=replay->next.length) {
+      errno=EIO;
+      batch->count=0;
+      return -1;
+    }
+    replay->position+=replay->next.length;
+    packet->length=replay->next.length;
+    packet->port=replay->next.port;
+    replay->have_next=FALSE;
+    replay->packets++;
+    replay->bytes+=packet->length;
+    count++;
+  }
+  batch->count=count;
+  return count;
+}
+
+//
+// make the radio described by a capture file the only discovered device
+//
+gboolean replay_discovery(const char *filename) {
+  CAPTURE_HEADER header;
+  DISCOVERED *d;
+  FILE *file=fopen(filename,"rb");
+  if(file==NULL) {
+    fprintf(stderr,"replay_discovery: cannot open %s: %s\n",filename,strerror(errno));
+    return FALSE;
+  }
+  if(!read_header(file,&header)) {
+    fprintf(stderr,"replay_discovery: %s is not a capture file\n",filename);
+    fclose(file);
+    return FALSE;
+  }
+  fclose(file);
+
+  d=&discovered[devices];
+  memset(d,0,sizeof(DISCOVERED));
+  d->protocol=header.protocol;
+  d->device=header.device;
+  g_strlcpy(d->name,header.name,sizeof(d->name));
+  g_strlcpy(d->software_version,header.software_version,sizeof(d->software_version));
+  d->status=STATE_AVAILABLE;
+  d->supported_receivers=header.supported_receivers;
+  d->supported_transmitters=header.supported_transmitters;
+  d->adcs=header.adcs;
+  d->frequency_min=header.frequency_min;
+  d->frequency_max=header.frequency_max;
+
+  // anything sent to the "radio" goes to the discard port on loopback
+  d->info.network.address.sin_family=AF_INET;
+  d->info.network.address.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+  d->info.network.address.sin_port=htons(9);
+  d->info.network.address_length=sizeof(struct sockaddr_in);
+  d->info.network.interface_address.sin_family=AF_INET;
+  d->info.network.interface_address.sin_addr.s_addr=htonl(INADDR_ANY);
+  d->info.network.interface_address.sin_port=htons(0);
+  d->info.network.interface_length=sizeof(struct sockaddr_in);
+  d->info.network.interface_netmask.sin_family=AF_INET;
+  g_strlcpy(d->info.network.interface_name,"replay",sizeof(d->info.network.interface_name));
+  devices++;
+  return TRUE;
+}
+
+void capture_free(CAPTURE *capture) {
+  if(capture==NULL) return;
+  if(!capture->replay) {
+    fprintf(stderr,"capture: %ld packets %ld bytes\n",capture->packets,capture->bytes);
+  }
+  fclose(capture->file);
+  g_free(capture);
+}
@@ -0,0 +1,87 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+
+#include "discovered.h"
+#include "udp_batch.h"
+
+#define CAPTURE_MAGIC "LHSDRCAP"
+#define CAPTURE_VERSION 1
+
+//
+// capture file layout: a CAPTURE_HEADER describing the radio followed by
+// one CAPTURE_RECORD per datagram, each followed by length bytes of data
+// all values are in host byte order
+//
+typedef struct _capture_header {
+  char magic[8];
+  gint32 version;
+  gint32 protocol;
+  gint32 device;
+  gint32 supported_receivers;
+  gint32 supported_transmitters;
+  gint32 adcs;
+  gdouble frequency_min;
+  gdouble frequency_max;
+  char name[64];
+  char software_version[128];
+} CAPTURE_HEADER;
+
+typedef struct _capture_record {
+  gint64 time; // usec since the first datagram
+  guint16 port;
+  guint16 length;
+  guint32 reserved;
+} CAPTURE_RECORD;
+
+typedef struct _capture {
+  FILE *file;
+  gboolean replay;
+  gboolean fast;
+  CAPTURE_HEADER header;
+  long data_offset;
+  long data_end;
+  long file_length;
+  long position;
+  glong records;
+  gint64 start_time;
+  gboolean have_next;
+  CAPTURE_RECORD next;
+  glong packets;
+  glong bytes;
+  glong passes;
+} CAPTURE;
+
+extern char *capture_filename;
+extern char *replay_filename;
+extern gboolean replay_fast;
+
+extern CAPTURE *capture_new(const char *filename,DISCOVERED *d);
+extern void capture_packets(CAPTURE *capture,UDP_BATCH *batch,int count);
+extern CAPTURE *replay_new(const char *filename,gboolean fast,int buffer_size);
+extern int replay_receive(CAPTURE *replay,UDP_BATCH *batch);
+extern gboolean replay_discovery(const char *filename);
+extern void capture_free(CAPTURE *capture);
+
+#endif
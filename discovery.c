@@ -27,6 +27,7 @@
 #include "discovery.h"
 #include "protocol1_discovery.h"
 #include "protocol2_discovery.h"
+#include "capture.h"
 #ifdef SOAPYSDR
 #include "soapy_discovery.h"
 #endif
@@ -34,6 +35,10 @@
 void discovery() {
 g_print("discovery\n");
   devices=0;
+  if(replay_filename!=NULL) {
+    replay_discovery(replay_filename);
+    return;
+  }
   protocol1_discovery();
   protocol2_discovery();
 #ifdef SOAPYSDR
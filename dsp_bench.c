@@ -0,0 +1,959 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+//
+// Headless benchmark of the receive -> DSP -> audio pipeline. For each
+// sample rate and receiver count it opens the WDSP channels with the
+// settings create_receiver() gives a new receiver and feeds 24 bit I/Q
+// (synthetic, or taken from a capture file) through add_iq_block(). From
+// there the blocks take the receiver's own path in receiver_dsp.c: the
+// IQ_RING, receiver_dsp_task() on the DSP pool, fexchange0/Spectrum0 and
+// the audio of the active receiver handed to protocol2_audio_block(), which
+// the bench stands in for. One JSON object is written per run so results
+// can be compared between versions.
+//
+// make bench
+// ./dsp_bench -r 192000,384000 -n 1,4 -s 5 -o results.json
+// ./dsp_bench -i capture.lhc -f                (replayed I/Q, maximum speed)
+//
+// With -O the Protocol 1 ozy frames in a capture are run through
+// ozy_frame_parse() and add_iq_block(), as the Protocol 1 receive thread
+// does, and through the byte at a time state machine they replaced, and the
+// throughput of each is reported.
+//
+// ./dsp_bench -i capture.lhc -p 2 -O
+//
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <wdsp.h>
+
+#include "agc.h"
+#include "mode.h"
+#include "filter.h"
+#include "discovered.h"
+#include "bpsk.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "wideband.h"
+#include "adc.h"
+#include "dac.h"
+#include "radio.h"
+#include "main.h"
+#include "protocol1.h"
+#include "protocol2.h"
+#include "audio.h"
+#include "subrx.h"
+#include "capture.h"
+#include "dsp_pool.h"
+#include "iq_convert.h"
+#include "iq_ring.h"
+#include "receiver_dsp.h"
+#include "ozy_frame.h"
+
+#ifndef GIT_VERSION
+#define GIT_VERSION ""
+#endif
+#ifndef GIT_DATE
+#define GIT_DATE ""
+#endif
+
+#define BENCH_MAX_RECEIVERS 8
+#define BENCH_RATES "48000,96000,192000,384000,768000,1536000"
+#define BENCH_RECEIVERS "1,2,4,8"
+// panadapter width used for the analyzer
+#define BENCH_PIXELS 1024
+#define BENCH_FPS 10
+// blocks at the start of a run left out of the latency figures
+#define BENCH_WARMUP_BLOCKS 16
+// synthetic source length in samples
+#define BENCH_SOURCE_SAMPLES 65536
+// largest replayed source in samples
+#define BENCH_MAX_REPLAY_SAMPLES (16*1024*1024)
+
+// largest number of ozy frames held for -O
+#define BENCH_MAX_OZY_FRAMES (64*1024)
+
+#define P1_PORT 1024
+#define P2_DDC_PORT 1035
+#define AUDIO_PACKET_SIZE 260
+
+static int buffer_size=1024;
+static int fft_size=2048;
+static double seconds=2.0;
+static gboolean fast=FALSE;
+static char *replay_file=NULL;
+static int replay_receivers=1;
+static int dsp_threads=-1;
+static char *dsp_cpus=NULL;
+static FILE *output=NULL;
+static gboolean ozy_parse=FALSE;
+
+// 24 bit big endian I/Q pairs fed to every receiver
+static unsigned char *source=NULL;
+static int source_samples=0;
+static const char *source_name="synthetic";
+
+// the ozy frames from a Protocol 1 capture, for -O
+static unsigned char *ozy_frames=NULL;
+static int ozy_frame_count=0;
+
+static gint64 process_cpu_ns() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF,&usage);
+  return ((gint64)(usage.ru_utime.tv_sec+usage.ru_stime.tv_sec)*1000000000LL)
+         +((gint64)(usage.ru_utime.tv_usec+usage.ru_stime.tv_usec)*1000LL);
+}
+
+static void put_sample(unsigned char *p,double x) {
+  long v=lrint(x*8388607.0);
+  p[0]=v>>16;
+  p[1]=v>>8;
+  p[2]=v;
+}
+
+//
+// two tones and some noise, with the tones on whole cycles of the
+// source so it loops cleanly at any rate
+//
+static void synthetic_source(int sample_rate) {
+  int i;
+  double phase1;
+  double phase2;
+  guint32 random=0x12345678;
+  double noise;
+
+  g_free(source);
+  source_samples=BENCH_SOURCE_SAMPLES;
+  source=g_new(unsigned char,source_samples*6);
+  for(i=0;i<source_samples;i++) {
+    phase1=2.0*M_PI*(double)i*(double)(source_samples/64)/(double)source_samples;
+    phase2=2.0*M_PI*(double)i*(double)(source_samples/9)/(double)source_samples;
+    random^=random<<13;
+    random^=random>>17;
+    random^=random<<5;
+    noise=0.001*(((double)random/2147483648.0)-1.0);
+    put_sample(&source[i*6],(0.1*cos(phase1))+(0.01*cos(phase2))+noise);
+    put_sample(&source[(i*6)+3],(0.1*sin(phase1))+(0.01*sin(phase2))+noise);
+  }
+}
+
+//
+// take the I/Q of the first receiver out of a capture file
+//
+static void add_replay_samples(const unsigned char *samples,int stride,int count) {
+  int i;
+  for(i=0;i<count && source_samples<BENCH_MAX_REPLAY_SAMPLES;i++) {
+    memcpy(&source[source_samples*6],&samples[i*stride],6);
+    source_samples++;
+  }
+}
+
+static gboolean replay_source(const char *filename) {
+  CAPTURE *replay;
+  PACKET_POOL *pool;
+  UDP_BATCH *batch;
+  PACKET *packet;
+  int stride=(replay_receivers*6)+2;
+  int count;
+  int samples;
+  int i;
+  int j;
+
+  replay=replay_new(filename,TRUE,2048);
+  if(replay==NULL) {
+    return FALSE;
+  }
+  pool=packet_pool_new(DEFAULT_UDP_BATCH_SIZE*2,2048);
+  batch=udp_batch_new(DEFAULT_UDP_BATCH_SIZE,pool);
+  source=g_new(unsigned char,BENCH_MAX_REPLAY_SAMPLES*6);
+  source_samples=0;
+  if(ozy_parse) {
+    ozy_frames=g_new(unsigned char,BENCH_MAX_OZY_FRAMES*OZY_BUFFER_SIZE);
+    ozy_frame_count=0;
+  }
+
+  while(replay->passes==0 && source_samples<BENCH_MAX_REPLAY_SAMPLES) {
+    count=replay_receive(replay,batch);
+    if(count<0) break;
+    for(i=0;i<count;i++) {
+      packet=udp_batch_take(batch,i);
+      if(replay->header.protocol==PROTOCOL_1) {
+        if(packet->port==P1_PORT && packet->length==1032 && packet->buffer[3]==6) {
+          for(j=8;j<1032;j+=512) {
+            add_replay_samples(&packet->buffer[j+8],stride,504/stride);
+            if(ozy_parse && ozy_frame_count<BENCH_MAX_OZY_FRAMES) {
+              memcpy(&ozy_frames[ozy_frame_count*OZY_BUFFER_SIZE],&packet->buffer[j],OZY_BUFFER_SIZE);
+              ozy_frame_count++;
+            }
+          }
+        }
+      } else if(packet->port==P2_DDC_PORT && packet->length>=16) {
+        samples=((packet->buffer[14]&0xFF)<<8)|(packet->buffer[15]&0xFF);
+        if(16+(samples*6)<=packet->length) {
+          add_replay_samples(&packet->buffer[16],6,samples);
+        }
+      }
+      packet_pool_release(pool,packet);
+    }
+  }
+
+  udp_batch_free(batch);
+  packet_pool_free(pool);
+  capture_free(replay);
+  if(source_samples<buffer_size) {
+    fprintf(stderr,"dsp_bench: only %d I/Q samples in %s\n",source_samples,filename);
+    return FALSE;
+  }
+  fprintf(stderr,"dsp_bench: %d I/Q samples from %s\n",source_samples,filename);
+  if(ozy_parse) {
+    fprintf(stderr,"dsp_bench: %d ozy frames from %s\n",ozy_frame_count,filename);
+  }
+  source_name=filename;
+  return TRUE;
+}
+
+//
+// receiver_dsp.c is linked as it is, these stand in for the rest of the
+// radio: nothing is transmitting, there is no local audio, bpsk or sub
+// receiver, and the active receiver's audio is packed as the Protocol 2
+// audio stream would but not sent
+//
+static DISCOVERED bench_discovered;
+static RADIO bench_radio;
+RADIO *radio=&bench_radio;
+gboolean headless=FALSE;
+
+static unsigned char audio_packet[AUDIO_PACKET_SIZE];
+static int audio_index=4;
+
+gboolean isTransmitting(RADIO *r) {
+  return FALSE;
+}
+
+void protocol2_audio_block(RECEIVER *rx,const double *audio,int count,gboolean mute) {
+  int n;
+  int i=0;
+
+  while(i<count) {
+    n=(AUDIO_PACKET_SIZE-audio_index)/4;
+    if(n>count-i) n=count-i;
+    iq_pack(IQ_INT16_BE,&audio[i*2],&audio_packet[audio_index],n,32767.0);
+    audio_index+=n*4;
+    i+=n;
+    if(audio_index>=AUDIO_PACKET_SIZE) {
+      audio_index=4;
+    }
+  }
+}
+
+void protocol1_audio_block(RECEIVER *rx,const double *audio,int count,gboolean mute) {
+}
+
+int audio_write(RECEIVER *rx,float left_sample,float right_sample) {
+  return 0;
+}
+
+void audio_start_output(RECEIVER *rx) {
+}
+
+void bpsk_add_iq_block(BPSK *bpsk,double *iq,int count) {
+}
+
+void subrx_iq_buffer(RECEIVER *rx,gdouble *iq_buffer) {
+}
+
+//
+// set up the channel with the settings create_receiver() gives a new
+// receiver (USB, AGC off, no noise reduction)
+//
+static void bench_open_channel(RECEIVER *rx) {
+  int result;
+  int flp[]={0};
+  FILTER *f=&filters[USB][F5];
+  double t=0.001*170.0;
+
+  OpenChannel(rx->channel,
+              rx->buffer_size,
+              rx->fft_size,
+              rx->sample_rate,
+              48000, // dsp rate
+              48000, // output rate
+              0, // receive
+              1, // run
+              0.010, 0.025, 0.0, 0.010, 0);
+
+  create_anbEXT(rx->channel,1,rx->buffer_size,rx->sample_rate,0.0001,0.0001,0.0001,0.05,20);
+  create_nobEXT(rx->channel,1,0,rx->buffer_size,rx->sample_rate,0.0001,0.0001,0.0001,0.05,20);
+  RXASetNC(rx->channel, rx->fft_size);
+  RXASetMP(rx->channel, FALSE);
+
+  SetRXAMode(rx->channel, USB);
+  RXASetPassband(rx->channel,(double)f->low,(double)f->high);
+
+  SetRXAPanelGain1(rx->channel, rx->volume);
+  SetRXAPanelSelect(rx->channel, 3);
+  SetRXAPanelPan(rx->channel, 0.5);
+  SetRXAPanelCopy(rx->channel, 0);
+  SetRXAPanelBinaural(rx->channel, 0);
+  SetRXAPanelRun(rx->channel, 1);
+  SetRXAEQRun(rx->channel, 0);
+
+  SetRXAAGCMode(rx->channel, AGC_OFF);
+  SetRXAAGCSlope(rx->channel,35.0);
+  SetRXAAGCTop(rx->channel,80.0);
+
+  SetEXTANBRun(rx->channel, FALSE);
+  SetEXTNOBRun(rx->channel, FALSE);
+
+  SetRXAEMNRPosition(rx->channel, 0);
+  SetRXAEMNRgainMethod(rx->channel, 2);
+  SetRXAEMNRnpeMethod(rx->channel, 0);
+  SetRXAEMNRRun(rx->channel, FALSE);
+  SetRXAEMNRaeRun(rx->channel, 1);
+
+  SetRXAANRVals(rx->channel, 64, 16, 16e-4, 10e-7); // defaults
+  SetRXAANRRun(rx->channel, FALSE);
+  SetRXAANFRun(rx->channel, FALSE);
+  SetRXASNBARun(rx->channel, FALSE);
+
+  XCreateAnalyzer(rx->channel, &result, 262144, 1, 1, "");
+  if(result!=0) {
+    fprintf(stderr,"XCreateAnalyzer channel=%d failed: %d\n",rx->channel,result);
+  } else {
+    // as receiver_init_analyzer() with the default display settings
+    int max_w=8192+(int)fmin(0.1*(double)rx->fps,0.1*8192.0*(double)rx->fps);
+    SetAnalyzer(rx->channel,1,1,1,flp,8192,rx->buffer_size,4,14.0,2048,0,0,0,
+                BENCH_PIXELS,1,0,0.0,0.0,max_w);
+  }
+
+  SetDisplayDetectorMode(rx->channel, 0, DETECTOR_MODE_AVERAGE);
+  SetDisplayAverageMode(rx->channel, 0, AVERAGE_MODE_LOG_RECURSIVE);
+  SetDisplayAvBackmult(rx->channel, 0, exp(-1.0/((double)rx->fps*t)));
+  SetDisplayNumAverage(rx->channel, 0, MAX(2,(int)fmin(60,(double)rx->fps*t)));
+}
+
+//
+// the fields of a RECEIVER that receiver_dsp.c uses
+//
+static RECEIVER *bench_receiver_new(int channel,int sample_rate) {
+  RECEIVER *rx=g_new0(RECEIVER,1);
+
+  g_mutex_init(&rx->mutex);
+  rx->channel=channel;
+  rx->sample_rate=sample_rate;
+  rx->buffer_size=buffer_size;
+  rx->fft_size=fft_size;
+  rx->output_samples=buffer_size/(sample_rate/48000);
+  rx->iq_input_buffer=g_new0(gdouble,2*buffer_size);
+  rx->audio_output_buffer=g_new0(gdouble,2*rx->output_samples);
+  rx->iq_timestamp=IQ_TIMESTAMP_NONE;
+  rx->dsp_timestamp=IQ_TIMESTAMP_NONE;
+  rx->volume=0.05;
+  rx->fps=BENCH_FPS;
+  rx->remote_audio=TRUE;
+  rx->local_audio=FALSE;
+  rx->audio_channels=AUDIO_STEREO;
+  rx->subrx_enable=FALSE;
+  rx->bpsk_enable=FALSE;
+  rx->snapshot=NULL;
+  rx->dsp_latencies=g_array_new(FALSE,FALSE,sizeof(gint64));
+  bench_open_channel(rx);
+  receiver_start_dsp(rx);
+  return rx;
+}
+
+static void bench_receiver_free(RECEIVER *rx) {
+  receiver_stop_dsp(rx);
+  DestroyAnalyzer(rx->channel);
+  destroy_anbEXT(rx->channel);
+  destroy_nobEXT(rx->channel);
+  CloseChannel(rx->channel);
+  receiver_free_dsp(rx);
+  g_array_free(rx->dsp_latencies,TRUE);
+  g_free(rx->iq_input_buffer);
+  g_free(rx->audio_output_buffer);
+  g_mutex_clear(&rx->mutex);
+  g_free(rx);
+}
+
+static gint compare_latency(gconstpointer a,gconstpointer b) {
+  gint64 x=*(const gint64 *)a;
+  gint64 y=*(const gint64 *)b;
+  return x<y?-1:(x>y?1:0);
+}
+
+static gint64 percentile(GArray *values,double p) {
+  int i;
+  if(values->len==0) return 0;
+  i=(int)ceil(p*(double)values->len)-1;
+  if(i<0) i=0;
+  if(i>=(int)values->len) i=values->len-1;
+  return g_array_index(values,gint64,i);
+}
+
+static void run(int sample_rate,int receivers) {
+  RECEIVER *rx[BENCH_MAX_RECEIVERS];
+  GArray *latencies;
+  GArray *rx_latencies;
+  glong overruns=0;
+  glong blocks=0;
+  double audio_seconds;
+  gint64 start;
+  gint64 elapsed;
+  gint64 cpu;
+  gint64 samples=0;
+  gint64 due;
+  int offset;
+  int i;
+  int n;
+  int m;
+
+  if(replay_file==NULL) {
+    synthetic_source(sample_rate);
+  }
+
+  for(i=0;i<receivers;i++) {
+    rx[i]=bench_receiver_new(i,sample_rate);
+  }
+  radio->active_receiver=rx[0];
+
+  cpu=process_cpu_ns();
+  start=g_get_monotonic_time();
+  do {
+    if(!fast) {
+      // release the block when the radio would have finished sending it
+      due=start+(((samples+buffer_size)*1000000LL)/sample_rate);
+      elapsed=g_get_monotonic_time();
+      if(due>elapsed) {
+        g_usleep(due-elapsed);
+      }
+    }
+
+    for(i=0;i<receivers;i++) {
+      if(fast) {
+        // wait for room rather than count an overrun
+        while(iq_ring_depth((IQ_RING *)rx[i]->iq_ring)>=IQ_RING_BLOCKS) {
+          g_usleep(50);
+        }
+      }
+      // the radio time tag is the sample count, as a radio's sample clock
+      add_iq_timestamp(rx[i],samples);
+      offset=(int)(samples%source_samples);
+      n=0;
+      while(n<buffer_size) {
+        m=source_samples-offset;
+        if(m>buffer_size-n) m=buffer_size-n;
+        add_iq_block(rx[i],&source[offset*6],IQ_INT24_BE,6,m,1.0/8388607.0,FALSE);
+        offset=(offset+m)%source_samples;
+        n+=m;
+      }
+    }
+    samples+=buffer_size;
+  } while(g_get_monotonic_time()-start<(gint64)(seconds*1000000.0));
+
+  // let the queued blocks through before stopping the clock
+  for(i=0;i<receivers;i++) {
+    while(iq_ring_depth((IQ_RING *)rx[i]->iq_ring)>0 || g_atomic_int_get(&rx[i]->dsp_scheduled)) {
+      g_usleep(100);
+    }
+  }
+  elapsed=g_get_monotonic_time()-start;
+  cpu=process_cpu_ns()-cpu;
+
+  latencies=g_array_new(FALSE,FALSE,sizeof(gint64));
+  for(i=0;i<receivers;i++) {
+    rx_latencies=rx[i]->dsp_latencies;
+    blocks+=rx_latencies->len;
+    if(rx_latencies->len>BENCH_WARMUP_BLOCKS) {
+      g_array_append_vals(latencies,&g_array_index(rx_latencies,gint64,BENCH_WARMUP_BLOCKS),rx_latencies->len-BENCH_WARMUP_BLOCKS);
+    }
+    overruns+=((IQ_RING *)rx[i]->iq_ring)->overruns;
+  }
+  g_array_sort(latencies,compare_latency);
+  // seconds of radio I/Q processed, summed over the receivers
+  audio_seconds=(double)blocks*(double)buffer_size/(double)sample_rate;
+
+  fprintf(output,"{\"version\":\"%s\",\"date\":\"%s\",\"source\":\"%s\",\"mode\":\"%s\","
+          "\"sample_rate\":%d,\"receivers\":%d,\"buffer_size\":%d,\"fft_size\":%d,\"dsp_threads\":%d,"
+          "\"seconds\":%.3f,\"blocks\":%ld,\"samples_per_second\":%.0f,\"realtime_factor\":%.3f,"
+          "\"latency_us\":{\"p50\":%ld,\"p90\":%ld,\"p99\":%ld,\"p999\":%ld,\"max\":%ld},"
+          "\"cpu_per_receiver\":%.4f,\"overruns\":%ld}\n",
+          GIT_VERSION,GIT_DATE,source_name,fast?"fast":"realtime",
+          sample_rate,receivers,buffer_size,fft_size,dsp_pool_threads(),
+          (double)elapsed/1000000.0,blocks,
+          (double)blocks*(double)buffer_size*1000000.0/(double)elapsed,
+          (audio_seconds/(double)receivers)/((double)elapsed/1000000.0),
+          (long)percentile(latencies,0.5),(long)percentile(latencies,0.9),
+          (long)percentile(latencies,0.99),(long)percentile(latencies,0.999),
+          (long)percentile(latencies,1.0),
+          // fraction of one cpu each receiver needs to keep up in real time
+          ((double)cpu/1000000000.0)/audio_seconds,
+          overruns);
+  fflush(output);
+
+  radio->active_receiver=NULL;
+  for(i=0;i<receivers;i++) {
+    bench_receiver_free(rx[i]);
+  }
+  g_array_free(latencies,TRUE);
+}
+
+//
+// -O: the receivers the ozy parsers feed. they get the DSP ring but the DSP
+// is stopped, so after each frame the full blocks are taken off the ring
+// and counted, plus a checksum so the two parsers can be compared
+//
+static RECEIVER *ozy_rx[BENCH_MAX_RECEIVERS];
+static int ozy_receivers;
+static unsigned char ozy_control_in[5];
+static glong ozy_sync_errors;
+static glong ozy_blocks[BENCH_MAX_RECEIVERS];
+static double ozy_sum;
+// the byte parser decodes the mic samples as it goes
+static double ozy_mic_sum;
+
+static void ozy_free() {
+  int i;
+  for(i=0;i<BENCH_MAX_RECEIVERS;i++) {
+    if(ozy_rx[i]!=NULL) {
+      receiver_free_dsp(ozy_rx[i]);
+      g_free(ozy_rx[i]->iq_input_buffer);
+      g_free(ozy_rx[i]);
+      ozy_rx[i]=NULL;
+    }
+  }
+}
+
+static void ozy_reset(int receivers) {
+  RECEIVER *rx;
+  int i;
+
+  ozy_free();
+  ozy_receivers=receivers;
+  for(i=0;i<receivers;i++) {
+    rx=g_new0(RECEIVER,1);
+    rx->channel=i;
+    rx->buffer_size=buffer_size;
+    rx->iq_input_buffer=g_new0(gdouble,2*buffer_size);
+    rx->iq_timestamp=IQ_TIMESTAMP_NONE;
+    rx->bpsk_enable=FALSE;
+    receiver_start_dsp(rx);
+    receiver_stop_dsp(rx);
+    ozy_rx[i]=rx;
+    ozy_blocks[i]=0;
+  }
+  memset(ozy_control_in,0,sizeof(ozy_control_in));
+  ozy_sync_errors=0;
+  ozy_sum=0.0;
+  ozy_mic_sum=0.0;
+}
+
+static void ozy_drain() {
+  IQ_RING *ring;
+  gdouble *iq;
+  int i;
+
+  for(i=0;i<ozy_receivers;i++) {
+    ring=(IQ_RING *)ozy_rx[i]->iq_ring;
+    while((iq=iq_ring_get(ring))!=NULL) {
+      ozy_sum+=iq[0]+iq[(buffer_size*2)-1];
+      ozy_blocks[i]++;
+      iq_ring_release(ring);
+    }
+  }
+}
+
+//
+// the frame parser the Protocol 1 receive thread uses, the mic samples are
+// then passed on by process_ozy_input_buffer() and are not timed here
+//
+static void ozy_parse_frame(unsigned char *buffer) {
+  if(!ozy_frame_parse(buffer,ozy_rx,ozy_receivers,ozy_control_in)) {
+    ozy_sync_errors++;
+  }
+}
+
+//
+// the byte at a time state machine process_ozy_input_buffer() used before
+// the frame parser, handing each sample to add_iq_samples() as it did then
+//
+enum {
+  SYNC_0=0,
+  SYNC_1,
+  SYNC_2,
+  CONTROL_0,
+  CONTROL_1,
+  CONTROL_2,
+  CONTROL_3,
+  CONTROL_4,
+  LEFT_SAMPLE_HI,
+  LEFT_SAMPLE_MID,
+  LEFT_SAMPLE_LOW,
+  RIGHT_SAMPLE_HI,
+  RIGHT_SAMPLE_MID,
+  RIGHT_SAMPLE_LOW,
+  MIC_SAMPLE_HI,
+  MIC_SAMPLE_LOW,
+  SKIP
+};
+static int state=SYNC_0;
+static int nreceiver;
+static int left_sample;
+static int right_sample;
+static short mic_sample;
+static double left_sample_double;
+static double right_sample_double;
+static int nsamples;
+static int iq_samples;
+
+static void ozy_parse_byte(int b) {
+  int i,j;
+  switch(state) {
+    case SYNC_0:
+      if(b==SYNC) {
+        state++;
+      }
+      break;
+    case SYNC_1:
+      if(b==SYNC) {
+        state++;
+      }
+      break;
+    case SYNC_2:
+      if(b==SYNC) {
+        state++;
+      }
+      break;
+    case CONTROL_0:
+      ozy_control_in[0]=b;
+      state++;
+      break;
+    case CONTROL_1:
+      ozy_control_in[1]=b;
+      state++;
+      break;
+    case CONTROL_2:
+      ozy_control_in[2]=b;
+      state++;
+      break;
+    case CONTROL_3:
+      ozy_control_in[3]=b;
+      state++;
+      break;
+    case CONTROL_4:
+      ozy_control_in[4]=b;
+      nreceiver=0;
+      iq_samples=(512-8)/((ozy_receivers*6)+2);
+      nsamples=0;
+      state++;
+      break;
+    case LEFT_SAMPLE_HI:
+      left_sample=(int)((signed char)b<<16);
+      state++;
+      break;
+    case LEFT_SAMPLE_MID:
+      left_sample|=(int)((((unsigned char)b)<<8)&0xFF00);
+      state++;
+      break;
+    case LEFT_SAMPLE_LOW:
+      left_sample|=(int)((unsigned char)b&0xFF);
+      left_sample_double=(double)left_sample/8388607.0; // 24 bit sample 2^23-1
+      state++;
+      break;
+    case RIGHT_SAMPLE_HI:
+      right_sample=(int)((signed char)b<<16);
+      state++;
+      break;
+    case RIGHT_SAMPLE_MID:
+      right_sample|=(int)((((unsigned char)b)<<8)&0xFF00);
+      state++;
+      break;
+    case RIGHT_SAMPLE_LOW:
+      right_sample|=(int)((unsigned char)b&0xFF);
+      right_sample_double=(double)right_sample/8388607.0; // 24 bit sample 2^23-1
+      //find receiver
+      i=-1;
+      for(j=0;j<BENCH_MAX_RECEIVERS;j++) {
+        if(ozy_rx[j]!=NULL) {
+          i++;
+          if(i==nreceiver) break;
+        }
+      }
+      if(j<BENCH_MAX_RECEIVERS && ozy_rx[j]!=NULL) {
+        add_iq_samples(ozy_rx[j],left_sample_double,right_sample_double);
+      }
+      nreceiver++;
+      if(nreceiver==ozy_receivers) {
+        state++;
+      } else {
+        state=LEFT_SAMPLE_HI;
+      }
+      break;
+    case MIC_SAMPLE_HI:
+      mic_sample=(short)(b<<8);
+      state++;
+      break;
+    case MIC_SAMPLE_LOW:
+      mic_sample|=(short)(b&0xFF);
+      ozy_mic_sum+=(float)mic_sample/32768.0;
+      nsamples++;
+      if(nsamples==iq_samples) {
+        state=SYNC_0;
+      } else {
+        nreceiver=0;
+        state=LEFT_SAMPLE_HI;
+      }
+      break;
+  }
+}
+
+static void ozy_parse_bytes(unsigned char *buffer) {
+  int i;
+  for(i=0;i<OZY_BUFFER_SIZE;i++) {
+    ozy_parse_byte(buffer[i]&0xFF);
+  }
+}
+
+//
+// run one parser over the captured frames, round and round for the
+// length of a run, and write its throughput
+//
+static void ozy_run(const char *name,void (*parse)(unsigned char *),int receivers,gboolean matches) {
+  gint64 start;
+  gint64 elapsed;
+  glong frames=0;
+  int frame_samples=OZY_FRAME_SAMPLES(receivers);
+  int i;
+
+  ozy_reset(receivers);
+  state=SYNC_0;
+  start=g_get_monotonic_time();
+  do {
+    for(i=0;i<ozy_frame_count;i++) {
+      parse(&ozy_frames[i*OZY_BUFFER_SIZE]);
+      ozy_drain();
+    }
+    frames+=ozy_frame_count;
+    elapsed=g_get_monotonic_time()-start;
+  } while(elapsed<(gint64)(seconds*1000000.0));
+
+  fprintf(output,"{\"version\":\"%s\",\"date\":\"%s\",\"source\":\"%s\",\"mode\":\"ozy-parse\","
+          "\"parser\":\"%s\",\"receivers\":%d,\"seconds\":%.3f,\"frames\":%ld,"
+          "\"frames_per_second\":%.0f,\"samples_per_second\":%.0f,\"mbytes_per_second\":%.1f,"
+          "\"sync_errors\":%ld,\"matches\":%s}\n",
+          GIT_VERSION,GIT_DATE,source_name,name,receivers,
+          (double)elapsed/1000000.0,frames,
+          (double)frames*1000000.0/(double)elapsed,
+          // I/Q samples delivered, summed over the receivers
+          (double)frames*(double)(frame_samples*receivers)*1000000.0/(double)elapsed,
+          (double)frames*(double)OZY_BUFFER_SIZE/(double)elapsed,
+          ozy_sync_errors,matches?"true":"false");
+  fflush(output);
+}
+
+static void ozy_bench(int receivers) {
+  glong blocks[BENCH_MAX_RECEIVERS];
+  double sum;
+  gboolean matches=TRUE;
+  int i;
+
+  // one pass of each to check they hand on the same samples
+  ozy_reset(receivers);
+  for(i=0;i<ozy_frame_count;i++) {
+    ozy_parse_frame(&ozy_frames[i*OZY_BUFFER_SIZE]);
+    ozy_drain();
+  }
+  sum=ozy_sum;
+  for(i=0;i<receivers;i++) {
+    blocks[i]=ozy_blocks[i];
+  }
+  ozy_reset(receivers);
+  state=SYNC_0;
+  for(i=0;i<ozy_frame_count;i++) {
+    ozy_parse_bytes(&ozy_frames[i*OZY_BUFFER_SIZE]);
+    ozy_drain();
+  }
+  for(i=0;i<receivers;i++) {
+    if(ozy_blocks[i]!=blocks[i]) matches=FALSE;
+  }
+  // the byte parser divides where iq_convert() multiplies by the reciprocal
+  if(fabs(ozy_sum-sum)>1e-9*MAX(1.0,fabs(sum))) matches=FALSE;
+  if(!matches) {
+    fprintf(stderr,"dsp_bench: the frame and byte parsers do not agree\n");
+  }
+
+  ozy_run("frame",ozy_parse_frame,receivers,matches);
+  ozy_run("byte",ozy_parse_bytes,receivers,matches);
+
+  ozy_free();
+}
+
+static void usage(char *name) {
+  fprintf(stderr,"usage: %s [options]\n",name);
+  fprintf(stderr,"  -r, --rates LIST        sample rates (default %s)\n",BENCH_RATES);
+  fprintf(stderr,"  -n, --receivers LIST    receiver counts (default %s)\n",BENCH_RECEIVERS);
+  fprintf(stderr,"  -s, --seconds S         length of each run (default %g)\n",seconds);
+  fprintf(stderr,"  -f, --fast              feed I/Q as fast as the DSP takes it\n");
+  fprintf(stderr,"                          (default is the radio's real time rate)\n");
+  fprintf(stderr,"  -i, --replay FILE       take the I/Q from a capture file\n");
+  fprintf(stderr,"  -p, --p1-receivers N    receivers in a Protocol 1 capture (default %d)\n",replay_receivers);
+  fprintf(stderr,"  -O, --ozy-parse         time the Protocol 1 frame and byte parsers on\n");
+  fprintf(stderr,"                          the capture instead of the DSP\n");
+  fprintf(stderr,"  -b, --buffer-size N     samples per DSP block (default %d)\n",buffer_size);
+  fprintf(stderr,"  -z, --fft-size N        WDSP filter fft size (default %d)\n",fft_size);
+  fprintf(stderr,"  -t, --dsp-threads N     DSP pool threads (default one per cpu)\n");
+  fprintf(stderr,"  -c, --dsp-cpus LIST     cpus to pin the DSP pool to\n");
+  fprintf(stderr,"  -o, --output FILE       append results to FILE (default stdout)\n");
+}
+
+int main(int argc,char **argv) {
+  static struct option options[]={
+    {"rates",required_argument,NULL,'r'},
+    {"receivers",required_argument,NULL,'n'},
+    {"seconds",required_argument,NULL,'s'},
+    {"fast",no_argument,NULL,'f'},
+    {"replay",required_argument,NULL,'i'},
+    {"p1-receivers",required_argument,NULL,'p'},
+    {"ozy-parse",no_argument,NULL,'O'},
+    {"buffer-size",required_argument,NULL,'b'},
+    {"fft-size",required_argument,NULL,'z'},
+    {"dsp-threads",required_argument,NULL,'t'},
+    {"dsp-cpus",required_argument,NULL,'c'},
+    {"output",required_argument,NULL,'o'},
+    {"help",no_argument,NULL,'h'},
+    {NULL,0,NULL,0}
+  };
+  char wisdom_directory[1024];
+  char wisdom_file[1024];
+  char *rates=BENCH_RATES;
+  char *receivers=BENCH_RECEIVERS;
+  gchar **rate_list;
+  gchar **receiver_list;
+  int rate;
+  int count;
+  int c;
+  int i;
+  int j;
+
+  output=stdout;
+  while((c=getopt_long(argc,argv,"r:n:s:fi:p:Ob:z:t:c:o:h",options,NULL))!=-1) {
+    switch(c) {
+      case 'r': rates=optarg; break;
+      case 'n': receivers=optarg; break;
+      case 's': seconds=atof(optarg); break;
+      case 'f': fast=TRUE; break;
+      case 'i': replay_file=optarg; break;
+      case 'p': replay_receivers=atoi(optarg); break;
+      case 'O': ozy_parse=TRUE; break;
+      case 'b': buffer_size=atoi(optarg); break;
+      case 'z': fft_size=atoi(optarg); break;
+      case 't': dsp_threads=atoi(optarg); break;
+      case 'c': dsp_cpus=optarg; break;
+      case 'o':
+        output=fopen(optarg,"a");
+        if(output==NULL) {
+          fprintf(stderr,"dsp_bench: cannot open %s: %s\n",optarg,strerror(errno));
+          exit(-1);
+        }
+        break;
+      default:
+        usage(argv[0]);
+        exit(c=='h'?0:-1);
+    }
+  }
+  if(replay_receivers<1) replay_receivers=1;
+  if(replay_receivers>BENCH_MAX_RECEIVERS) replay_receivers=BENCH_MAX_RECEIVERS;
+  if(buffer_size<32) buffer_size=32;
+  if(seconds<=0.0) seconds=2.0;
+  if(dsp_threads<0) {
+    dsp_threads=MIN(g_get_num_processors(),MAX_DSP_THREADS);
+  }
+
+  if(ozy_parse && replay_file==NULL) {
+    fprintf(stderr,"dsp_bench: -O needs a Protocol 1 capture (-i)\n");
+    exit(-1);
+  }
+
+  if(replay_file!=NULL && !replay_source(replay_file)) {
+    exit(-1);
+  }
+
+  if(ozy_parse) {
+    if(ozy_frame_count==0) {
+      fprintf(stderr,"dsp_bench: no Protocol 1 ozy frames in %s\n",replay_file);
+      exit(-1);
+    }
+    fprintf(stderr,"dsp_bench: ozy parsers, %d receivers\n",replay_receivers);
+    ozy_bench(replay_receivers);
+    g_free(ozy_frames);
+    if(output!=stdout) {
+      fclose(output);
+    }
+    return 0;
+  }
+
+  // use the FFT plans linhpsdr has already made, creating them takes minutes
+  snprintf(wisdom_directory,sizeof(wisdom_directory),"%s/.local/share/linhpsdr/",g_get_home_dir());
+  snprintf(wisdom_file,sizeof(wisdom_file),"%swdspWisdom",wisdom_directory);
+  if(access(wisdom_file,F_OK)==0) {
+    WDSPwisdom(wisdom_directory);
+  } else {
+    fprintf(stderr,"dsp_bench: no %s, run linhpsdr once to create it\n",wisdom_file);
+  }
+  dsp_pool_init(dsp_threads,dsp_cpus);
+  bench_discovered.protocol=PROTOCOL_2;
+  bench_radio.discovered=&bench_discovered;
+
+  rate_list=g_strsplit(rates,",",-1);
+  receiver_list=g_strsplit(receivers,",",-1);
+  for(i=0;rate_list[i]!=NULL;i++) {
+    rate=atoi(rate_list[i]);
+    if(rate<48000 || (rate%48000)!=0 || buffer_size<(rate/48000)) {
+      fprintf(stderr,"dsp_bench: skipping sample rate %s\n",rate_list[i]);
+      continue;
+    }
+    for(j=0;receiver_list[j]!=NULL;j++) {
+      count=atoi(receiver_list[j]);
+      if(count<1 || count>BENCH_MAX_RECEIVERS) {
+        fprintf(stderr,"dsp_bench: skipping %s receivers\n",receiver_list[j]);
+        continue;
+      }
+      fprintf(stderr,"dsp_bench: %d receivers at %d\n",count,rate);
+      run(rate,count);
+    }
+  }
+  g_strfreev(rate_list);
+  g_strfreev(receiver_list);
+  dsp_pool_shutdown();
+
+  if(output!=stdout) {
+    fclose(output);
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "dsp_pool.h"
+
+//
+// pool of worker threads that run the receiver DSP
+// each receiver is only ever queued once at a time so its blocks are still
+// processed in order, but different receivers run on different cores
+//
+// the mutex and conditions are static so they need no g_mutex_init() and
+// survive the pool being started again
+//
+
+static GMutex pool_mutex;
+static GCond work_cond;
+static GCond done_cond;
+static DSP_TASK *queue_head=NULL;
+static DSP_TASK *queue_tail=NULL;
+
+static int users=0;
+static gboolean stopping=FALSE;
+static int threads=0;
+static GThread *thread_id[MAX_DSP_THREADS];
+static int cpu[MAX_DSP_THREADS];
+static int cpus=0;
+
+// called with pool_mutex locked
+static DSP_TASK *dsp_pool_next() {
+  DSP_TASK *task=queue_head;
+  if(task!=NULL) {
+    queue_head=task->next;
+    if(queue_head==NULL) {
+      queue_tail=NULL;
+    }
+    task->next=NULL;
+  }
+  return task;
+}
+
+// called with pool_mutex locked, returns with it locked
+static void dsp_pool_run(DSP_TASK *task) {
+  g_mutex_unlock(&pool_mutex);
+  task->function(task->data);
+  g_mutex_lock(&pool_mutex);
+  task->done=TRUE;
+  g_cond_broadcast(&done_cond);
+}
+
+static gpointer dsp_pool_thread(gpointer data) {
+  int id=GPOINTER_TO_INT(data);
+  DSP_TASK *task;
+
+  if(cpus>0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu[id%cpus],&set);
+    if(pthread_setaffinity_np(pthread_self(),sizeof(set),&set)!=0) {
+      fprintf(stderr,"dsp_pool_thread: %d: cannot set affinity to cpu %d\n",id,cpu[id%cpus]);
+    }
+  }
+
+  g_mutex_lock(&pool_mutex);
+  while(1) {
+    task=dsp_pool_next();
+    if(task==NULL) {
+      // anything still queued is finished before the thread exits
+      if(stopping) break;
+      g_cond_wait(&work_cond,&pool_mutex);
+      continue;
+    }
+    dsp_pool_run(task);
+  }
+  g_mutex_unlock(&pool_mutex);
+  return NULL;
+}
+
+// called with pool_mutex locked, take a task off the queue if it is waiting
+static gboolean dsp_pool_unqueue(DSP_TASK *task) {
+  DSP_TASK *prev=NULL;
+  DSP_TASK *t;
+  for(t=queue_head;t!=NULL;t=t->next) {
+    if(t==task) {
+      if(prev==NULL) {
+        queue_head=t->next;
+      } else {
+        prev->next=t->next;
+      }
+      if(queue_tail==t) {
+        queue_tail=prev;
+      }
+      t->next=NULL;
+      return TRUE;
+    }
+    prev=t;
+  }
+  return FALSE;
+}
+
+//
+// threads: number of worker threads (0 runs everything on the caller)
+// cpus: optional comma separated list of cpus to pin the workers to
+// the pool is reference counted, only the first call starts the threads
+// and each call must be matched by dsp_pool_shutdown()
+//
+void dsp_pool_init(int n,char *cpu_list) {
+  int i;
+  char name[16];
+
+  g_mutex_lock(&pool_mutex);
+  users++;
+  if(users>1) {
+    g_mutex_unlock(&pool_mutex);
+    g_print("dsp_pool_init: already running with %d threads\n",threads);
+    return;
+  }
+  stopping=FALSE;
+  g_mutex_unlock(&pool_mutex);
+
+  if(n<0) n=0;
+  if(n>MAX_DSP_THREADS) n=MAX_DSP_THREADS;
+
+  cpus=0;
+  if(cpu_list!=NULL && cpu_list[0]!='\0') {
+    gchar **list=g_strsplit(cpu_list,",",-1);
+    for(i=0;list[i]!=NULL && cpus<MAX_DSP_THREADS;i++) {
+      if(list[i][0]!='\0') {
+        cpu[cpus++]=atoi(list[i]);
+      }
+    }
+    g_strfreev(list);
+  }
+
+  threads=n;
+  for(i=0;i<threads;i++) {
+    sprintf(name,"dsp %d",i);
+    thread_id[i]=g_thread_new(name,dsp_pool_thread,GINT_TO_POINTER(i));
+    if(!thread_id[i]) {
+      fprintf(stderr,"g_thread_new failed on dsp_pool_thread\n");
+      exit(-1);
+    }
+  }
+  g_print("dsp_pool_init: threads=%d cpus=%s\n",threads,cpus>0?cpu_list:"any");
+}
+
+//
+// release the pool, the last user finishes the queued work and joins the
+// worker threads
+//
+void dsp_pool_shutdown() {
+  int i;
+
+  g_mutex_lock(&pool_mutex);
+  if(users==0 || --users>0) {
+    g_mutex_unlock(&pool_mutex);
+    return;
+  }
+  stopping=TRUE;
+  g_cond_broadcast(&work_cond);
+  g_mutex_unlock(&pool_mutex);
+
+  for(i=0;i<threads;i++) {
+    g_thread_join(thread_id[i]);
+    thread_id[i]=NULL;
+  }
+  threads=0;
+  g_print("dsp_pool_shutdown: stopped\n");
+}
+
+int dsp_pool_threads() {
+  return threads;
+}
+
+DSP_TASK *dsp_task_new(DSP_FUNCTION function,gpointer data) {
+  DSP_TASK *task=g_new0(DSP_TASK,1);
+  task->function=function;
+  task->data=data;
+  task->done=TRUE;
+  task->next=NULL;
+  return task;
+}
+
+void dsp_pool_submit(DSP_TASK *task) {
+  if(threads==0) {
+    task->function(task->data);
+    task->done=TRUE;
+    return;
+  }
+  g_mutex_lock(&pool_mutex);
+  task->done=FALSE;
+  task->next=NULL;
+  if(queue_tail==NULL) {
+    queue_head=task;
+  } else {
+    queue_tail->next=task;
+  }
+  queue_tail=task;
+  g_cond_signal(&work_cond);
+  g_mutex_unlock(&pool_mutex);
+}
+
+//
+// wait for a task to complete
+// if no worker has picked the task up yet the caller takes it off the queue
+// and runs it, so a worker can wait on a task it submitted without tying up
+// the pool. other tasks are never run here, the caller may be holding a
+// receiver's mutex.
+//
+void dsp_pool_wait(DSP_TASK *task) {
+  if(threads==0) return;
+  g_mutex_lock(&pool_mutex);
+  if(!task->done && dsp_pool_unqueue(task)) {
+    dsp_pool_run(task);
+  }
+  while(!task->done) {
+    g_cond_wait(&done_cond,&pool_mutex);
+  }
+  g_mutex_unlock(&pool_mutex);
+}
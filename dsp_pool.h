@@ -0,0 +1,47 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef DSP_POOL_H
+#define DSP_POOL_H
+
+#define MAX_DSP_THREADS 16
+
+typedef void (*DSP_FUNCTION)(gpointer data);
+
+//
+// a unit of work for the DSP pool
+// tasks are owned by the caller and are not copied, so a task must not be
+// submitted again until it has been taken off the queue
+//
+typedef struct _dsp_task {
+  DSP_FUNCTION function;
+  gpointer data;
+  gboolean done;
+  struct _dsp_task *next;
+} DSP_TASK;
+
+extern void dsp_pool_init(int threads,char *cpus);
+extern void dsp_pool_shutdown();
+extern int dsp_pool_threads();
+extern DSP_TASK *dsp_task_new(DSP_FUNCTION function,gpointer data);
+extern void dsp_pool_submit(DSP_TASK *task);
+extern void dsp_pool_wait(DSP_TASK *task);
+
+#endif
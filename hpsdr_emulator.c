@@ -0,0 +1,727 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+//
+// HPSDR Protocol 1/Protocol 2 radio emulator for load testing linhpsdr
+// without hardware. It answers discovery, follows the start/stop and
+// command frames and streams synthetic I/Q (a tone plus noise) with
+// correct sequence numbers. It also consumes the TX I/Q and audio
+// streams, reporting gaps and frames that arrive too late to keep the
+// radio's TX FIFO from running dry.
+//
+// make emulator
+// ./hpsdr_emulator -p 1 -d 4                 (Protocol 1 Angelia)
+// ./hpsdr_emulator -p 2 -d 5 -r 8            (Protocol 2 Orion2, 8 DDCs)
+//
+
+#include <glib.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "discovered.h"
+
+// Protocol 1
+#define P1_PORT 1024
+#define P1_FRAME_SIZE 512
+#define P1_PACKET_SIZE 1032
+#define P1_TX_RATE 48000
+#define P1_TX_SAMPLES_PER_PACKET 126
+#define SYNC 0x7F
+
+// Protocol 2, ports on the radio
+#define P2_GENERAL_PORT 1024
+#define P2_RECEIVER_SPECIFIC_PORT 1025
+#define P2_TRANSMITTER_SPECIFIC_PORT 1026
+#define P2_HIGH_PRIORITY_PORT 1027
+#define P2_AUDIO_PORT 1028
+#define P2_TX_IQ_PORT 1029
+// Protocol 2, ports the radio sends from
+#define P2_HIGH_PRIORITY_TO_HOST_PORT 1025
+#define P2_MIC_TO_HOST_PORT 1026
+#define P2_DDC_TO_HOST_PORT 1035
+#define P2_DDC_PACKET_SIZE 1444
+#define P2_DDC_SAMPLES_PER_PACKET 238
+#define P2_MIC_SAMPLES_PER_PACKET 64
+#define P2_MIC_PACKET_SIZE 132
+#define P2_TX_RATE 192000
+#define P2_TX_SAMPLES_PER_PACKET 240
+#define P2_AUDIO_RATE 48000
+#define P2_AUDIO_SAMPLES_PER_PACKET 64
+#define P2_RECEIVE_PORTS 6
+
+#define MAX_DDC 8
+#define TX_FIFO_SAMPLES 4096
+#define TX_FIFO_PREFILL 1024
+
+//
+// synthetic I/Q source: a complex tone from a recursive oscillator plus
+// uniform noise, cheap enough for 8 DDCs at 1536k on one core
+//
+typedef struct _source {
+  double i;
+  double q;
+  double step_i;
+  double step_q;
+  guint32 random;
+  int renormalize;
+} SOURCE;
+
+//
+// model of a radio FIFO drained at a fixed rate, used to decide whether
+// a packet from the client arrived in time
+//
+typedef struct _fifo_model {
+  int rate;
+  int samples_per_packet;
+  gboolean draining;
+  gint64 last_time;
+  double level;
+  long packets;
+  long gaps;
+  long late;
+  long overflows;
+  long sequence;
+} FIFO_MODEL;
+
+typedef struct _stream {
+  gboolean enabled;
+  int rate;
+  int samples_per_packet;
+  long sequence;
+  long sent;
+  gint64 start_time;
+  SOURCE source;
+} STREAM;
+
+static int protocol=1;
+static int device=-1;
+static int ddcs=MAX_DDC;
+static double tone=10000.0;
+static double amplitude=0.1;
+static double noise=0.001;
+static gboolean verbose=FALSE;
+
+static unsigned char mac[6]={0x00,0x1C,0xC0,0xA2,0x13,0xDD};
+static int software_version=73;
+
+static volatile gboolean running=FALSE;
+static GMutex state_mutex;
+static GMutex client_mutex;
+static struct sockaddr_in client_addr;
+static gboolean have_client=FALSE;
+
+static int sockets[P2_RECEIVE_PORTS];
+static int ddc_sockets[MAX_DDC];
+
+// Protocol 1 state
+static int p1_receivers=1;
+static int p1_sample_rate=48000;
+static STREAM p1_stream;
+static SOURCE p1_sources[8];
+static FIFO_MODEL p1_tx;
+
+// Protocol 2 state
+static STREAM p2_ddc[MAX_DDC];
+static STREAM p2_mic;
+static long p2_high_priority_sequence=0;
+static FIFO_MODEL p2_tx;
+static FIFO_MODEL p2_audio;
+
+static void source_init(SOURCE *s,double frequency,int rate,guint32 seed) {
+  double w=2.0*M_PI*frequency/(double)rate;
+  s->i=amplitude;
+  s->q=0.0;
+  s->step_i=cos(w);
+  s->step_q=sin(w);
+  s->random=seed|1;
+  s->renormalize=0;
+}
+
+static inline double source_noise(SOURCE *s) {
+  // xorshift32
+  s->random^=s->random<<13;
+  s->random^=s->random>>17;
+  s->random^=s->random<<5;
+  return noise*(((double)s->random/2147483648.0)-1.0);
+}
+
+static inline void source_next(SOURCE *s,int *isample,int *qsample,double scale) {
+  double i=s->i*s->step_i-s->q*s->step_q;
+  double q=s->i*s->step_q+s->q*s->step_i;
+  if(++s->renormalize==1024) {
+    double m=amplitude/sqrt(i*i+q*q);
+    i*=m;
+    q*=m;
+    s->renormalize=0;
+  }
+  s->i=i;
+  s->q=q;
+  *isample=(int)((i+source_noise(s))*scale);
+  *qsample=(int)((q+source_noise(s))*scale);
+}
+
+static inline void put24(unsigned char *b,int v) {
+  b[0]=v>>16;
+  b[1]=v>>8;
+  b[2]=v;
+}
+
+static inline void put32(unsigned char *b,long v) {
+  b[0]=v>>24;
+  b[1]=v>>16;
+  b[2]=v>>8;
+  b[3]=v;
+}
+
+static inline long get32(unsigned char *b) {
+  return ((long)b[0]<<24)|((long)b[1]<<16)|((long)b[2]<<8)|(long)b[3];
+}
+
+static void stream_start(STREAM *s,int rate,int samples_per_packet,double frequency,guint32 seed) {
+  s->enabled=TRUE;
+  s->rate=rate;
+  s->samples_per_packet=samples_per_packet;
+  s->sequence=0;
+  s->sent=0;
+  s->start_time=g_get_monotonic_time();
+  source_init(&s->source,frequency,rate,seed);
+}
+
+// packets that should have been sent by now
+static long stream_due(STREAM *s,gint64 now) {
+  if(!s->enabled) return 0;
+  return (long)(((now-s->start_time)*(gint64)s->rate)/((gint64)s->samples_per_packet*1000000))-s->sent;
+}
+
+static void fifo_model_init(FIFO_MODEL *f,int rate,int samples_per_packet) {
+  memset(f,0,sizeof(FIFO_MODEL));
+  f->rate=rate;
+  f->samples_per_packet=samples_per_packet;
+  f->sequence=-1;
+}
+
+//
+// like the radio, start draining once the FIFO holds TX_FIFO_PREFILL
+// samples and count a late packet each time it runs dry
+//
+static void fifo_model_packet(FIFO_MODEL *f,long sequence,gint64 now) {
+  if(f->sequence>=0 && sequence!=f->sequence+1) {
+    f->gaps++;
+  }
+  f->sequence=sequence;
+  f->packets++;
+  if(f->draining) {
+    f->level-=(double)(now-f->last_time)*(double)f->rate/1000000.0;
+    if(f->level<0.0) {
+      f->late++;
+      f->level=0.0;
+      f->draining=FALSE;
+    }
+  }
+  f->last_time=now;
+  f->level+=f->samples_per_packet;
+  if(f->level>=TX_FIFO_PREFILL) {
+    f->draining=TRUE;
+  }
+  if(f->level>TX_FIFO_SAMPLES) {
+    f->overflows++;
+    f->level=TX_FIFO_SAMPLES;
+  }
+}
+
+static void send_to_client(int s,unsigned char *buffer,int length) {
+  struct sockaddr_in addr;
+  g_mutex_lock(&client_mutex);
+  addr=client_addr;
+  g_mutex_unlock(&client_mutex);
+  if(sendto(s,buffer,length,0,(struct sockaddr *)&addr,sizeof(addr))<0) {
+    if(verbose) perror("hpsdr_emulator: sendto");
+  }
+}
+
+static void set_client(struct sockaddr_in *addr) {
+  g_mutex_lock(&client_mutex);
+  client_addr=*addr;
+  have_client=TRUE;
+  g_mutex_unlock(&client_mutex);
+}
+
+static int open_socket(int port) {
+  struct sockaddr_in addr;
+  int optval=1;
+  int size=4*1024*1024;
+  int s=socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP);
+  if(s<0) {
+    perror("hpsdr_emulator: socket");
+    exit(-1);
+  }
+  setsockopt(s,SOL_SOCKET,SO_REUSEADDR,&optval,sizeof(optval));
+  setsockopt(s,SOL_SOCKET,SO_BROADCAST,&optval,sizeof(optval));
+  setsockopt(s,SOL_SOCKET,SO_RCVBUF,&size,sizeof(size));
+  setsockopt(s,SOL_SOCKET,SO_SNDBUF,&size,sizeof(size));
+  memset(&addr,0,sizeof(addr));
+  addr.sin_family=AF_INET;
+  addr.sin_addr.s_addr=htonl(INADDR_ANY);
+  addr.sin_port=htons(port);
+  if(bind(s,(struct sockaddr *)&addr,sizeof(addr))<0) {
+    fprintf(stderr,"hpsdr_emulator: bind port %d: %s\n",port,strerror(errno));
+    exit(-1);
+  }
+  return s;
+}
+
+//
+// Protocol 1
+//
+
+static void p1_discovery_reply(int s,struct sockaddr_in *addr) {
+  unsigned char buffer[60];
+  memset(buffer,0,sizeof(buffer));
+  buffer[0]=0xEF;
+  buffer[1]=0xFE;
+  buffer[2]=running?0x03:0x02;
+  memcpy(&buffer[3],mac,6);
+  buffer[9]=software_version;
+  buffer[10]=device;
+  buffer[0x13]=ddcs; // Hermes Lite 2 reports its receiver count
+  sendto(s,buffer,sizeof(buffer),0,(struct sockaddr *)addr,sizeof(*addr));
+}
+
+static void p1_start(void) {
+  int r;
+  g_mutex_lock(&state_mutex);
+  stream_start(&p1_stream,p1_sample_rate,2*((P1_FRAME_SIZE-8)/((p1_receivers*6)+2)),tone,1);
+  for(r=0;r<8;r++) {
+    source_init(&p1_sources[r],tone*(r+1),p1_sample_rate,r+1);
+  }
+  fifo_model_init(&p1_tx,P1_TX_RATE,P1_TX_SAMPLES_PER_PACKET);
+  g_mutex_unlock(&state_mutex);
+}
+
+static void p1_control(unsigned char *frame) {
+  int receivers;
+  int rate;
+  if(frame[0]!=SYNC || frame[1]!=SYNC || frame[2]!=SYNC) return;
+  if((frame[3]&0xFE)!=0x00) return;
+  switch(frame[4]&0x03) {
+    case 0: rate=48000; break;
+    case 1: rate=96000; break;
+    case 2: rate=192000; break;
+    default: rate=384000; break;
+  }
+  receivers=((frame[7]>>3)&0x0F)+1;
+  if(receivers!=p1_receivers || rate!=p1_sample_rate) {
+    p1_receivers=receivers;
+    p1_sample_rate=rate;
+    fprintf(stderr,"hpsdr_emulator: %d receivers at %d\n",p1_receivers,p1_sample_rate);
+    if(running) p1_start();
+  }
+}
+
+static void p1_process(int s,unsigned char *buffer,int length,struct sockaddr_in *addr) {
+  if(length<4 || buffer[0]!=0xEF || buffer[1]!=0xFE) return;
+  switch(buffer[2]) {
+    case 0x02: // discovery
+      p1_discovery_reply(s,addr);
+      break;
+    case 0x04: // start/stop
+      set_client(addr);
+      if(buffer[3]&0x01) {
+        fprintf(stderr,"hpsdr_emulator: start from %s:%d\n",inet_ntoa(addr->sin_addr),ntohs(addr->sin_port));
+        p1_start();
+        running=TRUE;
+      } else {
+        fprintf(stderr,"hpsdr_emulator: stop\n");
+        running=FALSE;
+      }
+      break;
+    case 0x01: // EP2 commands, audio and TX I/Q
+      if(length<P1_PACKET_SIZE || buffer[3]!=0x02) break;
+      set_client(addr);
+      p1_control(&buffer[8]);
+      p1_control(&buffer[520]);
+      if(running) {
+        fifo_model_packet(&p1_tx,get32(&buffer[4]),g_get_monotonic_time());
+      }
+      break;
+  }
+}
+
+static void p1_build_frame(unsigned char *frame) {
+  int i;
+  int r;
+  int isample;
+  int qsample;
+  int stride=(p1_receivers*6)+2;
+  int samples=(P1_FRAME_SIZE-8)/stride;
+  unsigned char *b;
+
+  frame[0]=SYNC;
+  frame[1]=SYNC;
+  frame[2]=SYNC;
+  memset(&frame[3],0,5);
+  b=&frame[8];
+  for(i=0;i<samples;i++) {
+    for(r=0;r<p1_receivers;r++) {
+      source_next(&p1_sources[r],&isample,&qsample,8388607.0);
+      put24(b,isample);
+      put24(b+3,qsample);
+      b+=6;
+    }
+    source_next(&p1_stream.source,&isample,&qsample,32767.0);
+    b[0]=isample>>8;
+    b[1]=isample;
+    b+=2;
+  }
+  memset(b,0,&frame[P1_FRAME_SIZE]-b);
+}
+
+static void p1_send(int s,gint64 now) {
+  unsigned char buffer[P1_PACKET_SIZE];
+  long due;
+
+  g_mutex_lock(&state_mutex);
+  due=stream_due(&p1_stream,now);
+  while(due-->0) {
+    buffer[0]=0xEF;
+    buffer[1]=0xFE;
+    buffer[2]=0x01;
+    buffer[3]=0x06;
+    put32(&buffer[4],p1_stream.sequence++);
+    p1_build_frame(&buffer[8]);
+    p1_build_frame(&buffer[520]);
+    p1_stream.sent++;
+    send_to_client(s,buffer,sizeof(buffer));
+  }
+  g_mutex_unlock(&state_mutex);
+}
+
+//
+// Protocol 2
+//
+
+static void p2_discovery_reply(int s,struct sockaddr_in *addr) {
+  unsigned char buffer[60];
+  memset(buffer,0,sizeof(buffer));
+  buffer[4]=running?0x03:0x02;
+  memcpy(&buffer[5],mac,6);
+  buffer[11]=device;
+  buffer[13]=software_version;
+  buffer[20]=ddcs;
+  sendto(s,buffer,sizeof(buffer),0,(struct sockaddr *)addr,sizeof(*addr));
+}
+
+static void p2_start(void) {
+  int i;
+  g_mutex_lock(&state_mutex);
+  for(i=0;i<MAX_DDC;i++) {
+    p2_ddc[i].sequence=0;
+    p2_ddc[i].sent=0;
+    p2_ddc[i].start_time=g_get_monotonic_time();
+  }
+  stream_start(&p2_mic,48000,P2_MIC_SAMPLES_PER_PACKET,1000.0,99);
+  p2_high_priority_sequence=0;
+  fifo_model_init(&p2_tx,P2_TX_RATE,P2_TX_SAMPLES_PER_PACKET);
+  fifo_model_init(&p2_audio,P2_AUDIO_RATE,P2_AUDIO_SAMPLES_PER_PACKET);
+  g_mutex_unlock(&state_mutex);
+}
+
+static void p2_receiver_specific(unsigned char *buffer) {
+  int i;
+  int rate;
+  g_mutex_lock(&state_mutex);
+  for(i=0;i<ddcs;i++) {
+    gboolean enabled=(buffer[7]>>i)&0x01;
+    rate=(((buffer[18+(i*6)]&0xFF)<<8)|(buffer[19+(i*6)]&0xFF))*1000;
+    if(enabled && rate>0) {
+      if(!p2_ddc[i].enabled || p2_ddc[i].rate!=rate) {
+        stream_start(&p2_ddc[i],rate,P2_DDC_SAMPLES_PER_PACKET,tone*(i+1),i+1);
+        fprintf(stderr,"hpsdr_emulator: DDC %d at %d\n",i,rate);
+      }
+    } else if(p2_ddc[i].enabled) {
+      p2_ddc[i].enabled=FALSE;
+      fprintf(stderr,"hpsdr_emulator: DDC %d disabled\n",i);
+    }
+  }
+  g_mutex_unlock(&state_mutex);
+}
+
+static void p2_process(int port,int s,unsigned char *buffer,int length,struct sockaddr_in *addr) {
+  gint64 now=g_get_monotonic_time();
+  switch(port) {
+    case P2_GENERAL_PORT:
+      if(length==60 && buffer[4]==0x02 && buffer[0]==0 && buffer[1]==0 && buffer[2]==0 && buffer[3]==0) {
+        p2_discovery_reply(s,addr);
+      } else if(length==60 && buffer[4]==0x00) {
+        set_client(addr);
+      }
+      break;
+    case P2_RECEIVER_SPECIFIC_PORT:
+      if(length>=60) p2_receiver_specific(buffer);
+      break;
+    case P2_TRANSMITTER_SPECIFIC_PORT:
+      break;
+    case P2_HIGH_PRIORITY_PORT:
+      set_client(addr);
+      if(length>=5) {
+        if((buffer[4]&0x01) && !running) {
+          fprintf(stderr,"hpsdr_emulator: start from %s:%d\n",inet_ntoa(addr->sin_addr),ntohs(addr->sin_port));
+          p2_start();
+          running=TRUE;
+        } else if(!(buffer[4]&0x01) && running) {
+          fprintf(stderr,"hpsdr_emulator: stop\n");
+          running=FALSE;
+        }
+      }
+      break;
+    case P2_AUDIO_PORT:
+      if(running) fifo_model_packet(&p2_audio,get32(buffer),now);
+      break;
+    case P2_TX_IQ_PORT:
+      if(running) fifo_model_packet(&p2_tx,get32(buffer),now);
+      break;
+  }
+}
+
+static void p2_send(gint64 now) {
+  unsigned char buffer[P2_DDC_PACKET_SIZE];
+  int i;
+  int j;
+  int isample;
+  int qsample;
+  long due;
+
+  g_mutex_lock(&state_mutex);
+  for(i=0;i<ddcs;i++) {
+    STREAM *s=&p2_ddc[i];
+    due=stream_due(s,now);
+    while(due-->0) {
+      gint64 timestamp=s->sent*(gint64)s->samples_per_packet;
+      unsigned char *b=&buffer[16];
+      put32(&buffer[0],s->sequence++);
+      put32(&buffer[4],timestamp>>32);
+      put32(&buffer[8],timestamp);
+      buffer[12]=0;
+      buffer[13]=24;
+      buffer[14]=P2_DDC_SAMPLES_PER_PACKET>>8;
+      buffer[15]=P2_DDC_SAMPLES_PER_PACKET&0xFF;
+      for(j=0;j<P2_DDC_SAMPLES_PER_PACKET;j++) {
+        source_next(&s->source,&isample,&qsample,8388607.0);
+        put24(b,isample);
+        put24(b+3,qsample);
+        b+=6;
+      }
+      s->sent++;
+      send_to_client(ddc_sockets[i],buffer,P2_DDC_PACKET_SIZE);
+    }
+  }
+
+  due=stream_due(&p2_mic,now);
+  while(due-->0) {
+    unsigned char *b=&buffer[4];
+    put32(&buffer[0],p2_mic.sequence++);
+    for(j=0;j<P2_MIC_SAMPLES_PER_PACKET;j++) {
+      source_next(&p2_mic.source,&isample,&qsample,32767.0);
+      b[0]=isample>>8;
+      b[1]=isample;
+      b+=2;
+    }
+    p2_mic.sent++;
+    send_to_client(sockets[P2_MIC_TO_HOST_PORT-P2_GENERAL_PORT],buffer,P2_MIC_PACKET_SIZE);
+  }
+
+  // status every 50ms
+  if((now-p2_mic.start_time)/50000>=p2_high_priority_sequence) {
+    memset(buffer,0,60);
+    put32(&buffer[0],p2_high_priority_sequence++);
+    buffer[4]=0x08; // PLL locked
+    send_to_client(sockets[P2_HIGH_PRIORITY_TO_HOST_PORT-P2_GENERAL_PORT],buffer,60);
+  }
+  g_mutex_unlock(&state_mutex);
+}
+
+//
+// threads
+//
+
+static gpointer receive_thread(gpointer data) {
+  struct pollfd fds[P2_RECEIVE_PORTS];
+  unsigned char buffer[2048];
+  struct sockaddr_in addr;
+  socklen_t length;
+  int n=protocol==1?1:P2_RECEIVE_PORTS;
+  int i;
+  int bytes;
+
+  for(i=0;i<n;i++) {
+    fds[i].fd=sockets[i];
+    fds[i].events=POLLIN;
+  }
+  while(1) {
+    if(poll(fds,n,-1)<0) {
+      if(errno==EINTR) continue;
+      perror("hpsdr_emulator: poll");
+      exit(-1);
+    }
+    for(i=0;i<n;i++) {
+      if(!(fds[i].revents&POLLIN)) continue;
+      length=sizeof(addr);
+      bytes=recvfrom(sockets[i],buffer,sizeof(buffer),0,(struct sockaddr *)&addr,&length);
+      if(bytes<0) continue;
+      if(protocol==1) {
+        p1_process(sockets[0],buffer,bytes,&addr);
+      } else {
+        p2_process(P2_GENERAL_PORT+i,sockets[i],buffer,bytes,&addr);
+      }
+    }
+  }
+  return NULL;
+}
+
+static gpointer send_thread(gpointer data) {
+  while(1) {
+    gint64 now=g_get_monotonic_time();
+    if(running && have_client) {
+      if(protocol==1) {
+        p1_send(sockets[0],now);
+      } else {
+        p2_send(now);
+      }
+    }
+    g_usleep(500);
+  }
+  return NULL;
+}
+
+static void report(FIFO_MODEL *f,const char *name,long *last) {
+  fprintf(stderr," %s: %ld/s gaps=%ld late=%ld overflows=%ld",name,f->packets-*last,f->gaps,f->late,f->overflows);
+  *last=f->packets;
+}
+
+static void usage(char *name) {
+  fprintf(stderr,"usage: %s [options]\n",name);
+  fprintf(stderr,"  -p, --protocol N    1 or 2 (default 1)\n");
+  fprintf(stderr,"  -d, --device N      device code sent in the discovery reply\n");
+  fprintf(stderr,"                      (default %d for protocol 1, %d for protocol 2)\n",OLD_DEVICE_ANGELIA,NEW_DEVICE_ORION2);
+  fprintf(stderr,"  -r, --receivers N   receivers/DDCs reported (default %d)\n",MAX_DDC);
+  fprintf(stderr,"  -t, --tone HZ       tone offset of the first receiver (default %.0f)\n",tone);
+  fprintf(stderr,"  -a, --amplitude A   tone amplitude, full scale 1.0 (default %g)\n",amplitude);
+  fprintf(stderr,"  -n, --noise A       noise amplitude, full scale 1.0 (default %g)\n",noise);
+  fprintf(stderr,"  -v, --verbose\n");
+}
+
+int main(int argc,char **argv) {
+  static struct option options[]={
+    {"protocol",required_argument,NULL,'p'},
+    {"device",required_argument,NULL,'d'},
+    {"receivers",required_argument,NULL,'r'},
+    {"tone",required_argument,NULL,'t'},
+    {"amplitude",required_argument,NULL,'a'},
+    {"noise",required_argument,NULL,'n'},
+    {"verbose",no_argument,NULL,'v'},
+    {"help",no_argument,NULL,'h'},
+    {NULL,0,NULL,0}
+  };
+  long last_sent[MAX_DDC+1];
+  long last_tx=0;
+  long last_audio=0;
+  int c;
+  int i;
+
+  while((c=getopt_long(argc,argv,"p:d:r:t:a:n:vh",options,NULL))!=-1) {
+    switch(c) {
+      case 'p': protocol=atoi(optarg); break;
+      case 'd': device=atoi(optarg); break;
+      case 'r': ddcs=atoi(optarg); break;
+      case 't': tone=atof(optarg); break;
+      case 'a': amplitude=atof(optarg); break;
+      case 'n': noise=atof(optarg); break;
+      case 'v': verbose=TRUE; break;
+      default:
+        usage(argv[0]);
+        exit(c=='h'?0:-1);
+    }
+  }
+  if(protocol!=1 && protocol!=2) {
+    usage(argv[0]);
+    exit(-1);
+  }
+  if(ddcs<1) ddcs=1;
+  if(ddcs>MAX_DDC) ddcs=MAX_DDC;
+  if(device<0) {
+    device=protocol==1?OLD_DEVICE_ANGELIA:NEW_DEVICE_ORION2;
+  }
+
+  g_mutex_init(&state_mutex);
+  g_mutex_init(&client_mutex);
+  memset(last_sent,0,sizeof(last_sent));
+
+  if(protocol==1) {
+    sockets[0]=open_socket(P1_PORT);
+    fifo_model_init(&p1_tx,P1_TX_RATE,P1_TX_SAMPLES_PER_PACKET);
+  } else {
+    for(i=0;i<P2_RECEIVE_PORTS;i++) {
+      sockets[i]=open_socket(P2_GENERAL_PORT+i);
+    }
+    for(i=0;i<ddcs;i++) {
+      ddc_sockets[i]=open_socket(P2_DDC_TO_HOST_PORT+i);
+    }
+    fifo_model_init(&p2_tx,P2_TX_RATE,P2_TX_SAMPLES_PER_PACKET);
+    fifo_model_init(&p2_audio,P2_AUDIO_RATE,P2_AUDIO_SAMPLES_PER_PACKET);
+  }
+  fprintf(stderr,"hpsdr_emulator: protocol %d device %d with %d receivers\n",protocol,device,ddcs);
+
+  g_thread_new("emulator receive",receive_thread,NULL);
+  g_thread_new("emulator send",send_thread,NULL);
+
+  while(1) {
+    sleep(1);
+    if(!running) continue;
+    g_mutex_lock(&state_mutex);
+    if(protocol==1) {
+      fprintf(stderr,"EP6: %ld/s (%d rx at %d)",p1_stream.sent-last_sent[0],p1_receivers,p1_sample_rate);
+      last_sent[0]=p1_stream.sent;
+      report(&p1_tx,"EP2",&last_tx);
+    } else {
+      fprintf(stderr,"DDC:");
+      for(i=0;i<ddcs;i++) {
+        if(p2_ddc[i].enabled) {
+          fprintf(stderr," %d:%ld/s",i,p2_ddc[i].sent-last_sent[i]);
+        }
+        last_sent[i]=p2_ddc[i].sent;
+      }
+      report(&p2_tx,"TX IQ",&last_tx);
+      report(&p2_audio,"audio",&last_audio);
+    }
+    fprintf(stderr,"\n");
+    g_mutex_unlock(&state_mutex);
+  }
+  return 0;
+}
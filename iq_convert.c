@@ -0,0 +1,280 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "iq_convert.h"
+
+//
+// convert count complex samples to interleaved doubles
+// stride is the distance in bytes from one I/Q pair to the next, so
+// interleaved Protocol 1 frames and decimated streams can be converted
+// in place without first copying them out
+//
+
+static inline int int24_be(const unsigned char *b) {
+  return (int)((signed char)b[0]<<16) | (int)((b[1]<<8)&0xFF00) | (int)(b[2]&0xFF);
+}
+
+static void convert_int24_be(const unsigned char *src,int stride,double *dst,int count,double scale) {
+  int i=0;
+#ifdef __SSSE3__
+  // bytes are shuffled into the top 3 bytes of each 32 bit lane and then
+  // shifted down arithmetically to sign extend
+  const __m128d s=_mm_set1_pd(scale);
+  if(stride==6) {
+    // 2 samples per 16 byte load, the load reads 4 bytes of sample i+2
+    const __m128i shuffle=_mm_setr_epi8(-1,2,1,0, -1,5,4,3, -1,8,7,6, -1,11,10,9);
+    for(;i+2<count;i+=2) {
+      __m128i v=_mm_loadu_si128((const __m128i *)&src[i*6]);
+      v=_mm_srai_epi32(_mm_shuffle_epi8(v,shuffle),8);
+      _mm_storeu_pd(&dst[i*2],_mm_mul_pd(_mm_cvtepi32_pd(v),s));
+      _mm_storeu_pd(&dst[(i*2)+2],_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v,8)),s));
+    }
+  } else if(stride>6) {
+    // 1 sample per 8 byte load, the extra 2 bytes are inside the stride
+    const __m128i shuffle=_mm_setr_epi8(-1,2,1,0, -1,5,4,3, -1,-1,-1,-1, -1,-1,-1,-1);
+    for(;i<count;i++) {
+      __m128i v=_mm_loadl_epi64((const __m128i *)&src[i*stride]);
+      v=_mm_srai_epi32(_mm_shuffle_epi8(v,shuffle),8);
+      _mm_storeu_pd(&dst[i*2],_mm_mul_pd(_mm_cvtepi32_pd(v),s));
+    }
+  }
+#endif
+  for(;i<count;i++) {
+    const unsigned char *b=&src[i*stride];
+    dst[i*2]=(double)int24_be(b)*scale;
+    dst[(i*2)+1]=(double)int24_be(b+3)*scale;
+  }
+}
+
+static void convert_int16_le(const unsigned char *src,int stride,double *dst,int count,double scale) {
+  int i=0;
+#if defined(__SSE2__) || defined(__SSSE3__)
+  if(stride==4) {
+    // 4 samples per load, sign extend by unpacking into the top half
+    const __m128d s=_mm_set1_pd(scale);
+    for(;i+4<=count;i+=4) {
+      __m128i v=_mm_loadu_si128((const __m128i *)&src[i*4]);
+      __m128i lo=_mm_srai_epi32(_mm_unpacklo_epi16(v,v),16);
+      __m128i hi=_mm_srai_epi32(_mm_unpackhi_epi16(v,v),16);
+      _mm_storeu_pd(&dst[i*2],_mm_mul_pd(_mm_cvtepi32_pd(lo),s));
+      _mm_storeu_pd(&dst[(i*2)+2],_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo,8)),s));
+      _mm_storeu_pd(&dst[(i*2)+4],_mm_mul_pd(_mm_cvtepi32_pd(hi),s));
+      _mm_storeu_pd(&dst[(i*2)+6],_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi,8)),s));
+    }
+  }
+#endif
+  for(;i<count;i++) {
+    const unsigned char *b=&src[i*stride];
+    dst[i*2]=(double)(short)(b[0]|(b[1]<<8))*scale;
+    dst[(i*2)+1]=(double)(short)(b[2]|(b[3]<<8))*scale;
+  }
+}
+
+static void convert_float32(const unsigned char *src,int stride,double *dst,int count,double scale) {
+  int i=0;
+  float f[2];
+#if defined(__SSE2__) || defined(__SSSE3__)
+  const __m128d s=_mm_set1_pd(scale);
+  for(;i<count;i++) {
+    __m128 v=_mm_castpd_ps(_mm_load_sd((const double *)&src[i*stride]));
+    _mm_storeu_pd(&dst[i*2],_mm_mul_pd(_mm_cvtps_pd(v),s));
+  }
+#endif
+  for(;i<count;i++) {
+    memcpy(f,&src[i*stride],sizeof(f));
+    dst[i*2]=(double)f[0]*scale;
+    dst[(i*2)+1]=(double)f[1]*scale;
+  }
+}
+
+static void convert_int16_be(const unsigned char *src,int stride,double *dst,int count,double scale) {
+  int i;
+  for(i=0;i<count;i++) {
+    const unsigned char *b=&src[i*stride];
+    dst[i*2]=(double)(short)((b[0]<<8)|b[1])*scale;
+    dst[(i*2)+1]=(double)(short)((b[2]<<8)|b[3])*scale;
+  }
+}
+
+static void convert_double(const unsigned char *src,int stride,double *dst,int count,double scale) {
+  int i;
+  double d[2];
+  for(i=0;i<count;i++) {
+    memcpy(d,&src[i*stride],sizeof(d));
+    dst[i*2]=d[0]*scale;
+    dst[(i*2)+1]=d[1]*scale;
+  }
+}
+
+void iq_convert(IQ_FORMAT format,const unsigned char *src,int stride,double *dst,int count,double scale) {
+  switch(format) {
+    case IQ_INT24_BE:
+      convert_int24_be(src,stride,dst,count,scale);
+      break;
+    case IQ_INT16_LE:
+      convert_int16_le(src,stride,dst,count,scale);
+      break;
+    case IQ_FLOAT32:
+      convert_float32(src,stride,dst,count,scale);
+      break;
+    case IQ_DOUBLE:
+      convert_double(src,stride,dst,count,scale);
+      break;
+    case IQ_INT16_BE:
+      convert_int16_be(src,stride,dst,count,scale);
+      break;
+  }
+}
+
+//
+// the reverse: scale count interleaved double pairs, round to nearest and
+// clip them to the integer range and store them packed and big endian
+//
+static inline long pack_sample(double x,double scale,long max) {
+  long v=lrint(x*scale);
+  if(v>max) return max;
+  if(v<-max-1) return -max-1;
+  return v;
+}
+
+static void pack_int16_be(const double *src,unsigned char *dst,int count,double scale) {
+  int i=0;
+  long v;
+#if defined(__SSE2__) || defined(__SSSE3__)
+  // 4 pairs per store, clipped before the conversion so it cannot overflow
+  const __m128d s=_mm_set1_pd(scale);
+  const __m128d hi=_mm_set1_pd(32767.0);
+  const __m128d lo=_mm_set1_pd(-32768.0);
+  for(;i+4<=count;i+=4) {
+    __m128i a=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[i*2]),s),hi),lo));
+    __m128i b=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+2]),s),hi),lo));
+    __m128i c=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+4]),s),hi),lo));
+    __m128i d=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+6]),s),hi),lo));
+    __m128i v=_mm_packs_epi32(_mm_unpacklo_epi64(a,b),_mm_unpacklo_epi64(c,d));
+    v=_mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8));
+    _mm_storeu_si128((__m128i *)&dst[i*4],v);
+  }
+#endif
+  for(i=i*2;i<count*2;i++) {
+    v=pack_sample(src[i],scale,32767);
+    dst[i*2]=v>>8;
+    dst[(i*2)+1]=v;
+  }
+}
+
+static void pack_int24_be(const double *src,unsigned char *dst,int count,double scale) {
+  int i=0;
+  long v;
+#ifdef __SSSE3__
+  // 2 pairs per 16 byte store, the last 4 bytes are overwritten by the
+  // next pair so the loop stops while there is room for them
+  const __m128d s=_mm_set1_pd(scale);
+  const __m128d hi=_mm_set1_pd(8388607.0);
+  const __m128d lo=_mm_set1_pd(-8388608.0);
+  const __m128i shuffle=_mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1);
+  for(;i+2<count;i+=2) {
+    __m128i a=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[i*2]),s),hi),lo));
+    __m128i b=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+2]),s),hi),lo));
+    _mm_storeu_si128((__m128i *)&dst[i*6],_mm_shuffle_epi8(_mm_unpacklo_epi64(a,b),shuffle));
+  }
+#endif
+  for(i=i*2;i<count*2;i++) {
+    v=pack_sample(src[i],scale,8388607);
+    dst[i*3]=v>>16;
+    dst[(i*3)+1]=v>>8;
+    dst[(i*3)+2]=v;
+  }
+}
+
+void iq_pack(IQ_FORMAT format,const double *src,unsigned char *dst,int count,double scale) {
+  switch(format) {
+    case IQ_INT16_BE:
+      pack_int16_be(src,dst,count,scale);
+      break;
+    case IQ_INT24_BE:
+      pack_int24_be(src,dst,count,scale);
+      break;
+    default:
+      fprintf(stderr,"iq_pack: format %d not supported\n",format);
+      break;
+  }
+}
+
+// exchange I and Q
+void iq_swap(double *iq,int count) {
+  int i;
+  double t;
+  for(i=0;i<count;i++) {
+    t=iq[i*2];
+    iq[i*2]=iq[(i*2)+1];
+    iq[(i*2)+1]=t;
+  }
+}
+
+//
+// Protocol 1 EP2 frames: 8 bytes per sample holding L,R,I,Q as 16 bit big
+// endian, the pair is packed at offset 0 (audio) or 4 (TX I/Q) and the
+// other half of the frame is zeroed
+//
+void iq_pack_frames(const double *src,unsigned char *dst,int count,int offset,double scale) {
+  int i=0;
+  long v;
+#if defined(__SSE2__) || defined(__SSSE3__)
+  // 4 frames per pair of stores
+  const __m128d s=_mm_set1_pd(scale);
+  const __m128d hi=_mm_set1_pd(32767.0);
+  const __m128d lo=_mm_set1_pd(-32768.0);
+  const __m128i zero=_mm_setzero_si128();
+  for(;i+4<=count;i+=4) {
+    __m128i a=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[i*2]),s),hi),lo));
+    __m128i b=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+2]),s),hi),lo));
+    __m128i c=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+4]),s),hi),lo));
+    __m128i d=_mm_cvtpd_epi32(_mm_max_pd(_mm_min_pd(_mm_mul_pd(_mm_loadu_pd(&src[(i*2)+6]),s),hi),lo));
+    __m128i w=_mm_packs_epi32(_mm_unpacklo_epi64(a,b),_mm_unpacklo_epi64(c,d));
+    w=_mm_or_si128(_mm_slli_epi16(w,8),_mm_srli_epi16(w,8));
+    if(offset==0) {
+      _mm_storeu_si128((__m128i *)&dst[i*8],_mm_unpacklo_epi32(w,zero));
+      _mm_storeu_si128((__m128i *)&dst[(i*8)+16],_mm_unpackhi_epi32(w,zero));
+    } else {
+      _mm_storeu_si128((__m128i *)&dst[i*8],_mm_unpacklo_epi32(zero,w));
+      _mm_storeu_si128((__m128i *)&dst[(i*8)+16],_mm_unpackhi_epi32(zero,w));
+    }
+  }
+#endif
+  for(;i<count;i++) {
+    unsigned char *f=&dst[i*8];
+    memset(f,0,8);
+    v=pack_sample(src[i*2],scale,32767);
+    f[offset]=v>>8;
+    f[offset+1]=v;
+    v=pack_sample(src[(i*2)+1],scale,32767);
+    f[offset+2]=v>>8;
+    f[offset+3]=v;
+  }
+}
@@ -0,0 +1,40 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef IQ_CONVERT_H
+#define IQ_CONVERT_H
+
+//
+// native sample formats delivered by the radio backends
+//
+typedef enum {
+  IQ_INT24_BE=0,  // Protocol 1 and Protocol 2 I/Q
+  IQ_INT16_LE,    // Protocol 1 wideband, SoapySDR CS16
+  IQ_FLOAT32,     // SoapySDR CF32
+  IQ_DOUBLE,
+  IQ_INT16_BE     // Protocol 1 and Protocol 2 audio, Protocol 1 TX I/Q
+} IQ_FORMAT;
+
+extern void iq_convert(IQ_FORMAT format,const unsigned char *src,int stride,double *dst,int count,double scale);
+extern void iq_pack(IQ_FORMAT format,const double *src,unsigned char *dst,int count,double scale);
+extern void iq_pack_frames(const double *src,unsigned char *dst,int count,int offset,double scale);
+extern void iq_swap(double *iq,int count);
+
+#endif
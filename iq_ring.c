@@ -0,0 +1,101 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "iq_ring.h"
+
+IQ_RING *iq_ring_new(int blocks,int block_size) {
+  IQ_RING *ring=g_new0(IQ_RING,1);
+  ring->blocks=blocks;
+  ring->block_size=block_size;
+  ring->buffer=g_new0(gdouble,blocks*block_size*2);
+  ring->timestamps=g_new0(IQ_TIMESTAMP,blocks);
+  ring->head=0;
+  ring->tail=0;
+  ring->max_depth=0;
+  ring->overruns=0;
+  return ring;
+}
+
+void iq_ring_free(IQ_RING *ring) {
+  if(ring==NULL) return;
+  g_free(ring->buffer);
+  g_free(ring->timestamps);
+  g_free(ring);
+}
+
+gint iq_ring_depth(IQ_RING *ring) {
+  return (gint)((guint)g_atomic_int_get(&ring->head)-(guint)g_atomic_int_get(&ring->tail));
+}
+
+//
+// producer: copy a complete block and its time tag into the ring
+// timestamp may be NULL if the radio does not provide one
+// returns FALSE and counts an overrun if the consumer has fallen behind
+//
+gboolean iq_ring_put(IQ_RING *ring,gdouble *block,const IQ_TIMESTAMP *timestamp) {
+  guint head=(guint)g_atomic_int_get(&ring->head);
+  gint depth=(gint)(head-(guint)g_atomic_int_get(&ring->tail));
+
+  if(depth>=ring->blocks) {
+    ring->overruns++;
+    return FALSE;
+  }
+  memcpy(&ring->buffer[(head%ring->blocks)*ring->block_size*2],block,ring->block_size*2*sizeof(gdouble));
+  if(timestamp!=NULL) {
+    ring->timestamps[head%ring->blocks]=*timestamp;
+  } else {
+    ring->timestamps[head%ring->blocks].timestamp=IQ_TIMESTAMP_NONE;
+    ring->timestamps[head%ring->blocks].offset=0;
+  }
+  ring->timestamps[head%ring->blocks].queued=g_get_monotonic_time();
+  g_atomic_int_set(&ring->head,head+1);
+  if(depth+1>ring->max_depth) {
+    ring->max_depth=depth+1;
+  }
+  return TRUE;
+}
+
+//
+// consumer: the oldest block or NULL if the ring is empty
+// the block stays valid until iq_ring_release()
+//
+gdouble *iq_ring_get(IQ_RING *ring) {
+  guint tail;
+  tail=(guint)g_atomic_int_get(&ring->tail);
+  if(tail==(guint)g_atomic_int_get(&ring->head)) {
+    return NULL;
+  }
+  return &ring->buffer[(tail%ring->blocks)*ring->block_size*2];
+}
+
+//
+// consumer: the time tag of the block returned by iq_ring_get()
+//
+IQ_TIMESTAMP *iq_ring_get_timestamp(IQ_RING *ring) {
+  return &ring->timestamps[(guint)g_atomic_int_get(&ring->tail)%ring->blocks];
+}
+
+void iq_ring_release(IQ_RING *ring) {
+  g_atomic_int_set(&ring->tail,(guint)g_atomic_int_get(&ring->tail)+1);
+}
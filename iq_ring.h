@@ -0,0 +1,64 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef IQ_RING_H
+#define IQ_RING_H
+
+#define IQ_RING_BLOCKS 16
+
+#define IQ_TIMESTAMP_NONE G_MININT64
+
+//
+// radio time tag for a block, sample offset in the block was taken at
+// timestamp (in the radio's own clock units)
+// queued is the host's g_get_monotonic_time() when the block was put on
+// the ring, set by iq_ring_put()
+//
+typedef struct _iq_timestamp {
+  gint64 timestamp;
+  gint offset;
+  gint64 queued;
+} IQ_TIMESTAMP;
+
+//
+// single producer/single consumer ring of I/Q blocks
+// the network receive thread puts complete blocks and the DSP pool takes
+// them, the only synchronization is the head/tail counters
+//
+typedef struct _iq_ring {
+  gint blocks;
+  gint block_size;
+  gdouble *buffer;
+  IQ_TIMESTAMP *timestamps;
+  guint head;
+  guint tail;
+  gint max_depth;
+  glong overruns;
+} IQ_RING;
+
+extern IQ_RING *iq_ring_new(int blocks,int block_size);
+extern void iq_ring_free(IQ_RING *ring);
+extern gboolean iq_ring_put(IQ_RING *ring,gdouble *block,const IQ_TIMESTAMP *timestamp);
+extern gdouble *iq_ring_get(IQ_RING *ring);
+extern IQ_TIMESTAMP *iq_ring_get_timestamp(IQ_RING *ring);
+extern void iq_ring_release(IQ_RING *ring);
+extern gint iq_ring_depth(IQ_RING *ring);
+
+#endif
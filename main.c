@@ -24,12 +24,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <semaphore.h>
+#include <signal.h>
 #include <sys/utsname.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <pwd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <glib-unix.h>
 #include <wdsp.h>
 
 #include "css.h"
@@ -52,6 +54,8 @@
 #include "property.h"
 #include "rigctl.h"
 #include "version.h"
+#include "capture.h"
+#include "dsp_pool.h"
 
 GtkWidget *main_window;
 static GtkWidget *grid;
@@ -72,6 +76,8 @@ static DISCOVERED *d=NULL;
 
 RADIO *radio;
 gboolean opengl=FALSE;
+gboolean headless=FALSE;
+static char *headless_radio=NULL;
 
 enum {
   NAME_COLUMN,
@@ -102,6 +108,7 @@ static gboolean main_delete (GtkWidget *widget) {
     }
     audio_close_input(radio);
     //audio_close_output(radio);
+    dsp_pool_shutdown();
   }    
   _exit(0);
 }
@@ -546,6 +553,102 @@ static void activate_hpsdr(GtkApplication *app, gpointer data) {
 
 }
 
+static gboolean headless_quit(gpointer data) {
+  g_print("headless: stopping\n");
+  main_delete(NULL);
+  return FALSE;
+}
+
+static DISCOVERED *headless_select() {
+  char ip[32];
+  char mac[32];
+  int i;
+
+  for(i=0;i<devices;i++) {
+    DISCOVERED *dev=&discovered[i];
+    if(dev->status!=STATE_AVAILABLE) {
+      continue;
+    }
+    if(headless_radio==NULL) {
+      return dev;
+    }
+    switch(dev->device) {
+#ifdef SOAPYSDR
+      case DEVICE_SOAPYSDR:
+        strcpy(ip,dev->info.soapy.address);
+        strcpy(mac,dev->name);
+        break;
+#endif
+      default:
+        g_snprintf(mac,sizeof(mac),"%02X:%02X:%02X:%02X:%02X:%02X",
+          dev->info.network.mac_address[0],
+          dev->info.network.mac_address[1],
+          dev->info.network.mac_address[2],
+          dev->info.network.mac_address[3],
+          dev->info.network.mac_address[4],
+          dev->info.network.mac_address[5]);
+        strcpy(ip,inet_ntoa(dev->info.network.address.sin_addr));
+        break;
+    }
+    if(g_ascii_strcasecmp(headless_radio,ip)==0 || g_ascii_strcasecmp(headless_radio,mac)==0) {
+      return dev;
+    }
+  }
+  return NULL;
+}
+
+//
+// start the radio with no GTK at all: the wisdom file is created in the
+// foreground, the device is picked from the command line and the main loop
+// only runs the timers and idle callbacks used by the protocol, rigctl and MIDI
+//
+static int run_headless() {
+  char wisdom_directory[1024];
+  char wisdom_file[1024];
+  GMainLoop *loop;
+
+  g_print("Build: %s %s (headless)\n",build_date,version);
+
+  sprintf(wisdom_directory,"%s/.local/share/linhpsdr/",g_get_home_dir());
+  sprintf(wisdom_file,"%swdspWisdom",wisdom_directory);
+  if(access(wisdom_file,F_OK)<0) {
+    g_print("Creating wisdom file: %s (this will take several minutes)\n",wisdom_directory);
+    WDSPwisdom(wisdom_directory);
+  }
+
+  discovery();
+  g_print("main: discovery found %d devices\n",devices);
+  d=headless_select();
+  if(d==NULL) {
+    g_print("headless: no available radio%s%s\n",headless_radio!=NULL?" matching ":"",headless_radio!=NULL?headless_radio:"");
+    return 1;
+  }
+  g_print("starting %s %s (headless)\n",d->name,d->software_version);
+
+  loop=g_main_loop_new(NULL,FALSE);
+  radio=create_radio(d);
+  g_unix_signal_add(SIGINT,headless_quit,NULL);
+  g_unix_signal_add(SIGTERM,headless_quit,NULL);
+  g_main_loop_run(loop);
+  return 0;
+}
+
+static gint handle_local_options(GApplication *app, GVariantDict *options, gpointer data) {
+  if(headless) {
+    return run_headless();
+  }
+  return -1;
+}
+
+static GOptionEntry option_entries[] = {
+  { "capture", 0, 0, G_OPTION_ARG_FILENAME, &capture_filename, "Record the datagrams received from the radio to FILE", "FILE" },
+  { "replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_filename, "Play back a capture FILE instead of using a radio", "FILE" },
+  { "replay-fast", 0, 0, G_OPTION_ARG_NONE, &replay_fast, "Play back the capture as fast as possible", NULL },
+  { "headless", 0, 0, G_OPTION_ARG_NONE, &headless, "Run the radio without any windows", NULL },
+  { "radio", 0, 0, G_OPTION_ARG_STRING, &headless_radio, "Start the radio with this IP or MAC ADDRESS when headless (default the first one found)", "ADDRESS" },
+  { NULL }
+};
+
 int main(int argc, char **argv) {
   GtkApplication *hpsdr;
   char text[1024];
@@ -564,6 +667,8 @@ int main(int argc, char **argv) {
 
   sprintf(text,"org.g0orx.hpsdr.pid%d",getpid());
   hpsdr=gtk_application_new(text, G_APPLICATION_FLAGS_NONE);
+  g_application_add_main_option_entries(G_APPLICATION(hpsdr), option_entries);
+  g_signal_connect(hpsdr, "handle-local-options", G_CALLBACK(handle_local_options), NULL);
   g_signal_connect(hpsdr, "activate", G_CALLBACK(activate_hpsdr), NULL);
   rc=g_application_run(G_APPLICATION(hpsdr), argc, argv);
   g_object_unref(hpsdr);
@@ -23,3 +23,4 @@
 extern GtkWidget *main_window;
 extern RADIO *radio;
 extern gboolean opengl;
+extern gboolean headless;
@@ -0,0 +1,54 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+#include "receiver.h"
+#include "receiver_dsp.h"
+#include "ozy_frame.h"
+
+//
+// split a 512 byte Protocol 1 ozy frame
+// the sync is checked once, the control bytes are copied to control_in and
+// each receiver's I/Q is converted straight out of the frame as one block.
+// rx has nrx entries, NULL for a receiver that is not running. the mic
+// samples are left to the caller, at buffer[8+(nrx*6)] with the same stride.
+// returns FALSE if the frame has no sync
+//
+gboolean ozy_frame_parse(const unsigned char *buffer,RECEIVER **rx,int nrx,unsigned char *control_in) {
+  int r;
+  int stride;
+  int iq_samples;
+
+  if(buffer[0]!=SYNC || buffer[1]!=SYNC || buffer[2]!=SYNC) {
+    return FALSE;
+  }
+  memcpy(control_in,&buffer[3],5);
+
+  stride=(nrx*6)+2;
+  iq_samples=OZY_FRAME_SAMPLES(nrx);
+  for(r=0;r<nrx;r++) {
+    if(rx[r]!=NULL) {
+      add_iq_block(rx[r],&buffer[8+(r*6)],IQ_INT24_BE,stride,iq_samples,1.0/8388607.0,FALSE); // 24 bit sample 2^23-1
+    }
+  }
+  return TRUE;
+}
@@ -0,0 +1,32 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef OZY_FRAME_H
+#define OZY_FRAME_H
+
+#define SYNC 0x7F
+#define OZY_BUFFER_SIZE 512
+
+// I/Q samples per ozy frame, each is nrx I/Q pairs and a mic sample
+#define OZY_FRAME_SAMPLES(nrx) ((OZY_BUFFER_SIZE-8)/(((nrx)*6)+2))
+
+extern gboolean ozy_frame_parse(const unsigned char *buffer,RECEIVER **rx,int nrx,unsigned char *control_in);
+
+#endif
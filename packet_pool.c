@@ -0,0 +1,88 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet_pool.h"
+
+PACKET_POOL *packet_pool_new(int size,int buffer_size) {
+  int i;
+  PACKET_POOL *pool;
+
+  // keep every buffer on its own cache lines
+  buffer_size=(buffer_size+PACKET_POOL_ALIGNMENT-1)&~(PACKET_POOL_ALIGNMENT-1);
+
+  pool=g_new0(PACKET_POOL,1);
+  pool->size=size;
+  pool->buffer_size=buffer_size;
+  if(posix_memalign((void **)&pool->memory,PACKET_POOL_ALIGNMENT,(size_t)size*buffer_size)!=0) {
+    fprintf(stderr,"packet_pool_new: posix_memalign failed for %d buffers\n",size);
+    exit(-1);
+  }
+  memset(pool->memory,0,(size_t)size*buffer_size);
+  pool->packets=g_new0(PACKET,size);
+
+  pool->free_list=NULL;
+  for(i=size-1;i>=0;i--) {
+    pool->packets[i].buffer=&pool->memory[i*buffer_size];
+    pool->packets[i].next=pool->free_list;
+    pool->free_list=&pool->packets[i];
+  }
+  pool->in_use=0;
+  pool->max_in_use=0;
+  pool->exhausted=0;
+  return pool;
+}
+
+void packet_pool_free(PACKET_POOL *pool) {
+  if(pool==NULL) return;
+  if(pool->in_use!=0) {
+    fprintf(stderr,"packet_pool_free: %d packets still in use\n",pool->in_use);
+  }
+  free(pool->memory);
+  g_free(pool->packets);
+  g_free(pool);
+}
+
+PACKET *packet_pool_get(PACKET_POOL *pool) {
+  PACKET *packet=pool->free_list;
+  if(packet==NULL) {
+    pool->exhausted++;
+    return NULL;
+  }
+  pool->free_list=packet->next;
+  packet->next=NULL;
+  packet->length=0;
+  packet->port=0;
+  pool->in_use++;
+  if(pool->in_use>pool->max_in_use) {
+    pool->max_in_use=pool->in_use;
+  }
+  return packet;
+}
+
+void packet_pool_release(PACKET_POOL *pool,PACKET *packet) {
+  if(packet==NULL) return;
+  packet->next=pool->free_list;
+  pool->free_list=packet;
+  pool->in_use--;
+}
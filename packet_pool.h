@@ -0,0 +1,52 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#define PACKET_POOL_ALIGNMENT 64
+
+typedef struct _packet {
+  unsigned char *buffer;
+  int length;
+  int port;
+  struct _packet *next;
+} PACKET;
+
+//
+// fixed set of cache aligned packet buffers allocated once at startup
+// a pool belongs to a single receive thread so there is no locking
+//
+typedef struct _packet_pool {
+  int size;
+  int buffer_size;
+  unsigned char *memory;
+  PACKET *packets;
+  PACKET *free_list;
+  int in_use;
+  int max_in_use;
+  long exhausted;
+} PACKET_POOL;
+
+extern PACKET_POOL *packet_pool_new(int size,int buffer_size);
+extern void packet_pool_free(PACKET_POOL *pool);
+extern PACKET *packet_pool_get(PACKET_POOL *pool);
+extern void packet_pool_release(PACKET_POOL *pool,PACKET *packet);
+
+#endif
@@ -17,6 +17,7 @@
 *
 */
 
+#define _GNU_SOURCE
 #include <gtk/gtk.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -43,6 +44,7 @@
 #include "mode.h"
 #include "filter.h"
 #include "receiver.h"
+#include "receiver_dsp.h"
 #include "transmitter.h"
 #include "wideband.h"
 #include "adc.h"
@@ -57,6 +59,11 @@
 //#include "vox.h"
 #include "ext.h"
 #include "error_handler.h"
+#include "udp_batch.h"
+#include "tx_ring.h"
+#include "capture.h"
+#include "iq_convert.h"
+#include "ozy_frame.h"
 
 
 #ifdef CWDAEMON
@@ -76,8 +83,6 @@
 
 #define DATA_PORT 1024
 
-#define SYNC 0x7F
-#define OZY_BUFFER_SIZE 512
 //#define OUTPUT_BUFFER_SIZE 1024
 
 // ozy command and control
@@ -121,7 +126,10 @@ static int output_buffer_size;
 static unsigned char control_in[5]={0x00,0x00,0x00,0x00,0x00};
 
 static gboolean running;
-static long ep4_sequence;
+
+SEQUENCE_STATS ep6_stats;
+SEQUENCE_STATS ep4_stats;
+static gboolean ep4_resync;
 
 static int current_rx=0;
 
@@ -134,26 +142,12 @@ static int tx_output_buffer_index=8;
 
 static int command=1;
 
-enum {
-  SYNC_0=0,
-  SYNC_1,
-  SYNC_2,
-  CONTROL_0,
-  CONTROL_1,
-  CONTROL_2,
-  CONTROL_3,
-  CONTROL_4,
-  LEFT_SAMPLE_HI,
-  LEFT_SAMPLE_MID,
-  LEFT_SAMPLE_LOW,
-  RIGHT_SAMPLE_HI,
-  RIGHT_SAMPLE_MID,
-  RIGHT_SAMPLE_LOW,
-  MIC_SAMPLE_HI,
-  MIC_SAMPLE_LOW,
-  SKIP
-};
-static int state=SYNC_0;
+// the ep2 frame (output_buffer and its indexes, the command rotation) and
+// the metis send queue are written by the dsp pool (rx audio), the receive
+// thread (tx I/Q) and the main thread (start/stop), so all of them are
+// only touched with ep2_mutex held
+static GMutex ep2_mutex;
+
 
 static GThread *receive_thread_id;
 static void start_protocol1_thread();
@@ -162,15 +156,43 @@ static void process_ozy_input_buffer(unsigned char  *buffer);
 static void process_wideband_buffer(unsigned char  *buffer);
 void ozy_send_buffer();
 
-static unsigned char metis_buffer[1032];
+// metis packets are queued and sent together with sendmmsg
+#define METIS_BATCH 16
+
+static unsigned char metis_buffer[METIS_BATCH][1032];
+static struct mmsghdr metis_msgs[METIS_BATCH];
+static struct iovec metis_iovecs[METIS_BATCH];
+static int metis_packets=0;
 static long send_sequence=-1;
 static int metis_offset=8;
 
 static int metis_write(unsigned char ep,unsigned char* buffer,int length);
+static void metis_flush();
 static void metis_start_stop(int command);
 static void metis_send_buffer(unsigned char* buffer,int length);
 static void metis_restart();
 
+//
+// C0-C4 for each frame of the command rotation
+// slot 0 is the general frame, 1-11 the commands and the rx frequencies
+// (command 2) follow from CONTROL_RX_SLOT
+// an entry is rebuilt when protocol1_control_changed() has been called, when
+// the radio goes in or out of transmit or when it is CONTROL_REFRESH old
+//
+#define CONTROL_RX_SLOT 12
+#define CONTROL_SLOTS (CONTROL_RX_SLOT+(MAX_RECEIVERS*2))
+#define CONTROL_REFRESH (50*G_TIME_SPAN_MILLISECOND)
+
+typedef struct _control_entry {
+  unsigned char c[5];
+  gint generation;
+  gboolean transmitting;
+  gint64 built;
+} CONTROL_ENTRY;
+
+static CONTROL_ENTRY control_cache[CONTROL_SLOTS];
+static gint control_generation=1;
+
 #define COMMON_MERCURY_FREQUENCY 0x80
 #define PENELOPE_MIC 0x80
 
@@ -204,9 +226,11 @@ void protocol1_run() {
 
   start_protocol1_thread();
   
+  g_mutex_lock(&ep2_mutex);
   for(int i=8;i<OZY_BUFFER_SIZE;i++) {
     output_buffer[i]=0;
   }
+  g_mutex_unlock(&ep2_mutex);
 
   metis_restart();
 }
@@ -216,7 +240,6 @@ void protocol1_set_mic_sample_rate(int rate) {
 }
 
 void protocol1_init(RADIO *r) {
-  QueueInit();
   fprintf(stderr,"protocol1_init\n");
 
   protocol1_set_mic_sample_rate(r->sample_rate);
@@ -334,6 +357,8 @@ static void start_protocol1_thread() {
         perror("data_socket: SO_REUSEPORT");
       }
 
+      udp_set_receive_buffer(data_socket,radio->udp_receive_buffer);
+
       // bind to the interface
       if(bind(data_socket,(struct sockaddr*)&radio->discovered->info.network.interface_address,radio->discovered->info.network.interface_length)<0) {
         perror("protocol1: bind socket failed for data_socket\n");
@@ -356,18 +381,120 @@ static void start_protocol1_thread() {
 
 }
 
-static gpointer receive_thread(gpointer arg) {
-  struct sockaddr_in addr;
-  socklen_t length;
-  unsigned char buffer[2048];
-  int bytes_read;
+//
+// fill in for EP6 packets lost on the network
+// each packet carries two ozy frames for every receiver
+//
+static void conceal_ep6_packets(int packets) {
+  int j,r;
+  int nrx;
+  int iq_samples;
+
+  nrx=radio->receivers;
+  if(nrx<=0) return;
+  if(nrx>MAX_RECEIVERS) nrx=MAX_RECEIVERS;
+  if(packets>SEQUENCE_MAX_CONCEAL) packets=SEQUENCE_MAX_CONCEAL;
+  iq_samples=(OZY_BUFFER_SIZE-8)/((nrx*6)+2);
+
+  r=0;
+  for(j=0;j<radio->discovered->supported_receivers && j<MAX_RECEIVERS && r<nrx;j++) {
+    if(radio->receiver[j]!=NULL) {
+      add_iq_zeros(radio->receiver[j],packets*2*iq_samples);
+      r++;
+    }
+  }
+}
+
+static void process_metis_packet(unsigned char *buffer,int bytes_read) {
   int ep;
-  long sequence;
+  guint32 sequence;
+  gint missing;
+
+  if(buffer[0]==0xEF && buffer[1]==0xFE) {
+    switch(buffer[2]) {
+      case 1:
+        // get the end point
+        ep=buffer[3]&0xFF;
+
+        // get the sequence number
+        sequence=((buffer[4]&0xFF)<<24)+((buffer[5]&0xFF)<<16)+((buffer[6]&0xFF)<<8)+(buffer[7]&0xFF);
+
+        switch(ep) {
+          case 6: // EP6
+            missing=sequence_check(&ep6_stats,sequence);
+            if(missing<0) {
+              // duplicate or too late to use
+              break;
+            }
+            if(missing>0) {
+              conceal_ep6_packets(missing);
+            }
+            // process the data
+            process_ozy_input_buffer(&buffer[8]);
+            process_ozy_input_buffer(&buffer[520]);
+            full_tx_buffer(radio->transmitter);
+            break;
+          case 4: // EP4
+            missing=sequence_check(&ep4_stats,sequence);
+            if(missing<0) {
+              break;
+            }
+            if(missing>0) {
+              // the wideband capture in progress has a hole in it
+              ep4_resync=TRUE;
+            }
+            if((sequence%32)==0) {
+              reset_wideband_buffer_index(radio->wideband);
+              ep4_resync=FALSE;
+            }
+            if(!ep4_resync) {
+              process_wideband_buffer(&buffer[8]);
+              process_wideband_buffer(&buffer[520]);
+            }
+            break;
+          default:
+            fprintf(stderr,"unexpected EP %d length=%d\n",ep,bytes_read);
+            break;
+        }
+        break;
+      case 2:  // response to a discovery packet
+        fprintf(stderr,"unexepected discovery response when not in discovery mode\n");
+        break;
+      default:
+        fprintf(stderr,"unexpected packet type: 0x%02X\n",buffer[2]);
+        break;
+    }
+  } else {
+    fprintf(stderr,"received bad header bytes on data port %02X,%02X\n",buffer[0],buffer[1]);
+  }
+}
+
+static gpointer receive_thread(gpointer arg) {
+  PACKET_POOL *pool;
+  UDP_BATCH *batch;
+  PACKET *packet;
+  CAPTURE *capture=NULL;
+  CAPTURE *replay=NULL;
+  long pool_exhausted=0;
+  int count;
+  int i;
 
   fprintf(stderr, "protocol1: receive_thread\n");
   running=TRUE;
 
-  length=sizeof(addr);
+  pool=packet_pool_new(radio->udp_batch_size*2,2048);
+  batch=udp_batch_new(radio->udp_batch_size,pool);
+
+  if(replay_filename!=NULL) {
+    replay=replay_new(replay_filename,replay_fast,2048);
+    if(replay==NULL) {
+      error_handler("protocol1: receive_thread: cannot replay",replay_filename);
+      running=FALSE;
+    }
+  } else if(capture_filename!=NULL) {
+    capture=capture_new(capture_filename,radio->discovered);
+  }
+
   while(running) {
 
     switch(radio->discovered->device) {
@@ -378,66 +505,50 @@ static gpointer receive_thread(gpointer arg) {
 #endif
 
       default:
-        bytes_read=recvfrom(data_socket,buffer,sizeof(buffer),0,(struct sockaddr*)&addr,&length);
-        if(bytes_read<0) {
+        if(replay!=NULL) {
+          count=replay_receive(replay,batch);
+        } else {
+          count=udp_batch_receive(data_socket,batch);
+        }
+        if(count<0 && replay!=NULL) {
+          // the file was checked when it was opened, so stop rather than retry
+          error_handler("protocol1: receive_thread: replay failed",strerror(errno));
+          running=FALSE;
+          break;
+        }
+        if(count<0) {
           if(errno==EAGAIN) {
-            error_handler("protocol1: receiver_thread: recvfrom socket failed","Radio not sending data");
+            error_handler("protocol1: receiver_thread: recvmmsg socket failed","Radio not sending data");
           } else {
-            error_handler("protocol1: receiver_thread: recvfrom socket failed",strerror(errno));
+            error_handler("protocol1: receiver_thread: recvmmsg socket failed",strerror(errno));
           }
           //running=FALSE;
           continue;
         }
 
-        if(buffer[0]==0xEF && buffer[1]==0xFE) {
-          switch(buffer[2]) {
-            case 1:
-              // get the end point
-              ep=buffer[3]&0xFF;
-
-              // get the sequence number
-              sequence=((buffer[4]&0xFF)<<24)+((buffer[5]&0xFF)<<16)+((buffer[6]&0xFF)<<8)+(buffer[7]&0xFF);
-
-              switch(ep) {
-                case 6: // EP6
-                  // process the data
-                  process_ozy_input_buffer(&buffer[8]);
-                  process_ozy_input_buffer(&buffer[520]);
-                  full_tx_buffer(radio->transmitter);
-                  break;
-                case 4: // EP4
-                  ep4_sequence++;
-                  if(sequence!=ep4_sequence) {
-                    ep4_sequence=sequence;
-                  } else {
-                    //int seq=(int)(sequence%32L);
-                    if((sequence%32L)==0L) {
-                      reset_wideband_buffer_index(radio->wideband);
-                    }
-                    process_wideband_buffer(&buffer[8]);
-                    process_wideband_buffer(&buffer[520]);
-                  }
-                  break;
-                default:
-                  fprintf(stderr,"unexpected EP %d length=%d\n",ep,bytes_read);
-                  break;
-              }
-              break;
-            case 2:  // response to a discovery packet
-              fprintf(stderr,"unexepected discovery response when not in discovery mode\n");
-              break;
-            default:
-              fprintf(stderr,"unexpected packet type: 0x%02X\n",buffer[2]);
-              break;
-          }
-        } else {
-          fprintf(stderr,"received bad header bytes on data port %02X,%02X\n",buffer[0],buffer[1]);
+        if(capture!=NULL) {
+          capture_packets(capture,batch,count);
+        }
+        for(i=0;i<count;i++) {
+          packet=udp_batch_take(batch,i);
+          process_metis_packet(packet->buffer,packet->length);
+          packet_pool_release(pool,packet);
+        }
+
+        if(pool->exhausted!=pool_exhausted) {
+          pool_exhausted=pool->exhausted;
+          fprintf(stderr,"protocol1: receive_thread: packet pool exhausted %ld times (%ld dropped)\n",pool_exhausted,batch->dropped);
         }
         break;
     }
 
   }
 
+  capture_free(capture);
+  capture_free(replay);
+  udp_batch_free(batch);
+  packet_pool_free(pool);
+
   fprintf(stderr,"EXIT: protocol1: receive_thread\n");
   return NULL;
 }
@@ -536,128 +647,61 @@ static void process_control_bytes() {
   }
 }
 
-static int nreceiver;
-static int left_sample;
-static int right_sample;
-static short mic_sample;
-static double left_sample_double;
-static double right_sample_double;
-static int nsamples;
-static int iq_samples;
+// frames without sync are counted in ep6_stats.malformed, reported at most
+// once a second
+static gint64 sync_report_due=0;
 
-static void process_ozy_byte(int b) {
-  int i,j;
-  switch(state) {
-    case SYNC_0:
-      if(b==SYNC) {
-        state++;
-      }
-      break;
-    case SYNC_1:
-      if(b==SYNC) {
-        state++;
-      }
-      break;
-    case SYNC_2:
-      if(b==SYNC) {
-        state++;
-      }
-      break;
-    case CONTROL_0:
-      control_in[0]=b;
-      state++;
-      break;
-    case CONTROL_1:
-      control_in[1]=b;
-      state++;
-      break;
-    case CONTROL_2:
-      control_in[2]=b;
-      state++;
-      break;
-    case CONTROL_3:
-      control_in[3]=b;
-      state++;
-      break;
-    case CONTROL_4:
-      control_in[4]=b;
-      process_control_bytes();
-      nreceiver=0;
-      iq_samples=(512-8)/((radio->receivers*6)+2);
-      nsamples=0;
-      state++;
-      break;
-    case LEFT_SAMPLE_HI:
-      left_sample=(int)((signed char)b<<16);
-      state++;
-      break;
-    case LEFT_SAMPLE_MID:
-      left_sample|=(int)((((unsigned char)b)<<8)&0xFF00);
-      state++;
-      break;
-    case LEFT_SAMPLE_LOW:
-      left_sample|=(int)((unsigned char)b&0xFF);
-      left_sample_double=(double)left_sample/8388607.0; // 24 bit sample 2^23-1
-      state++;
-      break;
-    case RIGHT_SAMPLE_HI:
-      right_sample=(int)((signed char)b<<16);
-      state++;
-      break;
-    case RIGHT_SAMPLE_MID:
-      right_sample|=(int)((((unsigned char)b)<<8)&0xFF00);
-      state++;
-      break;
-    case RIGHT_SAMPLE_LOW:
-      right_sample|=(int)((unsigned char)b&0xFF);
-      right_sample_double=(double)right_sample/8388607.0; // 24 bit sample 2^23-1
-      //find receiver
-      i=-1;
-      for(j=0;j<radio->discovered->supported_receivers;j++) {
-        if(radio->receiver[j]!=NULL) {
-          i++;
-          if(i==nreceiver) break;
-        }
-      }
-      if(radio->receiver[j]!=NULL) {
-        add_iq_samples(radio->receiver[j], left_sample_double,right_sample_double);
-      }
-      nreceiver++;
-      if(nreceiver==radio->receivers) {
-        state++;
-      } else {
-        state=LEFT_SAMPLE_HI;
-      }
-      break;
-    case MIC_SAMPLE_HI:
-      mic_sample=(short)(b<<8);
-      state++;
-      break;
-    case MIC_SAMPLE_LOW:
-      mic_sample|=(short)(b&0xFF);
-      if(!radio->local_microphone) {
-        mic_samples++;
-        if(mic_samples>=mic_sample_divisor) { // reduce to 48000
-          add_mic_sample(radio->transmitter,(float)mic_sample/32768.0);
-          mic_samples=0;
-        }
-      }
-      nsamples++;
-      if(nsamples==iq_samples) {
-        state=SYNC_0;
-      } else {
-        nreceiver=0;
-        state=LEFT_SAMPLE_HI;
-      }
-      break;
+//
+// process a 512 byte ozy frame, the I/Q goes to the receivers through
+// ozy_frame_parse()
+//
+static void process_ozy_input_buffer(unsigned char  *buffer) {
+  int i,j,r;
+  int nrx;
+  int iq_samples;
+  int stride;
+  unsigned char *b;
+  RECEIVER *rx[MAX_RECEIVERS];
+  gint64 now;
+
+  nrx=radio->receivers;
+  if(nrx<=0) return;
+  if(nrx>MAX_RECEIVERS) nrx=MAX_RECEIVERS;
+
+  // find the receivers
+  r=0;
+  for(j=0;j<radio->discovered->supported_receivers && j<MAX_RECEIVERS && r<nrx;j++) {
+    if(radio->receiver[j]!=NULL) {
+      rx[r++]=radio->receiver[j];
+    }
+  }
+  while(r<nrx) {
+    rx[r++]=NULL;
   }
-}
 
-static void process_ozy_input_buffer(unsigned char  *buffer) {
-  int i;
-  if(radio->receivers>0) {
-    for(i=0;i<512;i++) {
-      process_ozy_byte(buffer[i]&0xFF);
+  if(!ozy_frame_parse(buffer,rx,nrx,control_in)) {
+    ep6_stats.malformed++;
+    now=g_get_monotonic_time();
+    if(now>=sync_report_due) {
+      g_print("process_ozy_input_buffer: did not find sync (%ld frames)\n",ep6_stats.malformed);
+      sync_report_due=now+1000000;
+    }
+    return;
+  }
+  process_control_bytes();
+
+  stride=(nrx*6)+2;
+  iq_samples=OZY_FRAME_SAMPLES(nrx);
+
+  if(!radio->local_microphone) {
+    b=&buffer[8+(nrx*6)];
+    for(i=0;i<iq_samples;i++) {
+      mic_samples++;
+      if(mic_samples>=mic_sample_divisor) { // reduce to 48000
+        add_mic_sample(radio->transmitter,(float)(short)((b[0]<<8)|(b[1]&0xFF))/32768.0);
+        mic_samples=0;
+      }
+      b+=stride;
     }
   }
 }
@@ -880,85 +924,97 @@ static void process_ozy_input_buffer(char  *buffer) {
 }
 #endif
 
-// Send rx audio back to radio
-void protocol1_audio_samples(RECEIVER *rx,short left_audio_sample,short right_audio_sample) {
-  if(!isTransmitting(radio)) {
-//    if(rx->mixed_audio==0) {
-      rx->mixed_left_audio=left_audio_sample;
-      rx->mixed_right_audio=right_audio_sample;
-//    } else {
-//      rx->mixed_left_audio+=left_audio_sample;
-//      rx->mixed_right_audio+=right_audio_sample;
-//    }
-//    rx->mixed_audio++;
-//    if(rx->mixed_audio>=radio->receivers) {
-      output_buffer[output_buffer_index++]=rx->mixed_left_audio>>8;
-      output_buffer[output_buffer_index++]=rx->mixed_left_audio;
-      output_buffer[output_buffer_index++]=rx->mixed_right_audio>>8;
-      output_buffer[output_buffer_index++]=rx->mixed_right_audio;
-      output_buffer[output_buffer_index++]=0;
-      output_buffer[output_buffer_index++]=0;
-      output_buffer[output_buffer_index++]=0;
-      output_buffer[output_buffer_index++]=0;
-      if(output_buffer_index>=OZY_BUFFER_SIZE) {
-        ozy_send_buffer();
-        output_buffer_index=8;
-      }
-//      rx->mixed_audio=0;
-//    }
+//
+// send a block of rx audio back to radio
+// audio is interleaved left/right in the range -1.0 to 1.0, it is packed a
+// block at a time into the ozy buffer and the frames are sent together
+//
+void protocol1_audio_block(RECEIVER *rx,const double *audio,int count,gboolean mute) {
+  int n;
+
+  if(isTransmitting(radio)) {
+    return;
   }
+  g_mutex_lock(&ep2_mutex);
+  while(count>0) {
+    n=(OZY_BUFFER_SIZE-output_buffer_index)/8;
+    if(n>count) n=count;
+    if(mute) {
+      memset(&output_buffer[output_buffer_index],0,n*8);
+    } else {
+      iq_pack_frames(audio,&output_buffer[output_buffer_index],n,0,32767.0);
+      audio+=n*2;
+    }
+    output_buffer_index+=n*8;
+    count-=n;
+    if(output_buffer_index>=OZY_BUFFER_SIZE) {
+      ozy_send_buffer();
+      output_buffer_index=8;
+    }
+  }
+  metis_flush();
+  g_mutex_unlock(&ep2_mutex);
 }
 
-void protocol1_iq_samples(int isample,int qsample) { 
-    output_buffer[tx_output_buffer_index++]=0;
-    output_buffer[tx_output_buffer_index++]=0;
-    output_buffer[tx_output_buffer_index++]=0;
-    output_buffer[tx_output_buffer_index++]=0;    
-    
-    #ifdef CWDAEMON
-    gint tx_mode=USB;    
-    RECEIVER *tx_receiver=radio->transmitter->rx;
-    if(tx_receiver!=NULL) {
-      if(radio->transmitter->rx->split) {
-        tx_mode=tx_receiver->mode_b;
-      } else {
-        tx_mode=tx_receiver->mode_a;
-      }
-    }    
+//
+// copy frames packed TX I/Q rows from the ring into the ozy buffer
+// a NULL ring sends silence
+//
+void protocol1_iq_frames(TX_RING *ring,int frames) {
+  int n;
+#ifdef CWDAEMON
+  gint tx_mode=USB;
+  gboolean cwx=FALSE;
+  unsigned char key=0x00;
+  RECEIVER *tx_receiver=radio->transmitter->rx;
+  if(tx_receiver!=NULL) {
+    if(tx_receiver->split) {
+      tx_mode=tx_receiver->mode_b;
+    } else {
+      tx_mode=tx_receiver->mode_a;
+    }
+  }
+  // sample the key once for the whole block
+  if((radio->cwdaemon) && (tx_mode==CWL || tx_mode==CWU)) {
+    cwx=TRUE;
+    g_mutex_lock(&cwdaemon_mutex);
+    key=keytx?0x01:0x00;
+    g_mutex_unlock(&cwdaemon_mutex);
+  }
+#endif
+
+  g_mutex_lock(&ep2_mutex);
+  while(frames>0) {
+    n=(OZY_BUFFER_SIZE-tx_output_buffer_index)/TX_RING_FRAME_SIZE;
+    if(n>frames) n=frames;
+    if(ring!=NULL) {
+      tx_ring_get(ring,&output_buffer[tx_output_buffer_index],n);
+    } else {
+      memset(&output_buffer[tx_output_buffer_index],0,n*TX_RING_FRAME_SIZE);
+    }
+#ifdef CWDAEMON
     // I[0] of IQ stream is CWX keydown
-    if ((radio->cwdaemon) && (tx_mode==CWL || tx_mode==CWU)) {
-      g_mutex_lock(&cwdaemon_mutex);
-      if(keytx) { 
-        output_buffer[tx_output_buffer_index++]=0x00;
-        output_buffer[tx_output_buffer_index++]=0x01;
+    if(cwx) {
+      for(int i=0;i<n;i++) {
+        output_buffer[tx_output_buffer_index+(i*TX_RING_FRAME_SIZE)+4]=0x00;
+        output_buffer[tx_output_buffer_index+(i*TX_RING_FRAME_SIZE)+5]=key;
       }
-      else {
-        output_buffer[tx_output_buffer_index++]=0x00;
-        output_buffer[tx_output_buffer_index++]=0x00; 
-      }
-      g_mutex_unlock(&cwdaemon_mutex); 
     }
-    else {
-      output_buffer[tx_output_buffer_index++]=isample>>8;
-      output_buffer[tx_output_buffer_index++]=isample;
-    }    
-    #else 
-    output_buffer[tx_output_buffer_index++]=isample>>8;
-    output_buffer[tx_output_buffer_index++]=isample;    
-    #endif    
-
-    output_buffer[tx_output_buffer_index++]=qsample>>8;
-    output_buffer[tx_output_buffer_index++]=qsample;
-
+#endif
+    tx_output_buffer_index+=n*TX_RING_FRAME_SIZE;
+    frames-=n;
     if(tx_output_buffer_index>=OZY_BUFFER_SIZE) {
       tx_output_buffer_index=8;
       ozy_send_buffer();
     }
-  //}
+  }
+  metis_flush();
+  g_mutex_unlock(&ep2_mutex);
 }
 
 void protocol1_eer_iq_samples(int isample,int qsample,int lasample,int rasample) {
   if(isTransmitting(radio)) {
+    g_mutex_lock(&ep2_mutex);
     output_buffer[output_buffer_index++]=lasample>>8;
     output_buffer[output_buffer_index++]=lasample;
     output_buffer[output_buffer_index++]=rasample>>8;
@@ -970,8 +1026,10 @@ void protocol1_eer_iq_samples(int isample,int qsample,int lasample,int rasample)
     output_buffer[output_buffer_index++]=qsample;
     if(output_buffer_index>=OZY_BUFFER_SIZE) {
       ozy_send_buffer();
+      metis_flush();
       output_buffer_index=8;
     }
+    g_mutex_unlock(&ep2_mutex);
   }
 }
 
@@ -996,16 +1054,16 @@ static void process_wideband_buffer(unsigned char  *buffer) {
   }
 }
 
-void ozy_send_buffer() {
+//
+// fill in C0-C4 for the current frame of the command rotation
+//
+static void build_control_bytes() {
   int i,j;
   int count;
   BAND *band;
   int nreceivers;
   RECEIVER *tx_receiver;
 
-  output_buffer[SYNC0]=SYNC;
-  output_buffer[SYNC1]=SYNC;
-  output_buffer[SYNC2]=SYNC;
   output_buffer[C0]=0x00;
   output_buffer[C1]=0x00;
   output_buffer[C2]=0x00;
@@ -1256,10 +1314,6 @@ void ozy_send_buffer() {
 #ifdef PURESIGNAL
           }
 #endif
-          current_rx++;
-        }
-        if(current_rx>=radio->discovered->supported_receivers) {
-          current_rx=0;
         }
         break;
       case 3:
@@ -1578,14 +1632,72 @@ void ozy_send_buffer() {
         output_buffer[C4]=0x15;
         break;
     }
+  }
+}
 
-    if(current_rx==0) {
-      command++;
-      if(command>11) {
-        command=1;
-      }
+//
+// step to the next frame of the command rotation
+// command 2 is repeated for each receiver
+//
+static void next_command() {
+  if(command==2) {
+    current_rx++;
+    if(current_rx>=radio->discovered->supported_receivers) {
+      current_rx=0;
+    }
+  }
+  if(current_rx==0) {
+    command++;
+    if(command>11) {
+      command=1;
     }
   }
+}
+
+//
+// called when something carried in C0-C4 has changed so the cached
+// command rotation is rebuilt
+//
+void protocol1_control_changed() {
+  g_atomic_int_inc(&control_generation);
+}
+
+void ozy_send_buffer() {
+  RECEIVER *tx_receiver;
+  CONTROL_ENTRY *entry=NULL;
+  gint generation=g_atomic_int_get(&control_generation);
+  gboolean transmitting=isTransmitting(radio);
+  gint64 now=g_get_monotonic_time();
+  int slot;
+
+  output_buffer[SYNC0]=SYNC;
+  output_buffer[SYNC1]=SYNC;
+  output_buffer[SYNC2]=SYNC;
+
+  if(metis_offset==8) {
+    slot=0;
+  } else if(command==2) {
+    slot=CONTROL_RX_SLOT+current_rx;
+  } else {
+    slot=command;
+  }
+  if(slot<CONTROL_SLOTS) {
+    entry=&control_cache[slot];
+  }
+  if(entry!=NULL && entry->generation==generation && entry->transmitting==transmitting && now-entry->built<CONTROL_REFRESH) {
+    memcpy(&output_buffer[C0],entry->c,5);
+  } else {
+    build_control_bytes();
+    if(entry!=NULL) {
+      memcpy(entry->c,&output_buffer[C0],5);
+      entry->generation=generation;
+      entry->transmitting=transmitting;
+      entry->built=now;
+    }
+  }
+  if(metis_offset!=8) {
+    next_command();
+  }
 
   // set mox
   gint tx_mode=USB;
@@ -1658,39 +1770,75 @@ static int ozyusb_write(char* buffer,int length)
 #endif
 
 static int metis_write(unsigned char ep,unsigned char* buffer,int length) {
-  int i;
+  unsigned char *packet=metis_buffer[metis_packets];
 
   // copy the buffer over
-  for(i=0;i<512;i++) {
-    metis_buffer[i+metis_offset]=buffer[i];
-  }
+  memcpy(&packet[metis_offset],buffer,512);
 
   if(metis_offset==8) {
     metis_offset=520;
   } else {
     send_sequence++;
-    metis_buffer[0]=0xEF;
-    metis_buffer[1]=0xFE;
-    metis_buffer[2]=0x01;
-    metis_buffer[3]=ep;
-    metis_buffer[4]=(send_sequence>>24)&0xFF;
-    metis_buffer[5]=(send_sequence>>16)&0xFF;
-    metis_buffer[6]=(send_sequence>>8)&0xFF;
-    metis_buffer[7]=(send_sequence)&0xFF;
-
-
-    // send the buffer
-    metis_send_buffer(&metis_buffer[0],1032);
+    packet[0]=0xEF;
+    packet[1]=0xFE;
+    packet[2]=0x01;
+    packet[3]=ep;
+    packet[4]=(send_sequence>>24)&0xFF;
+    packet[5]=(send_sequence>>16)&0xFF;
+    packet[6]=(send_sequence>>8)&0xFF;
+    packet[7]=(send_sequence)&0xFF;
+
+    // queue the buffer
+    metis_packets++;
     metis_offset=8;
-
+    if(metis_packets==METIS_BATCH) {
+      metis_flush();
+    }
   }
 
   return length;
 }
 
+//
+// send the queued metis packets
+// a half filled packet is moved to the front of the queue
+//
+static void metis_flush() {
+  int i;
+  int sent=0;
+  int rc;
+
+  for(i=0;i<metis_packets;i++) {
+    metis_iovecs[i].iov_base=metis_buffer[i];
+    metis_iovecs[i].iov_len=1032;
+    metis_msgs[i].msg_hdr.msg_name=&data_addr;
+    metis_msgs[i].msg_hdr.msg_namelen=data_addr_length;
+    metis_msgs[i].msg_hdr.msg_iov=&metis_iovecs[i];
+    metis_msgs[i].msg_hdr.msg_iovlen=1;
+  }
+  while(sent<metis_packets) {
+    rc=sendmmsg(data_socket,&metis_msgs[sent],metis_packets-sent,0);
+    if(rc<=0) {
+      perror("sendmmsg socket failed for metis_flush\n");
+      break;
+    }
+    sent+=rc;
+  }
+  if(metis_packets>0 && metis_offset!=8) {
+    memcpy(&metis_buffer[0][8],&metis_buffer[metis_packets][8],512);
+  }
+  metis_packets=0;
+}
+
 static void metis_restart() {
 fprintf(stderr,"metis_restart\n");
+  sequence_reset(&ep6_stats);
+  sequence_reset(&ep4_stats);
+  ep4_resync=TRUE;
+
+  g_mutex_lock(&ep2_mutex);
   // reset metis frame
+  metis_packets=0;
   metis_offset=8;
 
   // reset current rx
@@ -1705,6 +1853,8 @@ fprintf(stderr,"metis_restart\n");
   do {
     ozy_send_buffer();
   } while (command!=1);
+  metis_flush();
+  g_mutex_unlock(&ep2_mutex);
 
   usleep(20000);
 
@@ -1715,13 +1865,16 @@ fprintf(stderr,"metis_restart\n");
 static void metis_start_stop(int command) {
   int i;
   unsigned char buffer[64];
-    
-  state=SYNC_0;
 
 #ifdef USBOZY
   if(radio->discovered->device!=DEVICE_OZY) {
 #endif
 
+  // anything queued goes first
+  g_mutex_lock(&ep2_mutex);
+  metis_flush();
+  g_mutex_unlock(&ep2_mutex);
+
   buffer[0]=0xEF;
   buffer[1]=0xFE;
   buffer[2]=0x04;    // start/stop command
@@ -20,14 +20,21 @@
 #ifndef _OLD_PROTOCOL_H
 #define _OLD_PROTOCOL_H
 
+#include "tx_ring.h"
+#include "sequence.h"
+
+extern SEQUENCE_STATS ep6_stats;
+extern SEQUENCE_STATS ep4_stats;
+
 extern void protocol1_stop();
 extern void protocol1_run();
 
 extern void protocol1_init(RADIO *r);
 extern void protocol1_set_mic_sample_rate(int rate);
+extern void protocol1_control_changed();
 
 extern void protocol1_process_local_mic(RADIO *r);
-extern void protocol1_audio_samples(RECEIVER *rx,short left_audio_sample,short right_audio_sample);
-extern void protocol1_iq_samples(int isample,int qsample);
+extern void protocol1_audio_block(RECEIVER *rx,const double *audio,int count,gboolean mute);
+extern void protocol1_iq_frames(TX_RING *ring,int frames);
 extern void protocol1_eer_iq_samples(int isample,int qsample,int lasample,int rasample);
 #endif
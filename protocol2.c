@@ -20,6 +20,7 @@
 
 //#define ECHO_MIC
 
+#define _GNU_SOURCE
 #include <gtk/gtk.h>
 
 #include <errno.h>
@@ -39,6 +40,8 @@
 #include <ifaddrs.h>
 #include <semaphore.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include <wdsp.h>
 
@@ -51,6 +54,7 @@
 #include "filter.h"
 #include "wideband.h"
 #include "receiver.h"
+#include "receiver_dsp.h"
 #include "transmitter.h"
 #include "adc.h"
 #include "dac.h"
@@ -65,6 +69,8 @@
 #include "ext.h"
 #include "main.h"
 #include "protocol2.h"
+#include "udp_batch.h"
+#include "capture.h"
 
 #define min(x,y) (x<y?x:y)
 
@@ -99,7 +105,22 @@ static struct sockaddr_in wide_addr;
 static int wide_addr_length;
 
 static GThread *protocol2_thread_id;
-static GThread *protocol2_timer_thread_id;
+static GThread *command_thread_id;
+
+// optional socket and thread for each DDC
+static int ddc_socket[MAX_RECEIVERS];
+static GThread *ddc_thread_id[MAX_RECEIVERS];
+
+#define COMMAND_GENERAL 0
+#define COMMAND_TRANSMIT_SPECIFIC 1
+#define COMMAND_RECEIVE_SPECIFIC 2
+#define COMMAND_HIGH_PRIORITY 3
+#define COMMANDS 4
+
+static GMutex command_mutex;
+static GCond command_cond;
+static guint command_changed;
+static gint64 command_sent[COMMANDS];
 
 static long high_priority_sequence = 0;
 static long general_sequence = 0;
@@ -111,9 +132,6 @@ static int micoutputsamples;  // 48000 in, 192000 out
 //static double micinputbuffer[MAX_BUFFER_SIZE*2]; // 48000 ---- UNUSED
 //static double iqoutputbuffer[MAX_BUFFER_SIZE*4*2]; //192000 --- UNUSED
 
-static long tx_iq_sequence;
-static unsigned char iqbuffer[1444];
-static int iqindex;
 static int micsamples;
 
 //static float phase = 0.0F; //UNUSED
@@ -126,14 +144,41 @@ static int samples[MAX_RECEIVERS];
 static int outputsamples;
 #endif
 
-static long audiosequence;
-static unsigned char audiobuffer[260]; // was 1444
-static int audioindex;
+//
+// audio and TX I/Q are packed straight into a batch of packets and the
+// complete packets are sent with one sendmmsg call per DSP block
+//
+#define OUTPUT_BATCH 16
+#define AUDIO_PACKET_SIZE 260 // 64 16 bit stereo samples
+#define TX_IQ_PACKET_SIZE 1444 // 240 24 bit I/Q samples
+
+//
+// audio is added by whichever dsp pool worker runs the active receiver, and
+// with the active receiver changing two of them can be in here at once, so
+// a stream's packets and index are only touched with its mutex held
+//
+typedef struct _output_stream {
+  GMutex mutex;
+  IQ_FORMAT format;
+  int packet_size;
+  int sample_size;
+  int packets;
+  int index;
+  long sequence;
+  unsigned char buffer[OUTPUT_BATCH][TX_IQ_PACKET_SIZE];
+  struct mmsghdr msgs[OUTPUT_BATCH];
+  struct iovec iovecs[OUTPUT_BATCH];
+} OUTPUT_STREAM;
+
+static OUTPUT_STREAM audio_stream;
+static OUTPUT_STREAM iq_stream;
+
+static void output_stream_init(OUTPUT_STREAM *stream,IQ_FORMAT format,int packet_size,struct sockaddr_in *addr,int addr_length);
 
 #define NET_BUFFER_SIZE 2048
+
+PACKET_POOL *packet_pool=NULL;
 // Network buffers
-static struct sockaddr_in addr;
-static socklen_t length;
 
 static unsigned char general_buffer[60];
 static unsigned char high_priority_buffer_to_radio[1444];
@@ -141,8 +186,9 @@ static unsigned char transmit_specific_buffer[60];
 static unsigned char receive_specific_buffer[1444];
 
 static gpointer protocol2_thread(gpointer data);
-static gpointer protocol2_timer_thread(gpointer data);
-static void  process_iq_data(RECEIVER *rx,unsigned char *buffer);
+static gpointer command_thread(gpointer data);
+static gpointer ddc_thread(gpointer data);
+static void  process_iq_data(RECEIVER *rx,unsigned char *buffer,int length);
 static void  process_wideband_data(WIDEBAND *w,unsigned char *buffer);
 #ifdef PURESIGNAL
 static void  process_ps_iq_data(RECEIVER *rx);
@@ -150,6 +196,7 @@ static void  process_ps_iq_data(RECEIVER *rx);
 static void  process_command_response(unsigned char *buffer);
 static void  process_high_priority(unsigned char *buffer);
 static void  process_mic_data(int bytes,unsigned char *buffer);
+static void  process_packet(PACKET *packet);
 
 #ifdef INCLUDED
 static void protocol2_calc_buffers() {
@@ -303,6 +350,9 @@ fprintf(stderr,"protocol2_init: high_priority_addr setup for port %d\n",HIGH_PRI
     wide_addr_length=r->discovered->info.network.address_length;
     wide_addr.sin_port=htons(WIDE_BAND_TO_HOST_PORT);
 
+    output_stream_init(&audio_stream,IQ_INT16_BE,AUDIO_PACKET_SIZE,&audio_addr,audio_addr_length);
+    output_stream_init(&iq_stream,IQ_INT24_BE,TX_IQ_PACKET_SIZE,&iq_addr,iq_addr_length);
+
     protocol2_thread_id = g_thread_new( "protocol2", protocol2_thread, NULL);
     if( ! protocol2_thread_id )
     {
@@ -313,7 +363,7 @@ fprintf(stderr,"protocol2_init: high_priority_addr setup for port %d\n",HIGH_PRI
 
 }
 
-void protocol2_general() {
+static void send_general() {
     BAND *band;
 
     band=NULL;
@@ -371,7 +421,7 @@ void protocol2_general() {
     general_sequence++;
 }
 
-void protocol2_high_priority() {
+static void send_high_priority() {
     int r;
     BAND *band;
     int xvtr = 0; // IS THIS UNUSED?
@@ -516,7 +566,7 @@ void protocol2_high_priority() {
             band=band_get_band(radio->transmitter->rx->band_b);
           } else {
             band=band_get_band(radio->transmitter->rx->band_a);
-g_print("protocol2_high_priority: band=%d %s\n",radio->transmitter->rx->band_a, band->title);
+g_print("send_high_priority: band=%d %s\n",radio->transmitter->rx->band_a, band->title);
           }
         }
       }
@@ -544,7 +594,7 @@ g_print("protocol2_high_priority: band=%d %s\n",radio->transmitter->rx->band_a,
       }
 
       level=(int)(actual_volts*255.0);
-g_print("protocol2_high_priority: band=%d %s level=%d\n",radio->transmitter->rx->band_a, band->title, level);
+g_print("send_high_priority: band=%d %s level=%d\n",radio->transmitter->rx->band_a, band->title, level);
     }
 
     high_priority_buffer_to_radio[345]=level&0xFF;
@@ -856,7 +906,7 @@ g_print("protocol2_high_priority: band=%d %s level=%d\n",radio->transmitter->rx-
 
 //fprintf(stderr,"filters: rx1: %02X %02X for rx=%lld\n",high_priority_buffer_to_radio[1430],high_priority_buffer_to_radio[1431],rxFrequency);
 
-//fprintf(stderr,"protocol2_high_priority: OC=%02X filters=%04X for frequency=%lld\n", high_priority_buffer_to_radio[1401], filters, rxFrequency);
+//fprintf(stderr,"send_high_priority: OC=%02X filters=%04X for frequency=%lld\n", high_priority_buffer_to_radio[1401], filters, rxFrequency);
 
   
       if(isTransmitting(radio)) {
@@ -876,7 +926,7 @@ g_print("protocol2_high_priority: band=%d %s level=%d\n",radio->transmitter->rx-
     high_priority_sequence++;
 }
 
-static void protocol2_transmit_specific() {
+static void send_transmit_specific() {
     int mode;
 
     memset(transmit_specific_buffer, 0, sizeof(transmit_specific_buffer));
@@ -963,7 +1013,7 @@ static void protocol2_transmit_specific() {
 
 }
 
-void protocol2_receive_specific() {
+static void send_receive_specific() {
   int i;
 
   memset(receive_specific_buffer, 0, sizeof(receive_specific_buffer));
@@ -1015,29 +1065,113 @@ void protocol2_receive_specific() {
     }
 #endif
 
-//fprintf(stderr,"protocol2_receive_specific: enable=%02X\n",receive_specific_buffer[7]);
+//fprintf(stderr,"send_receive_specific: enable=%02X\n",receive_specific_buffer[7]);
     if(sendto(data_socket,receive_specific_buffer,sizeof(receive_specific_buffer),0,(struct sockaddr*)&receiver_addr,receiver_addr_length)<0) {
       fprintf(stderr,"sendto socket failed for receive_specific: sequence=%ld\n",rx_specific_sequence);
     }
     rx_specific_sequence++;
 }
 
+//
+// register packets are not sent by the callers, they only mark the packet
+// as changed and the command thread sends it. A packet is sent at most
+// once every p2_command_interval ms however often it changes, the
+// specific packets are also resent every p2_keepalive_interval ms.
+//
+static void send_command(int command) {
+    switch(command) {
+      case COMMAND_GENERAL:
+        send_general();
+        break;
+      case COMMAND_TRANSMIT_SPECIFIC:
+        send_transmit_specific();
+        break;
+      case COMMAND_RECEIVE_SPECIFIC:
+        send_receive_specific();
+        break;
+      case COMMAND_HIGH_PRIORITY:
+        send_high_priority();
+        break;
+    }
+    command_sent[command]=g_get_monotonic_time();
+}
+
+static void protocol2_command(int command) {
+    g_mutex_lock(&command_mutex);
+    command_changed|=1<<command;
+    g_cond_signal(&command_cond);
+    g_mutex_unlock(&command_mutex);
+}
+
+void protocol2_general() {
+    protocol2_command(COMMAND_GENERAL);
+}
+
+void protocol2_high_priority() {
+    protocol2_command(COMMAND_HIGH_PRIORITY);
+}
+
+void protocol2_receive_specific() {
+    protocol2_command(COMMAND_RECEIVE_SPECIFIC);
+}
+
+static gpointer command_thread(gpointer data) {
+    int i;
+    gint64 now;
+    gint64 due;
+    gint64 next;
+    gint64 interval;
+    gint64 keepalive;
+
+    g_mutex_lock(&command_mutex);
+    while(running) {
+      interval=(gint64)(radio->p2_command_interval>0?radio->p2_command_interval:0)*G_TIME_SPAN_MILLISECOND;
+      keepalive=(gint64)(radio->p2_keepalive_interval>0?radio->p2_keepalive_interval:DEFAULT_P2_KEEPALIVE_INTERVAL)*G_TIME_SPAN_MILLISECOND;
+      now=g_get_monotonic_time();
+      next=now+keepalive;
+      for(i=0;i<COMMANDS;i++) {
+        if(command_changed&(1<<i)) {
+          due=command_sent[i]+interval;
+        } else if(i==COMMAND_TRANSMIT_SPECIFIC || i==COMMAND_RECEIVE_SPECIFIC) {
+          due=command_sent[i]+keepalive;
+        } else {
+          continue;
+        }
+        if(due<=now) {
+          command_changed&=~(1<<i);
+          send_command(i);
+          due=command_sent[i]+keepalive;
+        }
+        if(due<next) {
+          next=due;
+        }
+      }
+      g_cond_wait_until(&command_cond,&command_mutex,next);
+    }
+    g_mutex_unlock(&command_mutex);
+    return NULL;
+}
+
 static void protocol2_start() {
-    protocol2_transmit_specific();
-    protocol2_receive_specific();
-    protocol2_timer_thread_id = g_thread_new( "protocol2 timer", protocol2_timer_thread, NULL);
-    if( ! protocol2_timer_thread_id )
+    g_mutex_lock(&command_mutex);
+    command_changed|=(1<<COMMAND_TRANSMIT_SPECIFIC)|(1<<COMMAND_RECEIVE_SPECIFIC);
+    g_mutex_unlock(&command_mutex);
+    command_thread_id = g_thread_new( "protocol2 command", command_thread, NULL);
+    if( ! command_thread_id )
     {
-        fprintf(stderr,"g_thread_new failed on protocol2_timer_thread\n");
+        fprintf(stderr,"g_thread_new failed on command_thread\n");
         exit( -1 );
     }
-    fprintf(stderr, "protocol2_timer_thread: id=%p\n",protocol2_timer_thread_id);
+    fprintf(stderr, "command_thread: id=%p\n",command_thread_id);
 
 }
 
 void protocol2_stop() {
+    // the radio has to see this before we exit
+    g_mutex_lock(&command_mutex);
     running=0;
-    protocol2_high_priority();
+    send_high_priority();
+    g_mutex_unlock(&command_mutex);
     usleep(100000); // 100 ms
     _exit(0);
 }
@@ -1054,18 +1188,180 @@ double calibrate(int v) {
     return (v1*v1)/0.095;
 }
 
+//
+// dispatch a packet to its port handler, the buffer goes back to the pool
+// as soon as the handler has finished with it
+//
+static void process_packet(PACKET *packet) {
+    int ddc;
+    int sourceport=packet->port;
+    unsigned char *buffer=packet->buffer;
+
+    switch(sourceport) {
+        case RX_IQ_TO_HOST_PORT_0:
+        case RX_IQ_TO_HOST_PORT_1:
+        case RX_IQ_TO_HOST_PORT_2:
+        case RX_IQ_TO_HOST_PORT_3:
+        case RX_IQ_TO_HOST_PORT_4:
+        case RX_IQ_TO_HOST_PORT_5:
+        case RX_IQ_TO_HOST_PORT_6:
+        case RX_IQ_TO_HOST_PORT_7:
+          ddc=sourceport-RX_IQ_TO_HOST_PORT_0;
+          if(ddc>=radio->discovered->supported_receivers)  {
+            fprintf(stderr,"unexpected iq data from ddc %d\n",ddc);
+          } else {
+            if(radio->receiver[ddc]!=NULL) {
+              process_iq_data(radio->receiver[ddc],buffer,packet->length);
+            }
+          }
+          packet_pool_release(packet_pool,packet);
+          break;
+        case WIDE_BAND_TO_HOST_PORT:
+          if(radio->wideband!=NULL) {
+            process_wideband_data(radio->wideband,buffer);
+          }
+          packet_pool_release(packet_pool,packet);
+          break;
+        case COMMAND_RESPONCE_TO_HOST_PORT:
+          process_command_response(buffer);
+          packet_pool_release(packet_pool,packet);
+          break;
+        case HIGH_PRIORITY_TO_HOST_PORT:
+          process_high_priority(buffer);
+          packet_pool_release(packet_pool,packet);
+          break;
+        case MIC_LINE_TO_HOST_PORT:
+          process_mic_data(packet->length,buffer);
+          packet_pool_release(packet_pool,packet);
+          break;
+        default:
+fprintf(stderr,"protocol2_thread: Unknown port %d\n",sourceport);
+          packet_pool_release(packet_pool,packet);
+          break;
+    }
+}
+
+//
+// each DDC thread is pinned to the next cpu in radio->p2_ddc_cpus
+//
+static void ddc_thread_affinity(int ddc) {
+    gchar **list;
+    int cpus;
+    int cpu;
+    cpu_set_t set;
+
+    if(radio->p2_ddc_cpus[0]=='\0') {
+      return;
+    }
+    list=g_strsplit(radio->p2_ddc_cpus,",",-1);
+    for(cpus=0;list[cpus]!=NULL;cpus++);
+    if(cpus>0) {
+      cpu=atoi(list[ddc%cpus]);
+      CPU_ZERO(&set);
+      CPU_SET(cpu,&set);
+      if(pthread_setaffinity_np(pthread_self(),sizeof(set),&set)!=0) {
+        fprintf(stderr,"ddc_thread: %d: cannot set affinity to cpu %d\n",ddc,cpu);
+      }
+    }
+    g_strfreev(list);
+}
+
+static gpointer ddc_thread(gpointer data) {
+    int ddc=GPOINTER_TO_INT(data);
+    int i;
+    int count;
+    PACKET *packet;
+    PACKET_POOL *pool;
+    UDP_BATCH *batch;
+
+    ddc_thread_affinity(ddc);
+
+    pool=packet_pool_new(radio->udp_batch_size*2,NET_BUFFER_SIZE);
+    batch=udp_batch_new(radio->udp_batch_size,pool);
+
+    while(running) {
+        count=udp_batch_receive(ddc_socket[ddc],batch);
+        if(count<0) {
+            fprintf(stderr,"recvmmsg socket failed for ddc_thread %d\n",ddc);
+            break;
+        }
+        for(i=0;i<count;i++) {
+            packet=udp_batch_take(batch,i);
+            if(radio->receiver[ddc]!=NULL) {
+                process_iq_data(radio->receiver[ddc],packet->buffer,packet->length);
+            }
+            packet_pool_release(pool,packet);
+        }
+    }
+
+    udp_batch_free(batch);
+    packet_pool_free(pool);
+    close(ddc_socket[ddc]);
+    ddc_socket[ddc]=-1;
+    return NULL;
+}
+
+//
+// open a socket for each DDC on the same local port as data_socket and
+// connect it to the DDC's port on the radio. Connected sockets in a
+// SO_REUSEPORT group take the datagrams that match them exactly, so each
+// DDC stream goes to its own thread and everything else still arrives on
+// data_socket.
+//
+static void ddc_threads_start() {
+    int i;
+    int optval=1;
+    struct sockaddr_in local;
+    socklen_t local_length=sizeof(local);
+    struct sockaddr_in remote;
+
+    if(getsockname(data_socket,(struct sockaddr *)&local,&local_length)<0) {
+        fprintf(stderr,"ddc_threads_start: getsockname failed: %s\n",strerror(errno));
+        return;
+    }
+
+    for(i=0;i<radio->discovered->supported_receivers && i<MAX_RECEIVERS;i++) {
+        ddc_socket[i]=socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP);
+        if(ddc_socket[i]<0) {
+            fprintf(stderr,"ddc_threads_start: create socket failed for ddc %d\n",i);
+            continue;
+        }
+        setsockopt(ddc_socket[i], SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+        setsockopt(ddc_socket[i], SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+        udp_set_receive_buffer(ddc_socket[i],radio->udp_receive_buffer);
+
+        memcpy(&remote,&radio->discovered->info.network.address,radio->discovered->info.network.address_length);
+        remote.sin_port=htons(RX_IQ_TO_HOST_PORT_0+i);
+
+        if(bind(ddc_socket[i],(struct sockaddr *)&local,local_length)<0 ||
+           connect(ddc_socket[i],(struct sockaddr *)&remote,sizeof(remote))<0) {
+            fprintf(stderr,"ddc_threads_start: ddc %d: %s\n",i,strerror(errno));
+            close(ddc_socket[i]);
+            ddc_socket[i]=-1;
+            continue;
+        }
+
+        ddc_thread_id[i]=g_thread_new("protocol2 ddc",ddc_thread,GINT_TO_POINTER(i));
+        if(!ddc_thread_id[i]) {
+            fprintf(stderr,"g_thread_new failed on ddc_thread %d\n",i);
+            exit(-1);
+        }
+    }
+    fprintf(stderr,"ddc_threads_start: port=%d cpus=%s\n",ntohs(local.sin_port),radio->p2_ddc_cpus[0]!='\0'?radio->p2_ddc_cpus:"any");
+}
+
 static gpointer protocol2_thread(gpointer data) {
 
     int i;
-    int ddc;
-    //short sourceport;
-    static unsigned char *buffer;
-    int bytesread;
+    int count;
+    UDP_BATCH *batch;
+    CAPTURE *capture=NULL;
+    CAPTURE *replay=NULL;
+    long pool_exhausted=0;
 
 fprintf(stderr,"protocol2_thread\n");
 
     micsamples=0;
-    iqindex=4;
 
     data_socket=socket(PF_INET,SOCK_DGRAM,IPPROTO_UDP);
     if(data_socket<0) {
@@ -1077,6 +1373,8 @@ fprintf(stderr,"protocol2_thread\n");
     setsockopt(data_socket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
     setsockopt(data_socket, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
 
+    udp_set_receive_buffer(data_socket,radio->udp_receive_buffer);
+
     // bind to the interface
     if(bind(data_socket,(struct sockaddr*)&radio->discovered->info.network.interface_address,radio->discovered->info.network.interface_length)<0) {
         fprintf(stderr,"protocol2_thread: bind socket failed for data_socket\n");
@@ -1119,127 +1417,108 @@ fprintf(stderr,"protocol2_thread: high_priority_addr setup for port %d\n",HIGH_P
         samples[i]=0;
     }
 
-    audioindex=4; // leave space for sequence
-    audiosequence=0L;
-
     running=TRUE;
+
+    // the shared thread keeps every stream when capturing or replaying
+    if(radio->p2_ddc_threads && capture_filename==NULL && replay_filename==NULL) {
+        ddc_threads_start();
+    }
+
     protocol2_general();
     protocol2_start();
     protocol2_high_priority();
 
+    packet_pool=packet_pool_new(radio->udp_batch_size*2,NET_BUFFER_SIZE);
+    batch=udp_batch_new(radio->udp_batch_size,packet_pool);
+
+    if(replay_filename!=NULL) {
+        replay=replay_new(replay_filename,replay_fast,NET_BUFFER_SIZE);
+        if(replay==NULL) {
+            fprintf(stderr,"protocol2_thread: cannot replay %s\n",replay_filename);
+            running=0;
+        }
+    } else if(capture_filename!=NULL) {
+        capture=capture_new(capture_filename,radio->discovered);
+    }
+
     while(running) {
 
-        buffer=malloc(NET_BUFFER_SIZE);
-        length=sizeof(struct sockaddr_in);
-        bytesread=recvfrom(data_socket,buffer,NET_BUFFER_SIZE,0,(struct sockaddr*)&addr,&length);
-        if(bytesread<0) {
-            fprintf(stderr,"recvfrom socket failed for protocol2_thread");
+        if(replay!=NULL) {
+            count=replay_receive(replay,batch);
+        } else {
+            count=udp_batch_receive(data_socket,batch);
+        }
+        if(count<0) {
+            if(replay!=NULL) {
+                // the file was checked when it was opened, so stop rather than retry
+                fprintf(stderr,"protocol2_thread: replay failed: %s\n",strerror(errno));
+                running=0;
+                break;
+            }
+            fprintf(stderr,"recvmmsg socket failed for protocol2_thread");
             exit(-1);
         }
 
-        int sourceport=ntohs(addr.sin_port);
-
-        switch(sourceport) {
-            case RX_IQ_TO_HOST_PORT_0:
-            case RX_IQ_TO_HOST_PORT_1:
-            case RX_IQ_TO_HOST_PORT_2:
-            case RX_IQ_TO_HOST_PORT_3:
-            case RX_IQ_TO_HOST_PORT_4:
-            case RX_IQ_TO_HOST_PORT_5:
-            case RX_IQ_TO_HOST_PORT_6:
-            case RX_IQ_TO_HOST_PORT_7:
-              ddc=sourceport-RX_IQ_TO_HOST_PORT_0;
-              if(ddc>=radio->discovered->supported_receivers)  {
-                fprintf(stderr,"unexpected iq data from ddc %d\n",ddc);
-              } else {
-                if(radio->receiver[ddc]!=NULL) {
-                  process_iq_data(radio->receiver[ddc],buffer);
-                }
-              }
-              free(buffer);
-              break;
-            case WIDE_BAND_TO_HOST_PORT:
-              if(radio->wideband!=NULL) {
-                process_wideband_data(radio->wideband,buffer);
-                free(buffer);
-              }
-              break;
-            case COMMAND_RESPONCE_TO_HOST_PORT:
-              process_command_response(buffer);
-              free(buffer);
-              break;
-            case HIGH_PRIORITY_TO_HOST_PORT:
-              process_high_priority(buffer);
-              free(buffer);
-              break;
-            case MIC_LINE_TO_HOST_PORT:
-              process_mic_data(bytesread,buffer);
-              free(buffer);
-              break;
-            default:
-fprintf(stderr,"protocol2_thread: Unknown port %d free %p\n",sourceport,buffer);
-              free(buffer);
-              break;
+        if(capture!=NULL) {
+            capture_packets(capture,batch,count);
+        }
+        for(i=0;i<count;i++) {
+            process_packet(udp_batch_take(batch,i));
+        }
+
+        if(packet_pool->exhausted!=pool_exhausted) {
+            pool_exhausted=packet_pool->exhausted;
+            fprintf(stderr,"protocol2_thread: packet pool exhausted %ld times (%ld dropped)\n",pool_exhausted,batch->dropped);
         }
     }
 
+    capture_free(capture);
+    capture_free(replay);
+    udp_batch_free(batch);
+    packet_pool_free(packet_pool);
+    packet_pool=NULL;
     close(data_socket);
     return NULL;
 }
 
-static void process_iq_data(RECEIVER *rx,unsigned char *buffer) {
-  long sequence;
-  /*
-  long long timestamp;
+static void process_iq_data(RECEIVER *rx,unsigned char *buffer,int length) {
+  guint32 sequence;
+  gint missing;
+  gint64 timestamp;
   int bitspersample;
-  */
-  
   int samplesperframe;
-  int b;
-  int leftsample;
-  int rightsample;
-  double leftsampledouble;
-  double rightsampledouble;
   //unsigned char *buffer;
 
   //buffer=iq_buffer[rx->channel];
 
   if(buffer!=NULL) {
   sequence=((buffer[0]&0xFF)<<24)+((buffer[1]&0xFF)<<16)+((buffer[2]&0xFF)<<8)+(buffer[3]&0xFF);
-  
 
-  if(rx->iq_sequence!=sequence) {
-    //fprintf(stderr,"rx %d sequence error: expected %ld got %ld\n",rx->channel,rx->iq_sequence,sequence);
-    rx->iq_sequence=sequence;
-  }
-  rx->iq_sequence++;
-
-  /* UNUSED
-  timestamp=((long long)(buffer[4]&0xFF)<<56)+((long long)(buffer[5]&0xFF)<<48)+((long long)(buffer[6]&0xFF)<<40)+((long long)(buffer[7]&0xFF)<<32)+
-  ((long long)(buffer[8]&0xFF)<<24)+((long long)(buffer[9]&0xFF)<<16)+((long long)(buffer[10]&0xFF)<<8)+(long long)(buffer[11]&0xFF);
+  timestamp=(gint64)(((guint64)(buffer[4]&0xFF)<<56)+((guint64)(buffer[5]&0xFF)<<48)+((guint64)(buffer[6]&0xFF)<<40)+((guint64)(buffer[7]&0xFF)<<32)+
+  ((guint64)(buffer[8]&0xFF)<<24)+((guint64)(buffer[9]&0xFF)<<16)+((guint64)(buffer[10]&0xFF)<<8)+(guint64)(buffer[11]&0xFF));
 
   bitspersample=((buffer[12]&0xFF)<<8)+(buffer[13]&0xFF);
-  */
   samplesperframe=((buffer[14]&0xFF)<<8)+(buffer[15]&0xFF);
+  if(bitspersample!=24 || 16+(samplesperframe*6)>length) {
+    // only 24 bit samples are sent by current firmware, the gap is
+    // concealed when the next good packet is seen as a loss
+    rx->iq_stats.malformed++;
+    return;
+  }
+
+  missing=sequence_check(&rx->iq_stats,sequence);
+  if(missing<0) {
+    // duplicate or too late to use
+    return;
+  }
 
 //fprintf(stderr,"process_iq_data: rx=%d seq=%ld bitspersample=%d samplesperframe=%d\n",rx->id, sequence,bitspersample,samplesperframe);
-  b=16;
-  int i;
-  for(i=0;i<samplesperframe;i++) {
-    leftsample   = (int)((signed char) buffer[b++])<<16;
-    leftsample  |= (int)((((unsigned char)buffer[b++])<<8)&0xFF00);
-    leftsample  |= (int)((unsigned char)buffer[b++]&0xFF);
-    rightsample  = (int)((signed char)buffer[b++]) << 16;
-    rightsample |= (int)((((unsigned char)buffer[b++])<<8)&0xFF00);
-    rightsample |= (int)((unsigned char)buffer[b++]&0xFF);
-
-    //leftsampledouble=(double)leftsample/8388607.0; // for 24 bits
-    //rightsampledouble=(double)rightsample/8388607.0; // for 24 bits
-    leftsampledouble=(double)leftsample/16777215.0; // for 24 bits
-    rightsampledouble=(double)rightsample/16777215.0; // for 24 bits
-
-    add_iq_samples(rx, leftsampledouble,rightsampledouble);
+  if(missing>0) {
+    if(missing>SEQUENCE_MAX_CONCEAL) missing=SEQUENCE_MAX_CONCEAL;
+    add_iq_zeros(rx,missing*samplesperframe);
   }
+  add_iq_timestamp(rx,timestamp);
+  add_iq_block(rx,&buffer[16],IQ_INT24_BE,6,samplesperframe,1.0/16777215.0,FALSE); // for 24 bits
   }
 }
 
@@ -1269,11 +1548,9 @@ static void process_ps_iq_data(RECEIVER *rx) {
 
   sequence=((buffer[0]&0xFF)<<24)+((buffer[1]&0xFF)<<16)+((buffer[2]&0xFF)<<8)+(buffer[3]&0xFF);
 
-  if(rx->iq_sequence!=sequence) {
-    //fprintf(stderr,"rx %d sequence error: expected %ld got %ld\n",rx->id,rx->iq_sequence,sequence);
-    rx->iq_sequence=sequence;
+  if(sequence_check(&rx->iq_stats,(guint32)sequence)<0) {
+    return;
   }
-  rx->iq_sequence++;
 
   timestamp=((long long)(buffer[4]&0xFF)<<56)+((long long)(buffer[5]&0xFF)<<48)+((long long)(buffer[6]&0xFF)<<40)+((long long)(buffer[7]&0xFF)<<32);
   ((long long)(buffer[8]&0xFF)<<24)+((long long)(buffer[9]&0xFF)<<16)+((long long)(buffer[10]&0xFF)<<8)+(long long)(buffer[11]&0xFF);
@@ -1446,64 +1723,95 @@ void protocol2_process_local_mic(RADIO *r) {
 }
 
 
-void protocol2_audio_samples(RECEIVER *rx,short left_audio_sample,short right_audio_sample) {
+static void output_stream_init(OUTPUT_STREAM *stream,IQ_FORMAT format,int packet_size,struct sockaddr_in *addr,int addr_length) {
+  int i;
+
+  g_mutex_lock(&stream->mutex);
+  stream->format=format;
+  stream->packet_size=packet_size;
+  stream->sample_size=format==IQ_INT24_BE?6:4;
+  stream->packets=0;
+  stream->index=4; // leave space for sequence
+  stream->sequence=0;
+  for(i=0;i<OUTPUT_BATCH;i++) {
+    stream->iovecs[i].iov_base=stream->buffer[i];
+    stream->iovecs[i].iov_len=packet_size;
+    stream->msgs[i].msg_hdr.msg_name=addr;
+    stream->msgs[i].msg_hdr.msg_namelen=addr_length;
+    stream->msgs[i].msg_hdr.msg_iov=&stream->iovecs[i];
+    stream->msgs[i].msg_hdr.msg_iovlen=1;
+  }
+  g_mutex_unlock(&stream->mutex);
+}
+
+//
+// send the complete packets and move the one being filled to the front,
+// called with stream->mutex held
+//
+static void output_stream_flush(OUTPUT_STREAM *stream) {
+  int sent=0;
   int rc;
 
-  // insert the samples
-  audiobuffer[audioindex++]=left_audio_sample>>8;
-  audiobuffer[audioindex++]=left_audio_sample;
-  audiobuffer[audioindex++]=right_audio_sample>>8;
-  audiobuffer[audioindex++]=right_audio_sample;
-            
-  if(audioindex>=sizeof(audiobuffer)) {
-
-    // insert the sequence
-    audiobuffer[0]=audiosequence>>24;
-    audiobuffer[1]=audiosequence>>16;
-    audiobuffer[2]=audiosequence>>8;
-    audiobuffer[3]=audiosequence;
-
-    // send the buffer
-
-    rc=sendto(data_socket,audiobuffer,sizeof(audiobuffer),0,(struct sockaddr*)&audio_addr,audio_addr_length);
-    if(rc!=sizeof(audiobuffer)) {
-      fprintf(stderr,"sendto socket failed for %ld bytes of audio: %d\n",sizeof(audiobuffer),rc);
+  while(sent<stream->packets) {
+    rc=sendmmsg(data_socket,&stream->msgs[sent],stream->packets-sent,0);
+    if(rc<=0) {
+      fprintf(stderr,"sendmmsg failed for %d packets to port %d: %s\n",stream->packets-sent,
+              ntohs(((struct sockaddr_in *)stream->msgs[0].msg_hdr.msg_name)->sin_port),strerror(errno));
+      break;
     }
-    audiosequence++;
-    audioindex=4;
+    sent+=rc;
+  }
+  if(stream->packets>0 && stream->packets<OUTPUT_BATCH && stream->index>4) {
+    memcpy(stream->buffer[0],stream->buffer[stream->packets],stream->index);
   }
+  stream->packets=0;
 }
 
-void protocol2_iq_samples(int isample,int qsample) {
-  iqbuffer[iqindex++]=isample>>16;
-  iqbuffer[iqindex++]=isample>>8;
-  iqbuffer[iqindex++]=isample;
-  iqbuffer[iqindex++]=qsample>>16;
-  iqbuffer[iqindex++]=qsample>>8;
-  iqbuffer[iqindex++]=qsample;
-
-  if(iqindex==sizeof(iqbuffer)) {
-    iqbuffer[0]=tx_iq_sequence>>24;
-    iqbuffer[1]=tx_iq_sequence>>16;
-    iqbuffer[2]=tx_iq_sequence>>8;
-    iqbuffer[3]=tx_iq_sequence;
-
-    // send the buffer
-    if(sendto(data_socket,iqbuffer,sizeof(iqbuffer),0,(struct sockaddr*)&iq_addr,iq_addr_length)<0) {
-      fprintf(stderr,"sendto socket failed for iq: sequence=%ld\n",tx_iq_sequence);
+//
+// pack count pairs of samples (or silence if samples is NULL)
+//
+static void output_stream_add(OUTPUT_STREAM *stream,const double *samples,int count,double scale) {
+  int n;
+  unsigned char *buffer;
+
+  g_mutex_lock(&stream->mutex);
+  while(count>0) {
+    buffer=stream->buffer[stream->packets];
+    n=(stream->packet_size-stream->index)/stream->sample_size;
+    if(n>count) n=count;
+    if(samples!=NULL) {
+      iq_pack(stream->format,samples,&buffer[stream->index],n,scale);
+      samples+=n*2;
+    } else {
+      memset(&buffer[stream->index],0,n*stream->sample_size);
+    }
+    stream->index+=n*stream->sample_size;
+    count-=n;
+
+    if(stream->index>=stream->packet_size) {
+      buffer[0]=stream->sequence>>24;
+      buffer[1]=stream->sequence>>16;
+      buffer[2]=stream->sequence>>8;
+      buffer[3]=stream->sequence;
+      stream->sequence++;
+      stream->packets++;
+      stream->index=4;
+      if(stream->packets==OUTPUT_BATCH) {
+        output_stream_flush(stream);
+      }
     }
-    tx_iq_sequence++;
-    iqindex=4;
   }
+  output_stream_flush(stream);
+  g_mutex_unlock(&stream->mutex);
 }
 
-void* protocol2_timer_thread(void* arg) {
-  // int specific=0; // UNUSED
-fprintf(stderr,"protocol2_timer_thread\n");
-  while(running) {
-    usleep(100000); // 100ms
-    protocol2_transmit_specific();
-    protocol2_receive_specific();
-  }
-  return NULL;
+//
+// audio is interleaved left/right in the range -1.0 to 1.0
+//
+void protocol2_audio_block(RECEIVER *rx,const double *audio,int count,gboolean mute) {
+  output_stream_add(&audio_stream,mute?NULL:audio,count,32767.0);
+}
+
+void protocol2_iq_block(const double *iq,int count,double gain) {
+  output_stream_add(&iq_stream,iq,count,gain);
 }
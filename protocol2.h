@@ -22,6 +22,7 @@
 
 #include <semaphore.h>
 #include "receiver.h"
+#include "packet_pool.h"
 
 // port definitions from host
 #define GENERAL_REGISTERS_FROM_HOST_PORT 1024
@@ -49,7 +50,13 @@
 
 #define MIC_SAMPLES 64
 
+// ms between register packets while they are changing
+#define DEFAULT_P2_COMMAND_INTERVAL 10
+// ms between resends of the specific register packets
+#define DEFAULT_P2_KEEPALIVE_INTERVAL 500
+
 extern int data_socket;
+extern PACKET_POOL *packet_pool;
 extern sem_t *response_sem;
 
 extern unsigned int exciter_power;
@@ -79,6 +86,6 @@ extern void setTune(int state);
 extern int getTune();
 
 extern void protocol2_process_local_mic(RADIO *r);
-extern void protocol2_audio_samples(RECEIVER *rx,short left_audio_sample,short right_audio_sample);
-extern void protocol2_iq_samples(int isample,int qsample);
+extern void protocol2_audio_block(RECEIVER *rx,const double *audio,int count,gboolean mute);
+extern void protocol2_iq_block(const double *iq,int count,double gain);
 #endif
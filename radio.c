@@ -39,6 +39,7 @@
 #include "receiver.h"
 #include "transmitter.h"
 #include "receiver.h"
+#include "receiver_dsp.h"
 #include "wideband.h"
 #include "adc.h"
 #include "dac.h"
@@ -46,6 +47,8 @@
 #include "tx_panadapter.h"
 #include "protocol1.h"
 #include "protocol2.h"
+#include "udp_batch.h"
+#include "dsp_pool.h"
 #ifdef SOAPYSDR
 #include "soapy_protocol.h"
 #endif
@@ -244,6 +247,21 @@ g_print("radio_save_state: %s\n",filename);
   sprintf(value,"%d",radio->which_audio_backend);
   setProperty("radio.which_audio_backend",value);
 
+  sprintf(value,"%d",radio->udp_batch_size);
+  setProperty("radio.udp_batch_size",value);
+  sprintf(value,"%d",radio->udp_receive_buffer);
+  setProperty("radio.udp_receive_buffer",value);
+  sprintf(value,"%d",radio->p2_command_interval);
+  setProperty("radio.p2_command_interval",value);
+  sprintf(value,"%d",radio->p2_keepalive_interval);
+  setProperty("radio.p2_keepalive_interval",value);
+  sprintf(value,"%d",radio->p2_ddc_threads);
+  setProperty("radio.p2_ddc_threads",value);
+  setProperty("radio.p2_ddc_cpus",radio->p2_ddc_cpus);
+  sprintf(value,"%d",radio->dsp_threads);
+  setProperty("radio.dsp_threads",value);
+  setProperty("radio.dsp_cpus",radio->dsp_cpus);
+
   filterSaveState();
   bandSaveState();
 
@@ -263,17 +281,19 @@ g_print("radio_save_state: %s\n",filename);
   setProperty("radio.midi_enabled",value);
 #endif
 
-  gtk_window_get_position(GTK_WINDOW(main_window),&x,&y);
-  sprintf(value,"%d",x);
-  setProperty("radio.x",value);
-  sprintf(value,"%d",y);
-  setProperty("radio.y",value);
-
-  gtk_window_get_size(GTK_WINDOW(main_window),&width,&height);
-  sprintf(value,"%d",width);
-  setProperty("radio.width",value);
-  sprintf(value,"%d",height);
-  setProperty("radio.height",value);
+  if(main_window!=NULL) {
+    gtk_window_get_position(GTK_WINDOW(main_window),&x,&y);
+    sprintf(value,"%d",x);
+    setProperty("radio.x",value);
+    sprintf(value,"%d",y);
+    setProperty("radio.y",value);
+
+    gtk_window_get_size(GTK_WINDOW(main_window),&width,&height);
+    sprintf(value,"%d",width);
+    setProperty("radio.width",value);
+    sprintf(value,"%d",height);
+    setProperty("radio.height",value);
+  }
 
   saveProperties(filename);
 }
@@ -419,6 +439,29 @@ void radio_restore_state(RADIO *radio) {
   value=getProperty("radio.which_audio_backend");
   if(value) radio->which_audio_backend=atoi(value);
 
+  value=getProperty("radio.udp_batch_size");
+  if(value) radio->udp_batch_size=atoi(value);
+  value=getProperty("radio.udp_receive_buffer");
+  if(value) radio->udp_receive_buffer=atoi(value);
+  value=getProperty("radio.p2_command_interval");
+  if(value) radio->p2_command_interval=atoi(value);
+  value=getProperty("radio.p2_keepalive_interval");
+  if(value) radio->p2_keepalive_interval=atoi(value);
+  value=getProperty("radio.p2_ddc_threads");
+  if(value) radio->p2_ddc_threads=atoi(value);
+  value=getProperty("radio.p2_ddc_cpus");
+  if(value) {
+    strncpy(radio->p2_ddc_cpus,value,sizeof(radio->p2_ddc_cpus)-1);
+    radio->p2_ddc_cpus[sizeof(radio->p2_ddc_cpus)-1]='\0';
+  }
+  value=getProperty("radio.dsp_threads");
+  if(value) radio->dsp_threads=atoi(value);
+  value=getProperty("radio.dsp_cpus");
+  if(value) {
+    strncpy(radio->dsp_cpus,value,sizeof(radio->dsp_cpus)-1);
+    radio->dsp_cpus[sizeof(radio->dsp_cpus)-1]='\0';
+  }
+
 /*
   value=getProperty("rigctl_enable");
   if(value!=NULL) rigctl_enable=atoi(value);
@@ -540,6 +583,8 @@ void frequency_changed(RECEIVER *rx) {
   } else {
     if(radio->discovered->protocol==PROTOCOL_2) {
       protocol2_high_priority();
+    } else if(radio->discovered->protocol==PROTOCOL_1) {
+      protocol1_control_changed();
 #ifdef SOAPYSDR
     } else if(radio->discovered->protocol==PROTOCOL_SOAPYSDR) {
       soapy_protocol_set_rx_frequency(rx);
@@ -624,6 +669,8 @@ g_print("delete_receiver: receivers now %d\n",radio->receivers);
     gtk_widget_destroy(radio->dialog);
     radio->dialog=NULL;
   }
+
+  receiver_free_dsp(rx);
 }
 
 static void rxtx(RADIO *r) {
@@ -640,6 +687,7 @@ g_print("%s: isTransmitting=%d\n",__FUNCTION__,isTransmitting(r));
     SetChannelState(r->transmitter->channel,1,0);
     switch(r->discovered->protocol) {
       case PROTOCOL_1:
+        protocol1_control_changed();
         break;
       case PROTOCOL_2:
         protocol2_high_priority();
@@ -662,6 +710,7 @@ g_print("%s: isTransmitting=%d\n",__FUNCTION__,isTransmitting(r));
     }
     switch(r->discovered->protocol) {
       case PROTOCOL_1:
+        protocol1_control_changed();
         break;
       case PROTOCOL_2:
         protocol2_high_priority();
@@ -720,7 +769,9 @@ static void vox_cb(GtkToggleButton *widget,gpointer data) {
 void set_tune(RADIO *r,gboolean state) {
   if(r->mox) {
     r->mox=FALSE;
-    set_button_text_color(r->mox_button,r->mox?"red":"black");
+    if(r->mox_button!=NULL) {
+      set_button_text_color(r->mox_button,r->mox?"red":"black");
+    }
   }
   r->tune=state;
   if(r->tune) {
@@ -1207,6 +1258,16 @@ g_print("create_radio for %s %d\n",d->name,d->device);
   r->temperature_alarm_value = 42;  
   r->midi_enabled = FALSE;
   sprintf(r->midi_filename,"%s/.local/share/linhpsdr/midi.props", g_get_home_dir());
+
+  r->udp_batch_size=DEFAULT_UDP_BATCH_SIZE;
+  r->udp_receive_buffer=DEFAULT_UDP_RECEIVE_BUFFER;
+  r->p2_command_interval=DEFAULT_P2_COMMAND_INTERVAL;
+  r->p2_keepalive_interval=DEFAULT_P2_KEEPALIVE_INTERVAL;
+  r->p2_ddc_threads=FALSE;
+  r->p2_ddc_cpus[0]='\0';
+
+  r->dsp_threads=min(g_get_num_processors(),MAX_DSP_THREADS);
+  r->dsp_cpus[0]='\0';
   
   r->dialog=NULL;
 
@@ -1223,6 +1284,8 @@ g_print("create_radio for %s %d\n",d->name,d->device);
 
   create_audio(r->which_audio_backend,r->which_audio==USE_SOUNDIO?audio_get_backend_name(r->which_audio_backend):NULL);
 
+  dsp_pool_init(r->dsp_threads,r->dsp_cpus);
+
   add_receivers(r);
 
   switch(r->discovered->protocol) {
@@ -1240,7 +1303,9 @@ g_print("create_radio for %s %d\n",d->name,d->device);
   }
 
 
-  create_visual(r);
+  if(!headless) {
+    create_visual(r);
+  }
 
   switch(r->discovered->protocol) {
     case PROTOCOL_1:
@@ -1305,6 +1370,8 @@ g_print("create_radio for %s %d\n",d->name,d->device);
 }
 
 void update_radio(RADIO *r) {
+  if(r->mox_button==NULL) return;
+
   // update MOX button
   g_signal_handlers_block_by_func(r->mox_button,G_CALLBACK(mox_cb),r);
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(r->mox_button),r->mox);
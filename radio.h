@@ -212,6 +212,17 @@ typedef struct _radio {
   gboolean midi_enabled;
   char midi_filename[128];
 
+  gint udp_batch_size;
+  gint udp_receive_buffer;
+
+  gint p2_command_interval;
+  gint p2_keepalive_interval;
+  gboolean p2_ddc_threads;
+  char p2_ddc_cpus[64];
+
+  gint dsp_threads;
+  char dsp_cpus[64];
+
 } RADIO;
 
 extern int radio_start(void *data);
@@ -55,6 +55,8 @@
 #include "property.h"
 #include "rigctl.h"
 #include "subrx.h"
+#include "iq_ring.h"
+#include "receiver_dsp.h"
 
 void receiver_save_state(RECEIVER *rx) {
   char name[80];
@@ -117,6 +119,9 @@ void receiver_save_state(RECEIVER *rx) {
   sprintf(name,"receiver[%d].panadapter_agc_line",rx->channel);
   sprintf(value,"%d",rx->panadapter_agc_line);
   setProperty(name,value);
+  sprintf(name,"receiver[%d].panadapter_peaks",rx->channel);
+  sprintf(value,"%d",rx->panadapter_peaks);
+  setProperty(name,value);
 
   if(rx->waterfall_automatic == FALSE) {
       sprintf(name,"receiver[%d].waterfall_low",rx->channel);
@@ -132,6 +137,9 @@ void receiver_save_state(RECEIVER *rx) {
   sprintf(name,"receiver[%d].waterfall_ft8_marker",rx->channel);
   sprintf(value,"%d",rx->waterfall_ft8_marker);
   setProperty(name,value);
+  sprintf(name,"receiver[%d].waterfall_palette",rx->channel);
+  sprintf(value,"%d",rx->waterfall_palette);
+  setProperty(name,value);
 
   sprintf(name,"receiver[%d].frequency_a",rx->channel);
   sprintf(value,"%" G_GINT64_FORMAT,rx->frequency_a);
@@ -347,6 +355,8 @@ void receiver_save_state(RECEIVER *rx) {
   setProperty(name,value);
 
 
+  if(rx->window==NULL) return;
+
   gtk_window_get_position(GTK_WINDOW(rx->window),&x,&y);
   sprintf(name,"receiver[%d].x",rx->channel);
   sprintf(value,"%d",x);
@@ -603,6 +613,9 @@ void receiver_restore_state(RECEIVER *rx) {
   sprintf(name,"receiver[%d].panadapter_agc_line",rx->channel);
   value=getProperty(name);
   if(value) rx->panadapter_agc_line=atoi(value);
+  sprintf(name,"receiver[%d].panadapter_peaks",rx->channel);
+  value=getProperty(name);
+  if(value) rx->panadapter_peaks=atoi(value);
 
   sprintf(name,"receiver[%d].waterfall_low",rx->channel);
   value=getProperty(name);
@@ -616,6 +629,9 @@ void receiver_restore_state(RECEIVER *rx) {
   sprintf(name,"receiver[%d].waterfall_ft8_marker",rx->channel);
   value=getProperty(name);
   if(value) rx->waterfall_ft8_marker=atoi(value);
+  sprintf(name,"receiver[%d].waterfall_palette",rx->channel);
+  value=getProperty(name);
+  if(value) rx->waterfall_palette=atoi(value);
 
   sprintf(name,"receiver[%d].split",rx->channel);
   value=getProperty(name);
@@ -698,6 +714,19 @@ void update_noise(RECEIVER *rx) {
 static gboolean window_delete(GtkWidget *widget,GdkEvent *event, gpointer data) {
   RECEIVER *rx=(RECEIVER *)data;
   g_source_remove(rx->update_timer_id);
+  if(rx->render!=NULL) {
+    render_worker_free(rx->render);
+    rx->render=NULL;
+  }
+  // trace_max and trace_avg share the trace_min block
+  g_free(rx->trace_min);
+  rx->trace_min=NULL;
+  rx->trace_max=NULL;
+  rx->trace_avg=NULL;
+  rx->trace_columns=0;
+  g_free(rx->waterfall_samples);
+  rx->waterfall_samples=NULL;
+  rx->waterfall_columns=0;
   if(radio->dialog!=NULL) {
     gtk_widget_destroy(radio->dialog);
     radio->dialog=NULL;
@@ -706,6 +735,8 @@ static gboolean window_delete(GtkWidget *widget,GdkEvent *event, gpointer data)
     gtk_widget_destroy(rx->bookmark_dialog);
     rx->bookmark_dialog=NULL;
   }
+  // stop the DSP before delete_receiver() frees the ring and tasks
+  receiver_stop_dsp(rx);
   delete_receiver(rx);
   return FALSE;
 }
@@ -1033,22 +1064,128 @@ gboolean receiver_scroll_event_cb(GtkWidget *widget, GdkEventScroll *event, gpoi
   return TRUE;
 }
         
+//
+// copy what a frame is drawn from, and hand back the automatic waterfall
+// levels the last frame worked out, called with rx->mutex held
+//
+static void render_view_update(RECEIVER *rx,RENDER_VIEW *view) {
+  if(view->waterfall_levels) {
+    if(rx->waterfall_automatic) {
+      rx->waterfall_low=view->waterfall_low;
+      rx->waterfall_high=view->waterfall_high;
+    }
+    view->waterfall_levels=FALSE;
+  }
+  view->frequency_a=rx->frequency_a;
+  view->frequency_b=rx->frequency_b;
+  view->ctun_offset=rx->ctun_offset;
+  view->sample_rate=rx->sample_rate;
+  view->pixels=rx->pixels;
+  view->pixel_oversample=rx->pixel_oversample;
+  view->zoom=rx->zoom;
+  view->pan=rx->pan;
+  view->hz_per_pixel=rx->hz_per_pixel;
+  view->band_a=rx->band_a;
+  view->mode_a=rx->mode_a;
+  view->split=rx->split;
+  view->subrx_enable=rx->subrx_enable;
+  view->filter_low_a=rx->filter_low_a;
+  view->filter_high_a=rx->filter_high_a;
+  view->filter_low_b=rx->filter_low_b;
+  view->filter_high_b=rx->filter_high_b;
+  view->agc=rx->agc;
+  view->panadapter_low=rx->panadapter_low;
+  view->panadapter_high=rx->panadapter_high;
+  view->panadapter_step=rx->panadapter_step;
+  view->panadapter_filled=rx->panadapter_filled;
+  view->panadapter_gradient=rx->panadapter_gradient;
+  view->panadapter_agc_line=rx->panadapter_agc_line;
+  view->panadapter_peaks=rx->panadapter_peaks;
+  view->waterfall_low=rx->waterfall_low;
+  view->waterfall_high=rx->waterfall_high;
+  view->waterfall_automatic=rx->waterfall_automatic;
+  view->waterfall_ft8_marker=rx->waterfall_ft8_marker;
+  view->waterfall_palette=rx->waterfall_palette;
+}
+
+//
+// runs on rx->render before each frame, without the render lock since
+// rx->mutex is taken before render_worker_hold() elsewhere
+//
+static void prepare_frame(gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  g_mutex_lock(&rx->mutex);
+  render_view_update(rx,&rx->render_view);
+  g_mutex_unlock(&rx->mutex);
+}
+
+//
+// runs on rx->render, draws the latest frame published by full_rx_buffer()
+// into the panadapter and waterfall surfaces
+//
+static gboolean render_frame(gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  RENDER_VIEW *view=&rx->render_view;
+
+  if(rx->snapshot==NULL || !spectrum_snapshot_acquire(rx->snapshot)) {
+    return FALSE;
+  }
+  SPECTRUM_FRAME *frame=spectrum_snapshot_front(rx->snapshot);
+  rx->pixel_samples=frame->pixel_samples;
+  // the analyzer may have been resized between prepare_frame() and the
+  // render lock, the next frame will have the new size
+  if(frame->pixels_valid && view->pixels==rx->pixels && view->pixel_oversample==rx->pixel_oversample) {
+    update_rx_panadapter(rx,view);
+    update_waterfall(rx,view);
+  }
+  rx->meter_db=frame->meter_db;
+  return TRUE;
+}
+
+// on the main loop once a frame has been drawn, only the blits are left
+static void present_frame(gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  if(rx->panadapter!=NULL) {
+    gtk_widget_queue_draw(rx->panadapter);
+  }
+  if(rx->waterfall!=NULL) {
+    gtk_widget_queue_draw(rx->waterfall);
+  }
+  update_meter(rx);
+}
+
 static gboolean update_timer_cb(void *data) {
-  int rc;
   RECEIVER *rx=(RECEIVER *)data;
   char *ptr;
 
-  g_mutex_lock(&rx->mutex);
+  if(headless) {
+    // nothing to draw but rigctl still reads the S meter
+    if(!isTransmitting(radio) || (rx->duplex)) {
+      rx->meter_db=GetRXAMeter(rx->channel,rx->smeter) + radio->meter_calibration;
+    }
+    return TRUE;
+  }
+
+  // draw from the latest frame published by full_rx_buffer(), the DSP
+  // thread never waits for the drawing and rx->mutex is not needed here
   if(!isTransmitting(radio) || (rx->duplex)) {
-    if(rx->panadapter_resize_timer==-1) {
-      GetPixels(rx->channel,0,rx->pixel_samples,&rc);
-      if(rc) {
-        update_rx_panadapter(rx);
-        update_waterfall(rx);
+    if(rx->render!=NULL) {
+      if(rx->panadapter_resize_timer==-1) {
+        render_worker_request(rx->render);
+      }
+    } else if(rx->snapshot!=NULL && spectrum_snapshot_acquire(rx->snapshot)) {
+      SPECTRUM_FRAME *frame=spectrum_snapshot_front(rx->snapshot);
+      rx->pixel_samples=frame->pixel_samples;
+      if(frame->pixels_valid && rx->panadapter_resize_timer==-1) {
+        g_mutex_lock(&rx->mutex);
+        render_view_update(rx,&rx->render_view);
+        g_mutex_unlock(&rx->mutex);
+        update_rx_panadapter(rx,&rx->render_view);
+        update_waterfall(rx,&rx->render_view);
       }
+      rx->meter_db=frame->meter_db;
+      present_frame(rx);
     }
-    rx->meter_db=GetRXAMeter(rx->channel,rx->smeter) + radio->meter_calibration;
-    update_meter(rx);
   }
   update_radio_info(rx);
 
@@ -1063,7 +1200,6 @@ static gboolean update_timer_cb(void *data) {
   if(radio->transmitter!=NULL && !radio->transmitter->updated) {
     update_tx_panadapter(radio);
   }
-  g_mutex_unlock(&rx->mutex);
   return TRUE;
 }
  
@@ -1169,111 +1305,6 @@ void receiver_band_changed(RECEIVER *rx,int band) {
   frequency_changed(rx);
 }
 
-static void process_rx_buffer(RECEIVER *rx) {
-  gdouble left_sample,right_sample;
-  short left_audio_sample, right_audio_sample;
-  SUBRX *subrx=(SUBRX *)rx->subrx;
-
-  for (int i=0;i<rx->output_samples;i++) {
-    // if subrx is enabled left channel is main and right channel is sub
-    if(rx->subrx_enable) {
-      left_sample=rx->audio_output_buffer[i*2];
-      right_sample=subrx->audio_output_buffer[i*2];
-    } else {
-      // Rx option for left channel only, right only, or both channels
-      switch (rx->audio_channels) {
-        case AUDIO_STEREO: {
-          left_sample = rx->audio_output_buffer[i*2];
-          right_sample = rx->audio_output_buffer[(i*2)+1];     
-          break;
-        }      
-        case AUDIO_LEFT_ONLY: {
-          left_sample = rx->audio_output_buffer[i*2];
-          right_sample = 0;
-          break;
-        }
-        case AUDIO_RIGHT_ONLY: {
-          left_sample = 0;
-          right_sample = rx->audio_output_buffer[(i*2)+1];
-          break;
-        }
-      }
-    }
-    left_audio_sample=(short)(left_sample*32767.0);
-    right_audio_sample=(short)(right_sample*32767.0);
-
-    if(rx->local_audio) {
-      audio_write(rx,(float)left_sample,(float)right_sample);
-    }
-
-    if(radio->active_receiver==rx) {
-
-      if ((isTransmitting(radio) || rx->remote_audio==FALSE) &&  (!rx->duplex)) {
-        left_audio_sample=0;
-        right_audio_sample=0;
-      }
-      switch(radio->discovered->protocol) {
-        case PROTOCOL_1:
-          if(radio->discovered->device!=DEVICE_HERMES_LITE2) {
-            protocol1_audio_samples(rx,left_audio_sample,right_audio_sample);
-          }
-          break;
-        case PROTOCOL_2:
-          protocol2_audio_samples(rx,left_audio_sample,right_audio_sample);
-          break;
-      }
-    }
-  }
-  if(rx->local_audio && !rx->output_started) {
-    audio_start_output(rx);
-  }
-}
-
-static void full_rx_buffer(RECEIVER *rx) {
-  int error;
-
-  if(isTransmitting(radio) && (!rx->duplex)) return;
-
-  // noise blanker works on origianl IQ samples
-  if(rx->nb) {
-     xanbEXT (rx->channel, rx->iq_input_buffer, rx->iq_input_buffer);
-  }
-  if(rx->nb2) {
-     xnobEXT (rx->channel, rx->iq_input_buffer, rx->iq_input_buffer);
-  }
-
-  g_mutex_lock(&rx->mutex);
-  fexchange0(rx->channel, rx->iq_input_buffer, rx->audio_output_buffer, &error);
-  //if(error!=0 && error!=-2) {
-  if(error!=0) {    
-    fprintf(stderr,"full_rx_buffer: channel=%d fexchange0: error=%d\n",rx->channel,error);
-  }
-
-  if(rx->subrx_enable) {
-    subrx_iq_buffer(rx);
-  }
-
-  Spectrum0(1, rx->channel, 0, 0, rx->iq_input_buffer);
-  
-  process_rx_buffer(rx);
-  g_mutex_unlock(&rx->mutex);
-
-}
-
-void add_iq_samples(RECEIVER *rx,double i_sample,double q_sample) {
-  rx->iq_input_buffer[rx->samples*2]=i_sample;
-  rx->iq_input_buffer[(rx->samples*2)+1]=q_sample;
-  rx->samples=rx->samples+1;
-  if(rx->samples>=rx->buffer_size) {
-    full_rx_buffer(rx);
-    rx->samples=0;
-  }
-
-  if(rx->bpsk_enable && rx->bpsk!=NULL) {
-    bpsk_add_iq_samples(rx->bpsk,i_sample,q_sample);
-  }
-}
-
 static gboolean receiver_configure_event_cb(GtkWidget *widget,GdkEventConfigure *event,gpointer data) {
   RECEIVER *rx=(RECEIVER *)data;
   gint width=gtk_widget_get_allocated_width(widget);
@@ -1417,7 +1448,7 @@ void receiver_init_analyzer(RECEIVER *rx) {
     int clip = 0;
     int span_clip_l = 0;
     int span_clip_h = 0;
-    int pixels=rx->pixels;
+    int pixels;
     int stitches = 1;
     int calibration_data_set = 0;
     double span_min_freq = 0.0;
@@ -1425,13 +1456,28 @@ void receiver_init_analyzer(RECEIVER *rx) {
 
 //g_print("receiver_init_analyzer: channel=%d zoom=%d pixels=%d pixel_samples=%p pan=%d\n",rx->channel,rx->zoom,rx->pixels,rx->pixel_samples,rx->pan);
 
-  if(rx->pixel_samples!=NULL) {
-//g_print("receiver_init_analyzer: g_free: channel=%d pixel_samples=%p\n",rx->channel,rx->pixel_samples);
-    g_free(rx->pixel_samples);
+  // pixel_samples points into the snapshot, only replaced with rx->mutex
+  // held (or before the receiver is running) so the DSP thread never
+  // publishes into a freed frame, and with the render worker held so it
+  // is not drawing from one
+  if(rx->render!=NULL) {
+    render_worker_hold(rx->render);
+  }
+  if(rx->snapshot!=NULL) {
+    spectrum_snapshot_free(rx->snapshot);
+    rx->snapshot=NULL;
     rx->pixel_samples=NULL;
   }
+  // the peak envelope needs several analyzer values per display pixel, as
+  // long as there are fft bins to give them
+  rx->pixel_oversample=1;
+  if(rx->panadapter_peaks && !opengl && rx->pixels>0) {
+    rx->pixel_oversample=MAX(1,MIN(PANADAPTER_PEAK_OVERSAMPLE,fft_size/rx->pixels));
+  }
+  pixels=rx->pixels*rx->pixel_oversample;
   if(rx->pixels>0) {
-    rx->pixel_samples=g_new0(float,rx->pixels);
+    rx->snapshot=spectrum_snapshot_new(pixels);
+    rx->pixel_samples=spectrum_snapshot_front(rx->snapshot)->pixel_samples;
     rx->hz_per_pixel=(gdouble)rx->sample_rate/(gdouble)rx->pixels;
 
     int max_w = fft_size + (int) fmin(keep_time * (double) rx->fps, keep_time * (double) fft_size * (double) rx->fps);
@@ -1462,11 +1508,19 @@ void receiver_init_analyzer(RECEIVER *rx) {
             max_w //max samples to hold in input ring buffers
     );
   }
+  if(rx->render!=NULL) {
+    render_worker_release(rx->render);
+  }
 
 }
 
 void receiver_change_zoom(RECEIVER *rx,int zoom) {
 g_print("%s: %d\n",__FUNCTION__,zoom);
+  g_mutex_lock(&rx->mutex);
+  // pixels and pan must not change under a frame being drawn
+  if(rx->render!=NULL) {
+    render_worker_hold(rx->render);
+  }
   rx->zoom=zoom;
   rx->pixels=rx->panadapter_width*rx->zoom;
   if(rx->zoom==1) {
@@ -1483,6 +1537,10 @@ g_print("%s: %d\n",__FUNCTION__,zoom);
     }
   }
   receiver_init_analyzer(rx);
+  if(rx->render!=NULL) {
+    render_worker_release(rx->render);
+  }
+  g_mutex_unlock(&rx->mutex);
 }
 
 RECEIVER *create_receiver(int channel,int sample_rate) {
@@ -1496,6 +1554,7 @@ RECEIVER *create_receiver(int channel,int sample_rate) {
 
 g_print("create_receiver: channel=%d sample_rate=%d\n", channel, sample_rate);
   g_mutex_init(&rx->mutex);
+  g_mutex_init(&rx->surface_mutex);
   rx->channel=channel;
   rx->adc=0;
 
@@ -1617,8 +1676,11 @@ g_print("create_receiver: channel=%d frequency_min=%ld frequency_max=%ld\n", cha
 
   rx->pixels=0;
   rx->pixel_samples=NULL;
-  rx->waterfall_pixbuf=NULL;
-  rx->iq_sequence=0;
+  rx->render=NULL;
+  rx->waterfall_surface=NULL;
+  sequence_reset(&rx->iq_stats);
+  rx->iq_timestamp=IQ_TIMESTAMP_NONE;
+  rx->iq_timestamp_offset=0;
 #ifdef SOAPYSDR
   if(radio->discovered->device==DEVICE_SOAPYSDR) {
     rx->buffer_size=1024; //2048;
@@ -1676,13 +1738,22 @@ fprintf(stderr,"create_receiver: fft_size=%d\n",rx->fft_size);
   rx->panadapter_high=-60;
   rx->panadapter_step=20;
   rx->panadapter_surface=NULL;
+  rx->panadapter_static=NULL;
   
   rx->panadapter_filled=TRUE;
   rx->panadapter_gradient=TRUE;
   rx->panadapter_agc_line=TRUE;
+  rx->panadapter_peaks=FALSE;
+  rx->trace_columns=0;
+  rx->trace_min=NULL;
+  rx->waterfall_columns=0;
+  rx->waterfall_samples=NULL;
+  rx->pixel_oversample=1;
 
   rx->waterfall_automatic=TRUE;
   rx->waterfall_ft8_marker=FALSE;
+  rx->waterfall_palette=PALETTE_DEFAULT;
+  waterfall_palette_init(&rx->waterfall_lut);
 
   rx->vfo_surface=NULL;
   rx->meter_surface=NULL;
@@ -1745,6 +1816,19 @@ fprintf(stderr,"create_receiver: fft_size=%d\n",rx->fft_size);
   rx->subrx_enable=FALSE;
   rx->subrx=NULL;
 
+  rx->iq_ring=NULL;
+  rx->dsp_task=NULL;
+  rx->subrx_task=NULL;
+  rx->dsp_iq_buffer=NULL;
+  rx->dsp_timestamp=IQ_TIMESTAMP_NONE;
+  rx->dsp_timestamp_offset=0;
+  rx->dsp_latency=0;
+  rx->dsp_latencies=NULL;
+  rx->dsp_scheduled=0;
+  rx->dsp_running=FALSE;
+  rx->dsp_stats_label=NULL;
+  rx->dsp_stats_timer_id=0;
+
   receiver_restore_state(rx);
 
   if(radio->discovered->protocol==PROTOCOL_1) {
@@ -1821,11 +1905,19 @@ g_print("receiver_change_sample_rate: resample_step=%d\n",rx->resample_step);
     receiver_init_analyzer(rx);
   }
 
+  receiver_start_dsp(rx);
+
   SetDisplayDetectorMode(rx->channel, 0, DETECTOR_MODE_AVERAGE/*display_detector_mode*/);
   SetDisplayAverageMode(rx->channel, 0,  AVERAGE_MODE_LOG_RECURSIVE/*display_average_mode*/);
   calculate_display_average(rx); 
 
-  create_visual(rx);
+  if(!headless) {
+    create_visual(rx);
+    if(!opengl) {
+      sprintf(name,"render %d",rx->channel);
+      rx->render=render_worker_new(name,prepare_frame,render_frame,present_frame,rx);
+    }
+  }
   if(rx->window!=NULL) {
     gtk_widget_show_all(rx->window);
     sprintf(name,"receiver[%d].x",rx->channel);
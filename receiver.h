@@ -27,8 +27,87 @@
 #include <alsa/asoundlib.h>
 #endif
 
+#include "iq_convert.h"
+#include "sequence.h"
+#include "spectrum_snapshot.h"
+#include "render_worker.h"
+#include "waterfall_palette.h"
+
 typedef enum {SPLIT_OFF, SPLIT_ON, SPLIT_SAT, SPLIT_RSAT} split_type;
 
+#define PANADAPTER_PEAK_OVERSAMPLE 4
+
+// everything the static panadapter layer was drawn from, compared as a
+// whole each frame to decide whether the layer needs redrawing
+typedef struct _panadapter_layer_key {
+  gint width;
+  gint height;
+  gint surface_width;
+  gint surface_height;
+  gint64 frequency_a;
+  gint64 frequency_b;
+  gint64 ctun_offset;
+  gint sample_rate;
+  gint pixels;
+  gint zoom;
+  gint pan;
+  gdouble hz_per_pixel;
+  gint band;
+  gint mode;
+  gint split;
+  gboolean subrx_enable;
+  gint filter_low_a;
+  gint filter_high_a;
+  gint filter_low_b;
+  gint filter_high_b;
+  gint sidetone;
+  gint low;
+  gint high;
+  gint step;
+  gboolean gradient;
+  gint agc;
+  gint hang_y;
+  gint knee_y;
+} PANADAPTER_LAYER_KEY;
+
+// the receiver settings the panadapter and waterfall are drawn from, the
+// GUI changes them on the main loop so a frame drawn on the render worker
+// works from a copy taken under rx->mutex
+typedef struct _render_view {
+  gint64 frequency_a;
+  gint64 frequency_b;
+  gint64 ctun_offset;
+  gint sample_rate;
+  gint pixels;
+  gint pixel_oversample;
+  gint zoom;
+  gint pan;
+  gdouble hz_per_pixel;
+  gint band_a;
+  gint mode_a;
+  gint split;
+  gboolean subrx_enable;
+  gint filter_low_a;
+  gint filter_high_a;
+  gint filter_low_b;
+  gint filter_high_b;
+  gint agc;
+  gint panadapter_low;
+  gint panadapter_high;
+  gint panadapter_step;
+  gboolean panadapter_filled;
+  gboolean panadapter_gradient;
+  gboolean panadapter_agc_line;
+  gboolean panadapter_peaks;
+  gint waterfall_low;
+  gint waterfall_high;
+  gboolean waterfall_automatic;
+  gboolean waterfall_ft8_marker;
+  gint waterfall_palette;
+  // set when update_waterfall() has new automatic levels to hand back
+  gboolean waterfall_levels;
+} RENDER_VIEW;
+
 typedef struct _receiver {
   
   gint channel; // WDSP channel
@@ -45,19 +124,35 @@ typedef struct _receiver {
 
   gdouble *buffer;
 
-  guint32 iq_sequence;
+  SEQUENCE_STATS iq_stats;
   gdouble *iq_input_buffer;
+  // radio time tag of the block being filled (sample offset into the block)
+  gint64 iq_timestamp;
+  gint iq_timestamp_offset;
   guint32 audio_sequence;
   gdouble *audio_output_buffer;
   gint audio_buffer_size;
   guchar *audio_buffer;
   gfloat *pixel_samples;
+  // pixels and meter published by the DSP thread for the GUI
+  SPECTRUM_SNAPSHOT *snapshot;
+  gint64 snapshot_due;
+  // draws the panadapter and waterfall from the snapshot, NULL when they
+  // are drawn on the main loop (opengl or headless)
+  RENDER_WORKER *render;
+  // the settings the frame being drawn is drawn from
+  RENDER_VIEW render_view;
+  // held by the worker while it changes what the draw callbacks paint
+  GMutex surface_mutex;
 
   gint update_timer_id;
 
   gint samples;
   gint output_samples;
   gint pixels;
+  // analyzer values per display pixel, more than one only while the peak
+  // envelope is shown so pixel_samples holds pixels*pixel_oversample values
+  gint pixel_oversample;
   gint fps;
   gdouble display_average_time;
   
@@ -169,6 +264,13 @@ typedef struct _receiver {
   gint panadapter_resize_height;
   guint panadapter_resize_timer;
   cairo_surface_t *panadapter_surface;
+  // image surface the next frame is drawn into before being swapped with
+  // panadapter_surface
+  cairo_surface_t *panadapter_back;
+  // background, grid, labels, cursors and AGC lines; only the signal
+  // trace is drawn over it each frame
+  cairo_surface_t *panadapter_static;
+  PANADAPTER_LAYER_KEY panadapter_static_key;
 
   gint panadapter_low;
   gint panadapter_high;
@@ -176,6 +278,15 @@ typedef struct _receiver {
   gboolean panadapter_filled;
   gboolean panadapter_gradient;
   gboolean panadapter_agc_line;  
+  gboolean panadapter_peaks;
+  // the visible span of pixel_samples reduced to one value per column
+  gint trace_columns;
+  gfloat *trace_min;
+  gfloat *trace_max;
+  gfloat *trace_avg;
+  // waterfall line reduced from oversampled pixel_samples
+  gint waterfall_columns;
+  gfloat *waterfall_samples;
 
   GtkWidget *waterfall;
   gint waterfall_width;
@@ -183,12 +294,18 @@ typedef struct _receiver {
   gint waterfall_resize_width;
   gint waterfall_resize_height;
   guint waterfall_resize_timer;
-  GdkPixbuf *waterfall_pixbuf;
+  cairo_surface_t *waterfall_surface;
+  // waterfall_surface is a ring: the newest line is row waterfall_head and
+  // display column 0 is stored at column waterfall_offset
+  gint waterfall_head;
+  gint waterfall_offset;
 
   gint waterfall_low;
   gint waterfall_high;
   gboolean waterfall_automatic;
   gboolean waterfall_ft8_marker;
+  gint waterfall_palette;
+  WATERFALL_PALETTE waterfall_lut;
   gint64 waterfall_frequency;
   gint waterfall_sample_rate;
   
@@ -247,6 +364,23 @@ typedef struct _receiver {
   gboolean subrx_enable;
   void *subrx;
 
+  void *iq_ring;
+  void *dsp_task;
+  void *subrx_task;
+  gdouble *dsp_iq_buffer;
+  // radio time tag of the block last passed through the DSP chain, set
+  // under rx->mutex and shown in the DSP stats dialog
+  gint64 dsp_timestamp;
+  gint dsp_timestamp_offset;
+  // usec from the last block being queued to its audio being sent
+  gint64 dsp_latency;
+  // when set every block's latency is appended, used by dsp_bench
+  GArray *dsp_latencies;
+  gint dsp_scheduled;
+  gboolean dsp_running;
+  GtkWidget *dsp_stats_label;
+  guint dsp_stats_timer_id;
+
   int resample_step;
 
   GtkWidget *local_audio_b;
@@ -280,7 +414,6 @@ enum {
 extern RECEIVER *create_receiver(int channel,int sample_rate);
 extern void receiver_update_title(RECEIVER *rx);
 extern void receiver_init_analyzer(RECEIVER *rx);
-extern void add_iq_samples(RECEIVER *r,double left,double right);
 extern gboolean receiver_button_press_event_cb(GtkWidget *widget, GdkEventButton *event, gpointer data);
 extern gboolean receiver_button_release_event_cb(GtkWidget *widget, GdkEventButton *event, gpointer data);
 extern gboolean receiver_motion_notify_event_cb(GtkWidget *widget, GdkEventMotion *event, gpointer data);
@@ -42,6 +42,8 @@
 #include "audio.h"
 #include "main.h"
 #include "rigctl.h"
+#include "iq_ring.h"
+#include "protocol1.h"
 
 #define BAND_COLUMNS 5
 #define MODE_COLUMNS 4
@@ -811,6 +813,15 @@ static void panadapter_agc_line_changed_cb(GtkWidget *widget, gpointer data) {
   rx->panadapter_agc_line=rx->panadapter_agc_line==TRUE?FALSE:TRUE;
 }
 
+static void panadapter_peaks_changed_cb(GtkWidget *widget, gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  rx->panadapter_peaks=rx->panadapter_peaks==TRUE?FALSE:TRUE;
+  // the analyzer is oversampled while the envelope is shown
+  g_mutex_lock(&rx->mutex);
+  receiver_init_analyzer(rx);
+  g_mutex_unlock(&rx->mutex);
+}
+
 static void waterfall_high_value_changed_cb(GtkWidget *widget, gpointer data) {
   RECEIVER *rx=(RECEIVER *)data;
   rx->waterfall_high=gtk_range_get_value(GTK_RANGE(widget));
@@ -826,6 +837,11 @@ static void waterfall_automatic_cb(GtkWidget *widget, gpointer data) {
   rx->waterfall_automatic=rx->waterfall_automatic==1?0:1;
 }
 
+static void waterfall_palette_cb(GtkWidget *widget, gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  rx->waterfall_palette=gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+}
+
 static void waterfall_ft8_marker_cb(GtkWidget *widget, gpointer data) {
   RECEIVER *rx=(RECEIVER *)data;
   rx->waterfall_ft8_marker=rx->waterfall_ft8_marker==TRUE?FALSE:TRUE;
@@ -997,6 +1013,73 @@ static void cat_baudrate_cb(GtkWidget *widget,gpointer data) {
   }
 }
 
+static gboolean dsp_stats_timeout_cb(gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  IQ_RING *ring=(IQ_RING *)rx->iq_ring;
+  SEQUENCE_STATS *stats=NULL;
+  RECEIVER *other;
+  gint64 timestamp;
+  gint offset;
+  gint64 other_timestamp;
+  char text[512];
+  int n;
+  int i;
+
+  if(rx->dsp_stats_label==NULL) {
+    rx->dsp_stats_timer_id=0;
+    return FALSE;
+  }
+  if(ring!=NULL) {
+    n=sprintf(text,"Queue: %d/%d (max %d)\nOverruns: %ld\nLatency: %ld us",iq_ring_depth(ring),ring->blocks,ring->max_depth,ring->overruns,(long)rx->dsp_latency);
+    switch(radio->discovered->protocol) {
+      case PROTOCOL_1:
+        // all receivers share the EP6 stream
+        stats=&ep6_stats;
+        break;
+      case PROTOCOL_2:
+        stats=&rx->iq_stats;
+        break;
+    }
+    if(stats!=NULL) {
+      n+=sprintf(&text[n],"\nNetwork: %ld packets\nLost: %ld Dup: %ld Late: %ld Restarts: %ld Bad: %ld",
+              stats->packets,stats->lost,stats->duplicates,stats->reordered,stats->restarts,stats->malformed);
+    }
+
+    // radio time tag of the last block through the DSP, receivers on the
+    // same ADC at the same rate are aligned when their blocks carry equal tags
+    g_mutex_lock(&rx->mutex);
+    timestamp=rx->dsp_timestamp;
+    offset=rx->dsp_timestamp_offset;
+    g_mutex_unlock(&rx->mutex);
+    if(timestamp!=IQ_TIMESTAMP_NONE) {
+      n+=sprintf(&text[n],"\nTime tag: %lld (sample %d)",(long long)timestamp,offset);
+      for(i=0;i<radio->discovered->supported_receivers;i++) {
+        other=radio->receiver[i];
+        if(other==NULL || other==rx || other->adc!=rx->adc || other->sample_rate!=rx->sample_rate) {
+          continue;
+        }
+        g_mutex_lock(&other->mutex);
+        other_timestamp=other->dsp_timestamp;
+        g_mutex_unlock(&other->mutex);
+        if(other_timestamp!=IQ_TIMESTAMP_NONE && n<(int)sizeof(text)-64) {
+          n+=sprintf(&text[n],"\nSkew to RX%d: %lld",other->channel,(long long)(other_timestamp-timestamp));
+        }
+      }
+    }
+    gtk_label_set_text(GTK_LABEL(rx->dsp_stats_label),text);
+  }
+  return TRUE;
+}
+
+static void dsp_stats_destroy_cb(GtkWidget *widget,gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  if(rx->dsp_stats_timer_id!=0) {
+    g_source_remove(rx->dsp_stats_timer_id);
+    rx->dsp_stats_timer_id=0;
+  }
+  rx->dsp_stats_label=NULL;
+}
+
 void update_receiver_dialog(RECEIVER *rx) {
   int i;
 
@@ -1382,6 +1465,11 @@ GtkWidget *create_receiver_dialog(RECEIVER *rx) {
   gtk_grid_attach(GTK_GRID(panadapter_grid),panadapter_agc_line,0,7,2,1);
   g_signal_connect(panadapter_agc_line,"toggled",G_CALLBACK(panadapter_agc_line_changed_cb),rx);
 
+  GtkWidget *panadapter_peaks=gtk_check_button_new_with_label("Peak Envelope");
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (panadapter_peaks), rx->panadapter_peaks);
+  gtk_grid_attach(GTK_GRID(panadapter_grid),panadapter_peaks,0,8,2,1);
+  g_signal_connect(panadapter_peaks,"toggled",G_CALLBACK(panadapter_peaks_changed_cb),rx);
+
   GtkWidget *waterfall_frame=gtk_frame_new("Waterfall");
   GtkWidget *waterfall_grid=gtk_grid_new();
   gtk_grid_set_row_homogeneous(GTK_GRID(waterfall_grid),FALSE);
@@ -1418,6 +1506,17 @@ GtkWidget *create_receiver_dialog(RECEIVER *rx) {
   gtk_grid_attach(GTK_GRID(waterfall_grid),waterfall_ft8_marker,0,3,2,1);
   g_signal_connect(waterfall_ft8_marker,"toggled",G_CALLBACK(waterfall_ft8_marker_cb),rx);
 
+  GtkWidget *waterfall_palette_label=gtk_label_new("Palette:");
+  gtk_grid_attach(GTK_GRID(waterfall_grid),waterfall_palette_label,0,4,1,1);
+
+  GtkWidget *waterfall_palette_combo=gtk_combo_box_text_new();
+  for(i=0;i<PALETTES;i++) {
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(waterfall_palette_combo),NULL,palette_names[i]);
+  }
+  gtk_combo_box_set_active(GTK_COMBO_BOX(waterfall_palette_combo),rx->waterfall_palette);
+  gtk_grid_attach(GTK_GRID(waterfall_grid),waterfall_palette_combo,1,4,1,1);
+  g_signal_connect(waterfall_palette_combo,"changed",G_CALLBACK(waterfall_palette_cb),rx);
+
   col++;
   row=0;
 
@@ -1483,5 +1582,19 @@ GtkWidget *create_receiver_dialog(RECEIVER *rx) {
   }
   gtk_grid_attach(GTK_GRID(cat_grid),cat_serial_port_baudrate,1,6,1,1);
   g_signal_connect(cat_serial_port_baudrate,"changed",G_CALLBACK(cat_baudrate_cb),rx);
+
+  GtkWidget *dsp_frame=gtk_frame_new("DSP");
+  GtkWidget *dsp_grid=gtk_grid_new();
+  gtk_grid_set_row_homogeneous(GTK_GRID(dsp_grid),FALSE);
+  gtk_grid_set_column_homogeneous(GTK_GRID(dsp_grid),FALSE);
+  gtk_container_add(GTK_CONTAINER(dsp_frame),dsp_grid);
+  gtk_grid_attach(GTK_GRID(grid),dsp_frame,col,3,1,1);
+
+  rx->dsp_stats_label=gtk_label_new(NULL);
+  gtk_widget_set_halign(rx->dsp_stats_label,GTK_ALIGN_START);
+  gtk_grid_attach(GTK_GRID(dsp_grid),rx->dsp_stats_label,0,0,1,1);
+  g_signal_connect(dsp_frame,"destroy",G_CALLBACK(dsp_stats_destroy_cb),rx);
+  dsp_stats_timeout_cb(rx);
+  rx->dsp_stats_timer_id=g_timeout_add(500,dsp_stats_timeout_cb,rx);
   return grid;
 }
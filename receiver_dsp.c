@@ -0,0 +1,332 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <string.h>
+#include <wdsp.h>
+
+#include "discovered.h"
+#include "bpsk.h"
+#include "receiver.h"
+#include "transmitter.h"
+#include "wideband.h"
+#include "adc.h"
+#include "dac.h"
+#include "radio.h"
+#include "main.h"
+#include "protocol1.h"
+#include "protocol2.h"
+#include "audio.h"
+#include "subrx.h"
+#include "iq_ring.h"
+#include "dsp_pool.h"
+#include "receiver_dsp.h"
+
+//
+// the per-block receive path, kept apart from the receiver window so that
+// dsp_bench runs the same code
+// the network threads add I/Q with add_iq_block(), each full block is
+// queued on rx->iq_ring and receiver_dsp_task() runs it through WDSP on
+// the DSP pool
+//
+
+static void process_rx_buffer(RECEIVER *rx) {
+  gdouble left_sample,right_sample;
+  SUBRX *subrx=(SUBRX *)rx->subrx;
+  gboolean mute=(isTransmitting(radio) || rx->remote_audio==FALSE) && (!rx->duplex);
+
+  for (int i=0;i<rx->output_samples;i++) {
+    // if subrx is enabled left channel is main and right channel is sub
+    if(rx->subrx_enable) {
+      left_sample=rx->audio_output_buffer[i*2];
+      right_sample=subrx->audio_output_buffer[i*2];
+    } else {
+      // Rx option for left channel only, right only, or both channels
+      switch (rx->audio_channels) {
+        case AUDIO_STEREO: {
+          left_sample = rx->audio_output_buffer[i*2];
+          right_sample = rx->audio_output_buffer[(i*2)+1];     
+          break;
+        }      
+        case AUDIO_LEFT_ONLY: {
+          left_sample = rx->audio_output_buffer[i*2];
+          right_sample = 0;
+          break;
+        }
+        case AUDIO_RIGHT_ONLY: {
+          left_sample = 0;
+          right_sample = rx->audio_output_buffer[(i*2)+1];
+          break;
+        }
+      }
+    }
+    // leave the stereo output in place for the block senders
+    rx->audio_output_buffer[i*2]=left_sample;
+    rx->audio_output_buffer[(i*2)+1]=right_sample;
+
+    if(rx->local_audio) {
+      audio_write(rx,(float)left_sample,(float)right_sample);
+    }
+  }
+  if(radio->active_receiver==rx) {
+    if(radio->discovered->protocol==PROTOCOL_1) {
+      if(radio->discovered->device!=DEVICE_HERMES_LITE2) {
+        protocol1_audio_block(rx,rx->audio_output_buffer,rx->output_samples,mute);
+      }
+    } else if(radio->discovered->protocol==PROTOCOL_2) {
+      protocol2_audio_block(rx,rx->audio_output_buffer,rx->output_samples,mute);
+    }
+  }
+  if(rx->local_audio && !rx->output_started) {
+    audio_start_output(rx);
+  }
+}
+
+//
+// called with rx->mutex held, at most once per display frame copy the
+// pixels and the meter into the snapshot for update_timer_cb()
+//
+static void publish_snapshot(RECEIVER *rx) {
+  int rc;
+  gint64 now=g_get_monotonic_time();
+
+  if(rx->snapshot==NULL || now<rx->snapshot_due) return;
+  rx->snapshot_due=now+(1000000/rx->fps);
+
+  SPECTRUM_FRAME *frame=spectrum_snapshot_back(rx->snapshot);
+  GetPixels(rx->channel,0,frame->pixel_samples,&rc);
+  frame->pixels_valid=rc;
+  frame->meter_db=GetRXAMeter(rx->channel,rx->smeter) + radio->meter_calibration;
+  spectrum_snapshot_publish(rx->snapshot);
+}
+
+static void full_rx_buffer(RECEIVER *rx,gdouble *iq_buffer,const IQ_TIMESTAMP *timestamp) {
+  int error;
+  gboolean subrx_enable=rx->subrx_enable;
+
+  if(isTransmitting(radio) && (!rx->duplex)) return;
+
+  // noise blanker works on origianl IQ samples
+  if(rx->nb) {
+     xanbEXT (rx->channel, iq_buffer, iq_buffer);
+  }
+  if(rx->nb2) {
+     xnobEXT (rx->channel, iq_buffer, iq_buffer);
+  }
+
+  g_mutex_lock(&rx->mutex);
+  // read by the DSP stats dialog to show the alignment between receivers
+  rx->dsp_timestamp=timestamp->timestamp;
+  rx->dsp_timestamp_offset=timestamp->offset;
+  if(subrx_enable) {
+    // the sub receiver exchange runs on another worker
+    rx->dsp_iq_buffer=iq_buffer;
+    dsp_pool_submit((DSP_TASK *)rx->subrx_task);
+  }
+
+  fexchange0(rx->channel, iq_buffer, rx->audio_output_buffer, &error);
+  //if(error!=0 && error!=-2) {
+  if(error!=0) {    
+    fprintf(stderr,"full_rx_buffer: channel=%d fexchange0: error=%d\n",rx->channel,error);
+  }
+
+  if(!headless) {
+    Spectrum0(1, rx->channel, 0, 0, iq_buffer);
+  }
+
+  if(subrx_enable) {
+    dsp_pool_wait((DSP_TASK *)rx->subrx_task);
+  }
+  
+  process_rx_buffer(rx);
+  if(!headless) {
+    publish_snapshot(rx);
+  }
+  g_mutex_unlock(&rx->mutex);
+
+}
+
+static void subrx_dsp_task(gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  subrx_iq_buffer(rx,rx->dsp_iq_buffer);
+}
+
+// maximum blocks processed before giving other receivers a turn
+#define DSP_TASK_BLOCKS 4
+
+//
+// process the blocks queued on rx->iq_ring
+// a receiver is only queued on the DSP pool once at a time (dsp_scheduled)
+// so its blocks are always processed in order
+//
+static void receiver_dsp_task(gpointer data) {
+  RECEIVER *rx=(RECEIVER *)data;
+  IQ_RING *ring=(IQ_RING *)rx->iq_ring;
+  gdouble *iq_buffer;
+  IQ_TIMESTAMP *timestamp;
+  gint64 latency;
+  int blocks;
+
+  do {
+    blocks=0;
+    while(rx->dsp_running && (iq_buffer=iq_ring_get(ring))!=NULL) {
+      timestamp=iq_ring_get_timestamp(ring);
+      full_rx_buffer(rx,iq_buffer,timestamp);
+      latency=g_get_monotonic_time()-timestamp->queued;
+      rx->dsp_latency=latency;
+      if(rx->dsp_latencies!=NULL) {
+        g_array_append_val(rx->dsp_latencies,latency);
+      }
+      iq_ring_release(ring);
+      blocks++;
+      if(blocks==DSP_TASK_BLOCKS && iq_ring_depth(ring)>0) {
+        // still scheduled, go to the back of the queue
+        dsp_pool_submit((DSP_TASK *)rx->dsp_task);
+        return;
+      }
+    }
+    g_atomic_int_set(&rx->dsp_scheduled,0);
+    // a block may have arrived after the ring was found empty
+  } while(rx->dsp_running && iq_ring_depth(ring)>0 && g_atomic_int_compare_and_exchange(&rx->dsp_scheduled,0,1));
+}
+
+static void receiver_schedule_dsp(RECEIVER *rx) {
+  if(rx->dsp_running && g_atomic_int_compare_and_exchange(&rx->dsp_scheduled,0,1)) {
+    dsp_pool_submit((DSP_TASK *)rx->dsp_task);
+  }
+}
+
+void receiver_start_dsp(RECEIVER *rx) {
+  rx->iq_ring=iq_ring_new(IQ_RING_BLOCKS,rx->buffer_size);
+  rx->dsp_task=dsp_task_new(receiver_dsp_task,(gpointer)rx);
+  rx->subrx_task=dsp_task_new(subrx_dsp_task,(gpointer)rx);
+  rx->dsp_scheduled=0;
+  rx->dsp_running=TRUE;
+}
+
+void receiver_stop_dsp(RECEIVER *rx) {
+  rx->dsp_running=FALSE;
+  // wait for a worker that is still processing this receiver
+  while(g_atomic_int_get(&rx->dsp_scheduled)) {
+    g_usleep(1000);
+  }
+}
+
+//
+// called from delete_receiver() once the DSP has been stopped and the
+// receiver has been taken out of radio->receiver[]
+//
+void receiver_free_dsp(RECEIVER *rx) {
+  iq_ring_free((IQ_RING *)rx->iq_ring);
+  rx->iq_ring=NULL;
+  g_free(rx->dsp_task);
+  rx->dsp_task=NULL;
+  g_free(rx->subrx_task);
+  rx->subrx_task=NULL;
+}
+
+//
+// hand the full iq_input_buffer to the DSP chain with its time tag
+//
+static void receiver_put_iq_block(RECEIVER *rx) {
+  IQ_TIMESTAMP timestamp;
+
+  timestamp.timestamp=rx->iq_timestamp;
+  timestamp.offset=rx->iq_timestamp_offset;
+  if(iq_ring_put((IQ_RING *)rx->iq_ring,rx->iq_input_buffer,&timestamp)) {
+    receiver_schedule_dsp(rx);
+  }
+  rx->samples=0;
+  rx->iq_timestamp=IQ_TIMESTAMP_NONE;
+  rx->iq_timestamp_offset=0;
+}
+
+//
+// tag the next sample added with the radio's timestamp
+// only the first tag in each block is kept, later samples can be placed
+// from it by their offset
+//
+void add_iq_timestamp(RECEIVER *rx,gint64 timestamp) {
+  if(rx->iq_timestamp==IQ_TIMESTAMP_NONE) {
+    rx->iq_timestamp=timestamp;
+    rx->iq_timestamp_offset=rx->samples;
+  }
+}
+
+//
+// add count I/Q samples in the radio's native format
+// the samples are converted straight into iq_input_buffer, splitting the
+// span at block boundaries, and handed on to bpsk once per chunk
+//
+void add_iq_block(RECEIVER *rx,const unsigned char *samples,IQ_FORMAT format,int stride,int count,double scale,gboolean swap) {
+  int n;
+  gdouble *iq;
+
+  while(count>0) {
+    n=rx->buffer_size-rx->samples;
+    if(n>count) n=count;
+    iq=&rx->iq_input_buffer[rx->samples*2];
+    iq_convert(format,samples,stride,iq,n,scale);
+    if(swap) {
+      iq_swap(iq,n);
+    }
+    if(rx->bpsk_enable && rx->bpsk!=NULL) {
+      bpsk_add_iq_block(rx->bpsk,iq,n);
+    }
+    rx->samples+=n;
+    samples+=n*stride;
+    count-=n;
+    if(rx->samples>=rx->buffer_size) {
+      receiver_put_iq_block(rx);
+    }
+  }
+}
+
+//
+// fill in for count I/Q samples lost on the network so that the
+// DSP chain keeps its timing
+//
+void add_iq_zeros(RECEIVER *rx,int count) {
+  int n;
+  gdouble *iq;
+
+  while(count>0) {
+    n=rx->buffer_size-rx->samples;
+    if(n>count) n=count;
+    iq=&rx->iq_input_buffer[rx->samples*2];
+    memset(iq,0,n*2*sizeof(gdouble));
+    if(rx->bpsk_enable && rx->bpsk!=NULL) {
+      bpsk_add_iq_block(rx->bpsk,iq,n);
+    }
+    rx->samples+=n;
+    count-=n;
+    if(rx->samples>=rx->buffer_size) {
+      receiver_put_iq_block(rx);
+    }
+  }
+}
+
+void add_iq_samples(RECEIVER *rx,double i_sample,double q_sample) {
+  gdouble iq[2];
+  iq[0]=i_sample;
+  iq[1]=q_sample;
+  add_iq_block(rx,(unsigned char *)iq,IQ_DOUBLE,sizeof(iq),1,1.0,FALSE);
+}
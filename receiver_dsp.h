@@ -0,0 +1,31 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#ifndef RECEIVER_DSP_H
+#define RECEIVER_DSP_H
+
+extern void receiver_start_dsp(RECEIVER *rx);
+extern void receiver_stop_dsp(RECEIVER *rx);
+extern void receiver_free_dsp(RECEIVER *rx);
+extern void add_iq_samples(RECEIVER *r,double left,double right);
+extern void add_iq_block(RECEIVER *rx,const unsigned char *samples,IQ_FORMAT format,int stride,int count,double scale,gboolean swap);
+extern void add_iq_zeros(RECEIVER *rx,int count);
+extern void add_iq_timestamp(RECEIVER *rx,gint64 timestamp);
+
+#endif
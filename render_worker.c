@@ -0,0 +1,118 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "render_worker.h"
+
+static gboolean present_idle(gpointer data) {
+  RENDER_WORKER *worker=(RENDER_WORKER *)data;
+  g_atomic_int_set(&worker->presenting,0);
+  worker->present_function(worker->data);
+  return FALSE;
+}
+
+static gpointer render_worker_thread(gpointer data) {
+  RENDER_WORKER *worker=(RENDER_WORKER *)data;
+  gboolean drawn;
+
+  g_mutex_lock(&worker->mutex);
+  while(!worker->quit) {
+    if(!worker->pending) {
+      g_cond_wait(&worker->cond,&worker->mutex);
+      continue;
+    }
+    worker->pending=FALSE;
+    g_mutex_unlock(&worker->mutex);
+
+    if(worker->prepare_function!=NULL) {
+      worker->prepare_function(worker->data);
+    }
+    g_rec_mutex_lock(&worker->render);
+    drawn=worker->render_function(worker->data);
+    g_rec_mutex_unlock(&worker->render);
+
+    // the main loop may still be presenting the last frame, that present
+    // will pick up this one as well
+    if(drawn && g_atomic_int_compare_and_exchange(&worker->presenting,0,1)) {
+      g_idle_add(present_idle,worker);
+    }
+    g_mutex_lock(&worker->mutex);
+  }
+  g_mutex_unlock(&worker->mutex);
+  return NULL;
+}
+
+RENDER_WORKER *render_worker_new(const char *name,PREPARE_FUNCTION prepare,RENDER_FUNCTION render,PRESENT_FUNCTION present,gpointer data) {
+  RENDER_WORKER *worker=g_new0(RENDER_WORKER,1);
+  g_mutex_init(&worker->mutex);
+  g_cond_init(&worker->cond);
+  g_rec_mutex_init(&worker->render);
+  worker->pending=FALSE;
+  worker->quit=FALSE;
+  worker->presenting=0;
+  worker->prepare_function=prepare;
+  worker->render_function=render;
+  worker->present_function=present;
+  worker->data=data;
+  worker->thread=g_thread_new(name,render_worker_thread,worker);
+  if(!worker->thread) {
+    fprintf(stderr,"g_thread_new failed on render_worker_thread\n");
+    exit(-1);
+  }
+  return worker;
+}
+
+//
+// ask for a frame, returns at once
+//
+void render_worker_request(RENDER_WORKER *worker) {
+  g_mutex_lock(&worker->mutex);
+  worker->pending=TRUE;
+  g_cond_signal(&worker->cond);
+  g_mutex_unlock(&worker->mutex);
+}
+
+//
+// wait for any frame being drawn and keep the worker out until the matching
+// render_worker_release(), requests made meanwhile are drawn afterwards
+//
+void render_worker_hold(RENDER_WORKER *worker) {
+  g_rec_mutex_lock(&worker->render);
+}
+
+void render_worker_release(RENDER_WORKER *worker) {
+  g_rec_mutex_unlock(&worker->render);
+}
+
+void render_worker_free(RENDER_WORKER *worker) {
+  g_mutex_lock(&worker->mutex);
+  worker->quit=TRUE;
+  g_cond_signal(&worker->cond);
+  g_mutex_unlock(&worker->mutex);
+  g_thread_join(worker->thread);
+  // drop a present that has not run yet, it would use the freed worker
+  while(g_idle_remove_by_data(worker));
+  g_mutex_clear(&worker->mutex);
+  g_cond_clear(&worker->cond);
+  g_rec_mutex_clear(&worker->render);
+  g_free(worker);
+}
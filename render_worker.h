@@ -0,0 +1,60 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#ifndef RENDER_WORKER_H
+#define RENDER_WORKER_H
+
+// prepare runs on the worker thread before each frame, outside the render
+// lock so it may take locks that are held around render_worker_hold(),
+// render runs on the worker thread and returns TRUE if it drew anything,
+// present then runs on the main loop to put the result on screen
+typedef void (*PREPARE_FUNCTION)(gpointer data);
+typedef gboolean (*RENDER_FUNCTION)(gpointer data);
+typedef void (*PRESENT_FUNCTION)(gpointer data);
+
+//
+// a thread that draws one window's displays off the GTK main loop
+// requests made while a frame is being drawn are folded into one, and only
+// one present is ever queued, so a slow display drops frames instead of
+// building up work for the main loop
+//
+typedef struct _render_worker {
+  GThread *thread;
+  GMutex mutex;
+  GCond cond;
+  gboolean pending;
+  gboolean quit;
+  // held for each frame, render_worker_hold() takes it to keep the worker
+  // away while the surfaces or the spectrum buffers are replaced, holds
+  // may nest
+  GRecMutex render;
+  gint presenting;
+  PREPARE_FUNCTION prepare_function;
+  RENDER_FUNCTION render_function;
+  PRESENT_FUNCTION present_function;
+  gpointer data;
+} RENDER_WORKER;
+
+extern RENDER_WORKER *render_worker_new(const char *name,PREPARE_FUNCTION prepare,RENDER_FUNCTION render,PRESENT_FUNCTION present,gpointer data);
+extern void render_worker_request(RENDER_WORKER *worker);
+extern void render_worker_hold(RENDER_WORKER *worker);
+extern void render_worker_release(RENDER_WORKER *worker);
+extern void render_worker_free(RENDER_WORKER *worker);
+
+#endif
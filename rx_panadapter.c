@@ -21,6 +21,7 @@
 #include <epoxy/gl.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wdsp.h>
 #include <sys/socket.h>
 #include <arpa/inet.h> //inet_addr
@@ -32,6 +33,7 @@
 #include "band.h"
 #include "receiver.h"
 #include "rx_panadapter.h"
+#include "trace_decimate.h"
 #include "transmitter.h"
 #include "wideband.h"
 #include "discovered.h"
@@ -54,6 +56,10 @@ static gboolean resize_timeout(void *data) {
 g_print("rx_panadapter: resize_timeout\n");
 
   g_mutex_lock(&rx->mutex);
+  if(rx->render!=NULL) {
+    render_worker_hold(rx->render);
+  }
+  g_mutex_lock(&rx->surface_mutex);
   rx->panadapter_width=rx->panadapter_resize_width;
   rx->panadapter_height=rx->panadapter_resize_height;
   rx->pixels=rx->panadapter_width*rx->zoom;
@@ -64,12 +70,19 @@ g_print("rx_panadapter: resize_timeout\n");
     cairo_surface_destroy (rx->panadapter_surface);
     rx->panadapter_surface=NULL;
   }
+  if (rx->panadapter_back) {
+    cairo_surface_destroy (rx->panadapter_back);
+    rx->panadapter_back=NULL;
+  }
+  if (rx->panadapter_static) {
+    cairo_surface_destroy (rx->panadapter_static);
+    rx->panadapter_static=NULL;
+  }
 
   if(rx->panadapter!=NULL) {
-    rx->panadapter_surface = gdk_window_create_similar_surface (gtk_widget_get_window (rx->panadapter),
-                                       CAIRO_CONTENT_COLOR,
-                                       rx->panadapter_width,
-                                       rx->panadapter_height);
+    // image surfaces so the render worker can draw them off the main loop
+    rx->panadapter_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, rx->panadapter_width, rx->panadapter_height);
+    rx->panadapter_back = cairo_image_surface_create(CAIRO_FORMAT_RGB24, rx->panadapter_width, rx->panadapter_height);
 
     /* Initialize the surface to black */
     cairo_t *cr;
@@ -91,6 +104,10 @@ g_print("rx_panadapter: resize_timeout\n");
     cairo_destroy(cr);
   }
   rx->panadapter_resize_timer=-1;
+  g_mutex_unlock(&rx->surface_mutex);
+  if(rx->render!=NULL) {
+    render_worker_release(rx->render);
+  }
   update_vfo(rx);
   g_mutex_unlock(&rx->mutex);
   return FALSE;
@@ -220,10 +237,12 @@ static gboolean rx_panadapter_configure_event_cb(GtkWidget *widget,GdkEventConfi
 
 static gboolean rx_panadapter_draw_cb(GtkWidget *widget,cairo_t *cr,gpointer data) {
   RECEIVER *rx=(RECEIVER *)data;
+  g_mutex_lock(&rx->surface_mutex);
   if(rx->panadapter_surface!=NULL) {
     cairo_set_source_surface (cr, rx->panadapter_surface, 0.0, 0.0);
     cairo_paint (cr);
   }
+  g_mutex_unlock(&rx->surface_mutex);
   return TRUE;
 }
 
@@ -233,6 +252,8 @@ GtkWidget *create_rx_panadapter(RECEIVER *rx) {
   rx->panadapter_width=0;
   rx->panadapter_height=0;
   rx->panadapter_surface=NULL;
+  rx->panadapter_back=NULL;
+  rx->panadapter_static=NULL;
   rx->panadapter_resize_timer=-1;
 
   panadapter=NULL;
@@ -273,22 +294,350 @@ GtkWidget *create_rx_panadapter(RECEIVER *rx) {
   return panadapter;
 }
 
-static gboolean first_time=TRUE;
+// Everything except the signal trace only changes when the receiver is
+// tuned, zoomed, panned, resized or its levels are changed, so it is drawn
+// into rx->panadapter_static and that layer is reused until its key differs.
+static void panadapter_layer_key(RECEIVER *rx,const RENDER_VIEW *view,PANADAPTER_LAYER_KEY *key,int display_width,int display_height,double attenuation,double dbm_per_line) {
+  // zero the padding too, the keys are compared with memcmp
+  memset(key,0,sizeof(PANADAPTER_LAYER_KEY));
+  key->width=display_width;
+  key->height=display_height;
+  key->surface_width=rx->panadapter_width;
+  key->surface_height=rx->panadapter_height;
+  key->frequency_a=view->frequency_a;
+  key->frequency_b=view->frequency_b;
+  key->ctun_offset=view->ctun_offset;
+  key->sample_rate=view->sample_rate;
+  key->pixels=view->pixels;
+  key->zoom=view->zoom;
+  key->pan=view->pan;
+  key->hz_per_pixel=view->hz_per_pixel;
+  key->band=view->band_a;
+  key->mode=view->mode_a;
+  key->split=view->split;
+  key->subrx_enable=view->subrx_enable;
+  key->filter_low_a=view->filter_low_a;
+  key->filter_high_a=view->filter_high_a;
+  key->filter_low_b=view->filter_low_b;
+  key->filter_high_b=view->filter_high_b;
+  key->sidetone=radio->cw_keyer_sidetone_frequency;
+  key->low=view->panadapter_low;
+  key->high=view->panadapter_high;
+  key->step=view->panadapter_step;
+  key->gradient=view->panadapter_gradient;
+  key->agc=view->agc;
+  if(view->agc!=AGC_OFF && view->panadapter_agc_line) {
+    double hang=0.0;
+    double thresh=0.0;
+
+    GetRXAAGCHangLevel(rx->channel, &hang);
+    GetRXAAGCThresh(rx->channel, &thresh, 4096.0, (double)view->sample_rate);
+    key->knee_y=(gint)floor((view->panadapter_high - (thresh+attenuation+radio->panadapter_calibration))*dbm_per_line);
+    key->hang_y=(gint)floor((view->panadapter_high - (hang+attenuation+radio->panadapter_calibration))*dbm_per_line);
+  }
+}
 
-void update_rx_panadapter(RECEIVER *rx) {
+static void draw_panadapter_layer(RECEIVER *rx,const RENDER_VIEW *view,const PANADAPTER_LAYER_KEY *key,double dbm_per_line) {
   int i;
   int x1,x2;
-  float *samples;
   cairo_text_extents_t extents;
   char temp[32];
+  int display_width=key->width;
+  int display_height=key->height;
+  int offset=view->pan;
+
+  cairo_t *cr;
+  cr = cairo_create (rx->panadapter_static);
+  cairo_select_font_face(cr, "Noto Sans", CAIRO_FONT_SLANT_NORMAL,CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_set_font_size(cr, 12);
+  cairo_set_line_width(cr, 1.0);
+
+  if(view->panadapter_gradient) {
+    // Set fill      
+ 
+    //cairo_pattern_t *pat=cairo_pattern_create_linear(127/255, 127/255, 127/255,rx->panadapter_height);
+    
+    
+    cairo_pattern_t *pat = cairo_pattern_create_radial((rx->panadapter_width / 2),
+                           rx->panadapter_height + 300,
+                           5,
+                           (rx->panadapter_width / 2),
+                           rx->panadapter_height + 300,
+                           rx->panadapter_width/2);
+    
+    cairo_pattern_add_color_stop_rgba(pat, 1, 0.1, 0.1, 0.1, 1);
+    cairo_pattern_add_color_stop_rgba(pat, 0, 0.25, 0.25, 0.25, 1);      
+    
+    /*
+    cairo_pattern_t *pat=cairo_pattern_create_linear((136/255), (136/255), (136/255), rx->panadapter_height);
+    cairo_pattern_add_color_stop_rgba(pat,1.0, (48/255), (48/255), (48/255), 0.5);
+    cairo_pattern_add_color_stop_rgba(pat,0.0, (80/255), (80/255), (80/255), 0.5);      
+    */
+    
+    cairo_rectangle(cr, 0,0,rx->panadapter_width,rx->panadapter_height);
+    cairo_set_source (cr, pat);
+    cairo_fill(cr);
+    cairo_pattern_destroy(pat);
+  } else {
+    cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+    //cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+    cairo_rectangle(cr,0,0,display_width,display_height);
+    cairo_fill(cr);
+  }
+
+
+  long long frequency=view->frequency_a;
+  long long half=(long long)view->sample_rate/2LL;
+  long long min_display=frequency-(half/(long long)view->zoom);
+  long long max_display=frequency+(half/(long long)view->zoom);
+  BAND *band=band_get_band(view->band_a);
+
+  if(view->band_a==band60) {
+    for(i=0;i<channel_entries;i++) {
+      long long low_freq=band_channels_60m[i].frequency-(band_channels_60m[i].width/(long long)2);
+      long long hi_freq=band_channels_60m[i].frequency+(band_channels_60m[i].width/(long long)2);
+      x1=(low_freq-min_display)/(long long)view->hz_per_pixel;
+      x2=(hi_freq-min_display)/(long long)view->hz_per_pixel;
+      cairo_set_source_rgb (cr, 0.6, 0.3, 0.3);
+      cairo_rectangle(cr, x1, 0.0, x2-x1, (double)display_height);
+      cairo_fill(cr);
+    }
+  }
+
+  // filter
+  cairo_set_source_rgba (cr, 0.5, 0.5, 0.5, 0.75);
+  double filter_left=((double)view->pixels/2.0)-(double)view->pan+(((double)view->filter_low_a+view->ctun_offset)/view->hz_per_pixel);
+  double filter_right=((double)view->pixels/2.0)-(double)view->pan+(((double)view->filter_high_a+view->ctun_offset)/view->hz_per_pixel);
+  cairo_rectangle(cr, filter_left, 0.0, filter_right-filter_left, (double)display_height);
+  cairo_fill(cr);
+
+  // draw cursor for cw mode
+  if(view->mode_a==CWU || view->mode_a==CWL) {
+    SetColour(cr, TEXT_B);
+    double cw_frequency=filter_left+((filter_right-filter_left)/2.0);
+    cairo_move_to(cr,cw_frequency,10.0);
+    cairo_line_to(cr,cw_frequency,(double)display_height-20);
+    cairo_stroke(cr);
+  } else {
+    SetColour(cr, TEXT_A);
+    cairo_move_to(cr,(double)(view->pixels/2.0)-(double)view->pan+(view->ctun_offset/view->hz_per_pixel),0.0);
+    cairo_line_to(cr,(double)(view->pixels/2.0)-(double)view->pan+(view->ctun_offset/view->hz_per_pixel),(double)display_height-20);
+    cairo_stroke(cr);
+  }
+
+  
+  // Show VFO B (tx) for split mode or if subrx enabled
+  if(view->split==SPLIT_ON || view->subrx_enable) {    
+    double diff = (double)(view->frequency_b - view->frequency_a)/view->hz_per_pixel;       
+    if(view->mode_a==CWU || view->mode_a==CWL) {
+      SetColour(cr, WARNING);
+      double cw_frequency=filter_left+((filter_right-filter_left)/2.0);
+      cairo_move_to(cr, cw_frequency + diff,10.0);
+      cairo_line_to(cr, cw_frequency + diff,(double)display_height-20);
+      cairo_stroke(cr);
+    } else if(view->subrx_enable) {
+      // VFO B cursor
+      SetColour(cr, WARNING);
+      cairo_move_to(cr,(double)(view->pixels/2.0)-(double)view->pan+diff,10.0);
+      cairo_line_to(cr,(double)(view->pixels/2.0)-(double)view->pan+diff,(double)display_height-20);
+      cairo_stroke(cr);
+
+      cairo_set_source_rgba (cr, 0.7, 0.7, 0.7, 0.75);
+      double filter_left=((double)view->pixels/2.0)-(double)view->pan+(((double)view->filter_low_b)/view->hz_per_pixel)+diff;
+      double filter_right=((double)view->pixels/2.0)-(double)view->pan+(((double)view->filter_high_b)/view->hz_per_pixel)+diff;
+      cairo_rectangle(cr, filter_left, 10.0, filter_right-filter_left, (double)display_height-20);
+      cairo_fill(cr);
+    }
+  }
+  
+  cairo_set_line_width (cr, 1);
+  // plot the levels
+  
+  cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+  //cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+  cairo_rectangle(cr,0,0,40,display_height);
+  cairo_fill(cr);    
+  
+  cairo_set_dash(cr, dashed2, len2, 0);
+  for(i=view->panadapter_high;i>=view->panadapter_low;i--) {
+    SetColour(cr, DARK_LINES);
+    int mod=abs(i)%view->panadapter_step;
+    if(mod==0) {
+      double y = (double)(view->panadapter_high-i)*dbm_per_line;
+      cairo_move_to(cr,0.0,y);
+      cairo_line_to(cr,(double)display_width,y);
+      if(view->panadapter_gradient) SetColour(cr, TEXT_B);
+      sprintf(temp," %d",i);
+      cairo_move_to(cr, 5, y-1);  
+      cairo_show_text(cr, temp);
+    }
+  }
+  cairo_stroke(cr);
+
+
+
+  // plot frequency markers
+  
+  cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
+  cairo_rectangle(cr,0, (rx->panadapter_height-20), display_width, (rx->panadapter_height));
+  cairo_fill(cr);        
+
+  // if zoom > 1 - show the pan position
+  if(view->zoom!=1) {
+    int pan_x=(int)((double)view->pan/(double)view->zoom);
+    int pan_width=(int)((double)rx->panadapter_width/(double)view->zoom);
+    cairo_set_source_rgb (cr, 0.7, 0.7, 0.7);
+    cairo_rectangle(cr,pan_x, (rx->panadapter_height-4), pan_width, (rx->panadapter_height));
+    cairo_fill(cr);        
+  }
+
+  long long f1;
+  long long f2;
+  long long divisor1=20000;
+  long long divisor2=5000;
+  long long factor=(long long)(view->sample_rate/48000);
+  if(factor>10LL) factor=10LL;
+  switch(view->zoom) {
+    case 1:
+    case 2:
+    case 3:
+      divisor1=5000LL*factor;
+      divisor2=1000LL*factor;
+      break;
+    case 4:
+    case 5:
+    case 6:
+      divisor1=1000LL*factor;
+      divisor2=500LL*factor;
+      break;
+    case 7:
+    case 8:
+      divisor1=1000LL*factor;
+      divisor2=200LL*factor;
+      break;
+  }
+  cairo_set_line_width(cr, 1.0);
+
+  f1=frequency-half+(long long)(view->hz_per_pixel*offset);
+  if (view->mode_a==CWU) {
+    f1 -= radio->cw_keyer_sidetone_frequency;
+  }
+  else if (view->mode_a==CWL) {
+    f1 += radio->cw_keyer_sidetone_frequency;
+  }    
+  f2=(f1/divisor2)*divisor2;
+
+  int x=0;
+  do {
+    x=(int)(f2-f1)/view->hz_per_pixel;
+    if(x>70) {
+      if((f2%divisor1)==0LL) {
+        SetColour(cr, DARK_LINES);
+        cairo_set_dash(cr, 0, 0, 0);
+        cairo_move_to(cr,(double)x,0);
+        cairo_line_to(cr,(double)x,(double)display_height-20);
+        SetColour(cr, TEXT_B);
+        cairo_line_to(cr,(double)x,(double)display_height);
+        cairo_stroke(cr);
+        SetColour(cr, TEXT_B);
+        cairo_select_font_face(cr, "Noto Sans",
+                            CAIRO_FONT_SLANT_NORMAL,
+                            CAIRO_FONT_WEIGHT_NORMAL);
+        cairo_set_font_size(cr, 12);
+        sprintf(temp,"%0lld.%03lld",f2/1000000,(f2%1000000)/1000);
+        cairo_text_extents(cr, temp, &extents);
+        cairo_move_to(cr, (double)x-(extents.width/2.0), (rx->panadapter_height - 6));
+        cairo_show_text(cr, temp);
+      } else if((f2%divisor2)==00LL) {
+        SetColour(cr, DARK_LINES);
+        cairo_set_dash(cr, dashed2, len2, 0);
+        cairo_move_to(cr,(double)x,0);
+        cairo_line_to(cr,(double)x,(double)display_height-20);
+        cairo_stroke(cr);
+      }
+    }
+    f2=f2+divisor2;
+  } while(x<display_width);
+  
+
+
+  if(view->band_a!=band60) {
+    // band edges
+    if(band->frequencyMin!=0LL) {
+      SetColour(cr, WARNING);
+      cairo_set_line_width(cr, 2.0);
+      if((min_display<band->frequencyMin)&&(max_display>band->frequencyMin)) {
+        i=(int)(((double)band->frequencyMin-(double)min_display)/view->hz_per_pixel);
+        cairo_move_to(cr,(double)i,0.0);
+        cairo_line_to(cr,(double)i,(double)display_height-20);
+        cairo_stroke(cr);
+      }
+      if((min_display<band->frequencyMax)&&(max_display>band->frequencyMax)) {
+        i=(int)(((double)band->frequencyMax-(double)min_display)/view->hz_per_pixel);
+        cairo_move_to(cr,(double)i,0.0);
+        cairo_line_to(cr,(double)i,(double)display_height-20);
+        cairo_stroke(cr);
+      }
+      cairo_set_line_width(cr, 1.0);
+    }
+  }
+  
+  cairo_set_dash(cr, 0, 0, 0);
+  // agc
+  if(key->agc!=AGC_OFF) {
+    double x=80.0;
+
+    if(view->panadapter_agc_line) {
+      double knee_y=(double)key->knee_y;
+      double hang_y=(double)key->hang_y;
+
+      if(view->agc!=AGC_MEDIUM && view->agc!=AGC_FAST) {
+        SetColour(cr, TEXT_A);
+        cairo_move_to(cr,x,hang_y-8.0);
+        cairo_rectangle(cr, x, hang_y-8.0,8.0,8.0);
+        cairo_fill(cr);
+        cairo_move_to(cr,x,hang_y);
+        cairo_line_to(cr,(double)display_width-x,hang_y);
+        cairo_stroke(cr);
+        cairo_move_to(cr,x+8.0,hang_y);
+        cairo_show_text(cr, "-H");
+      }
+
+      SetColour(cr, TEXT_C);
+      cairo_move_to(cr,x,knee_y-8.0);
+      cairo_rectangle(cr, x, knee_y-8.0,8.0,8.0);
+      cairo_fill(cr);
+      cairo_move_to(cr,x,knee_y);
+      cairo_line_to(cr,(double)display_width-x,knee_y);
+      cairo_stroke(cr);
+      cairo_move_to(cr,x+8.0,knee_y);
+      cairo_show_text(cr, "-G");      
+    }
+  }
+
+  cairo_destroy (cr);
+}
+
+static gboolean first_time=TRUE;
+
+void update_rx_panadapter(RECEIVER *rx,const RENDER_VIEW *view) {
+  int i;
+  float *samples;
 
-  int display_width=gtk_widget_get_allocated_width (rx->panadapter);
-  int display_height=gtk_widget_get_allocated_height (rx->panadapter);
-  //int offset=((rx->zoom-1)/2)*display_width;
-  int offset=rx->pan;
+  int display_width;
+  int display_height;
+  if(rx->render!=NULL) {
+    // on the render worker, which must not ask GTK for the allocation
+    display_width=rx->panadapter_width;
+    display_height=rx->panadapter_height;
+  } else {
+    display_width=gtk_widget_get_allocated_width (rx->panadapter);
+    display_height=gtk_widget_get_allocated_height (rx->panadapter);
+  }
+  //int offset=((view->zoom-1)/2)*display_width;
+  int offset=view->pan;
   samples=rx->pixel_samples;
-  samples[display_width-1+offset]=-200;
-  double dbm_per_line=(double)display_height/((double)rx->panadapter_high-(double)rx->panadapter_low);
+  double dbm_per_line=(double)display_height/((double)view->panadapter_high-(double)view->panadapter_low);
   double attenuation=radio->adc[rx->adc].attenuation;
   
   
@@ -300,6 +649,7 @@ void update_rx_panadapter(RECEIVER *rx) {
   if(display_height<=1) return;
 
   if(opengl) {
+    samples[display_width-1+offset]=-200;
     if(signal_vertices_size!=display_width) {
       if(signal_vertices!=NULL) {
         g_free(signal_vertices);
@@ -308,7 +658,7 @@ void update_rx_panadapter(RECEIVER *rx) {
       signal_vertices_size=display_width;
     }
     float h_half=(float)display_width/2.0;
-    float v_half=(float)rx->panadapter_low+(((float)rx->panadapter_high-(float)rx->panadapter_low)/2.0);
+    float v_half=(float)view->panadapter_low+(((float)view->panadapter_high-(float)view->panadapter_low)/2.0);
     for(i=0;i<display_width;i++) {
       float x=((float)i-h_half)/h_half;
       double s2=(double)samples[i+offset]+attenuation+radio->panadapter_calibration;
@@ -325,323 +675,116 @@ void update_rx_panadapter(RECEIVER *rx) {
     gtk_widget_queue_draw (rx->panadapter);
   } else {
 
-    if(rx->panadapter_surface==NULL) {
+    if(rx->panadapter_back==NULL) {
       return;
     }
 
-    //clear_panadater_surface();
-    cairo_t *cr;
-    cr = cairo_create (rx->panadapter_surface);
-    cairo_select_font_face(cr, "Noto Sans", CAIRO_FONT_SLANT_NORMAL,CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_font_size(cr, 12);
-    cairo_set_line_width(cr, 1.0);
+    PANADAPTER_LAYER_KEY key;
+    panadapter_layer_key(rx,view,&key,display_width,display_height,attenuation,dbm_per_line);
 
-    if(rx->panadapter_gradient) {
-      // Set fill      
- 
-      //cairo_pattern_t *pat=cairo_pattern_create_linear(127/255, 127/255, 127/255,rx->panadapter_height);
-      
-      
-      cairo_pattern_t *pat = cairo_pattern_create_radial((rx->panadapter_width / 2),
-                             rx->panadapter_height + 300,
-                             5,
-                             (rx->panadapter_width / 2),
-                             rx->panadapter_height + 300,
-                             rx->panadapter_width/2);
-      
-      cairo_pattern_add_color_stop_rgba(pat, 1, 0.1, 0.1, 0.1, 1);
-      cairo_pattern_add_color_stop_rgba(pat, 0, 0.25, 0.25, 0.25, 1);      
-      
-      /*
-      cairo_pattern_t *pat=cairo_pattern_create_linear((136/255), (136/255), (136/255), rx->panadapter_height);
-      cairo_pattern_add_color_stop_rgba(pat,1.0, (48/255), (48/255), (48/255), 0.5);
-      cairo_pattern_add_color_stop_rgba(pat,0.0, (80/255), (80/255), (80/255), 0.5);      
-      */
-      
-      cairo_rectangle(cr, 0,0,rx->panadapter_width,rx->panadapter_height);
-      cairo_set_source (cr, pat);
-      cairo_fill(cr);
-      cairo_pattern_destroy(pat);
-    } else {
-      cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
-      //cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
-      cairo_rectangle(cr,0,0,display_width,display_height);
-      cairo_fill(cr);
+    if(rx->panadapter_static!=NULL && (key.width!=rx->panadapter_static_key.width || key.height!=rx->panadapter_static_key.height)) {
+      cairo_surface_destroy(rx->panadapter_static);
+      rx->panadapter_static=NULL;
     }
-
-
-    long long frequency=rx->frequency_a;
-    long long half=(long long)rx->sample_rate/2LL;
-    long long min_display=frequency-(half/(long long)rx->zoom);
-    long long max_display=frequency+(half/(long long)rx->zoom);
-    BAND *band=band_get_band(rx->band_a);
-
-    if(rx->band_a==band60) {
-      for(i=0;i<channel_entries;i++) {
-        long long low_freq=band_channels_60m[i].frequency-(band_channels_60m[i].width/(long long)2);
-        long long hi_freq=band_channels_60m[i].frequency+(band_channels_60m[i].width/(long long)2);
-        x1=(low_freq-min_display)/(long long)rx->hz_per_pixel;
-        x2=(hi_freq-min_display)/(long long)rx->hz_per_pixel;
-        cairo_set_source_rgb (cr, 0.6, 0.3, 0.3);
-        cairo_rectangle(cr, x1, 0.0, x2-x1, (double)display_height);
-        cairo_fill(cr);
-      }
-    }
-
-    // filter
-    cairo_set_source_rgba (cr, 0.5, 0.5, 0.5, 0.75);
-    double filter_left=((double)rx->pixels/2.0)-(double)rx->pan+(((double)rx->filter_low_a+rx->ctun_offset)/rx->hz_per_pixel);
-    double filter_right=((double)rx->pixels/2.0)-(double)rx->pan+(((double)rx->filter_high_a+rx->ctun_offset)/rx->hz_per_pixel);
-    cairo_rectangle(cr, filter_left, 0.0, filter_right-filter_left, (double)display_height);
-    cairo_fill(cr);
-
-    // draw cursor for cw mode
-    if(rx->mode_a==CWU || rx->mode_a==CWL) {
-      SetColour(cr, TEXT_B);
-      double cw_frequency=filter_left+((filter_right-filter_left)/2.0);
-      cairo_move_to(cr,cw_frequency,10.0);
-      cairo_line_to(cr,cw_frequency,(double)display_height-20);
-      cairo_stroke(cr);
-    } else {
-      SetColour(cr, TEXT_A);
-      cairo_move_to(cr,(double)(rx->pixels/2.0)-(double)rx->pan+(rx->ctun_offset/rx->hz_per_pixel),0.0);
-      cairo_line_to(cr,(double)(rx->pixels/2.0)-(double)rx->pan+(rx->ctun_offset/rx->hz_per_pixel),(double)display_height-20);
-      cairo_stroke(cr);
-    }
-
-    
-    // Show VFO B (tx) for split mode or if subrx enabled
-    if(rx->split==SPLIT_ON || rx->subrx_enable) {    
-      double diff = (double)(rx->frequency_b - rx->frequency_a)/rx->hz_per_pixel;       
-      if(rx->mode_a==CWU || rx->mode_a==CWL) {
-        SetColour(cr, WARNING);
-        double cw_frequency=filter_left+((filter_right-filter_left)/2.0);
-        cairo_move_to(cr, cw_frequency + diff,10.0);
-        cairo_line_to(cr, cw_frequency + diff,(double)display_height-20);
-        cairo_stroke(cr);
-      } else if(rx->subrx_enable) {
-        // VFO B cursor
-        SetColour(cr, WARNING);
-        cairo_move_to(cr,(double)(rx->pixels/2.0)-(double)rx->pan+diff,10.0);
-        cairo_line_to(cr,(double)(rx->pixels/2.0)-(double)rx->pan+diff,(double)display_height-20);
-        cairo_stroke(cr);
-
-        cairo_set_source_rgba (cr, 0.7, 0.7, 0.7, 0.75);
-        double filter_left=((double)rx->pixels/2.0)-(double)rx->pan+(((double)rx->filter_low_b)/rx->hz_per_pixel)+diff;
-        double filter_right=((double)rx->pixels/2.0)-(double)rx->pan+(((double)rx->filter_high_b)/rx->hz_per_pixel)+diff;
-        cairo_rectangle(cr, filter_left, 10.0, filter_right-filter_left, (double)display_height-20);
-        cairo_fill(cr);
-      }
-    }
-    
-    cairo_set_line_width (cr, 1);
-    // plot the levels
-    
-    cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
-    //cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
-    cairo_rectangle(cr,0,0,40,display_height);
-    cairo_fill(cr);    
-    
-    cairo_set_dash(cr, dashed2, len2, 0);
-    for(i=rx->panadapter_high;i>=rx->panadapter_low;i--) {
-      SetColour(cr, DARK_LINES);
-      int mod=abs(i)%rx->panadapter_step;
-      if(mod==0) {
-        double y = (double)(rx->panadapter_high-i)*dbm_per_line;
-        cairo_move_to(cr,0.0,y);
-        cairo_line_to(cr,(double)display_width,y);
-        if(rx->panadapter_gradient) SetColour(cr, TEXT_B);
-        sprintf(temp," %d",i);
-        cairo_move_to(cr, 5, y-1);  
-        cairo_show_text(cr, temp);
-      }
-    }
-    cairo_stroke(cr);
-
-
-
-    // plot frequency markers
-    
-    cairo_set_source_rgb (cr, 0.1, 0.1, 0.1);
-    cairo_rectangle(cr,0, (rx->panadapter_height-20), display_width, (rx->panadapter_height));
-    cairo_fill(cr);        
-
-    // if zoom > 1 - show the pan position
-    if(rx->zoom!=1) {
-      int pan_x=(int)((double)rx->pan/(double)rx->zoom);
-      int pan_width=(int)((double)rx->panadapter_width/(double)rx->zoom);
-      cairo_set_source_rgb (cr, 0.7, 0.7, 0.7);
-      cairo_rectangle(cr,pan_x, (rx->panadapter_height-4), pan_width, (rx->panadapter_height));
-      cairo_fill(cr);        
+    if(rx->panadapter_static==NULL) {
+      rx->panadapter_static=cairo_surface_create_similar(rx->panadapter_back,
+                                       CAIRO_CONTENT_COLOR,
+                                       display_width,
+                                       display_height);
+      draw_panadapter_layer(rx,view,&key,dbm_per_line);
+      rx->panadapter_static_key=key;
+    } else if(memcmp(&key,&rx->panadapter_static_key,sizeof(PANADAPTER_LAYER_KEY))!=0) {
+      draw_panadapter_layer(rx,view,&key,dbm_per_line);
+      rx->panadapter_static_key=key;
     }
 
-    long long f1;
-    long long f2;
-    long long divisor1=20000;
-    long long divisor2=5000;
-    long long factor=(long long)(rx->sample_rate/48000);
-    if(factor>10LL) factor=10LL;
-    switch(rx->zoom) {
-      case 1:
-      case 2:
-      case 3:
-        divisor1=5000LL*factor;
-        divisor2=1000LL*factor;
-        break;
-      case 4:
-      case 5:
-      case 6:
-        divisor1=1000LL*factor;
-        divisor2=500LL*factor;
-        break;
-      case 7:
-      case 8:
-        divisor1=1000LL*factor;
-        divisor2=200LL*factor;
-        break;
-    }
+    cairo_t *cr;
+    cr = cairo_create (rx->panadapter_back);
+    cairo_set_source_surface (cr, rx->panadapter_static, 0.0, 0.0);
+    cairo_paint (cr);
     cairo_set_line_width(cr, 1.0);
 
-    f1=frequency-half+(long long)(rx->hz_per_pixel*offset);
-    if (rx->mode_a==CWU) {
-      f1 -= radio->cw_keyer_sidetone_frequency;
+    // reduce the visible span to one min/max/avg per column so the trace
+    // is display_width vertices whatever the zoom or analyzer size, with the
+    // peak envelope on there are pixel_oversample values per pixel
+    int oversample=view->pixel_oversample;
+    int span=rx->panadapter_width;
+    if(span>view->pixels-offset) span=view->pixels-offset;
+    span*=oversample;
+    if(rx->trace_columns!=display_width) {
+      g_free(rx->trace_min);
+      rx->trace_min=g_new0(gfloat,display_width*3);
+      rx->trace_max=rx->trace_min+display_width;
+      rx->trace_avg=rx->trace_max+display_width;
+      rx->trace_columns=display_width;
     }
-    else if (rx->mode_a==CWL) {
-      f1 += radio->cw_keyer_sidetone_frequency;
-    }    
-    f2=(f1/divisor2)*divisor2;
-
-    int x=0;
-    do {
-      x=(int)(f2-f1)/rx->hz_per_pixel;
-      if(x>70) {
-        if((f2%divisor1)==0LL) {
-          SetColour(cr, DARK_LINES);
-          cairo_set_dash(cr, 0, 0, 0);
-          cairo_move_to(cr,(double)x,0);
-          cairo_line_to(cr,(double)x,(double)display_height-20);
-          SetColour(cr, TEXT_B);
-          cairo_line_to(cr,(double)x,(double)display_height);
-          cairo_stroke(cr);
-          SetColour(cr, TEXT_B);
-          cairo_select_font_face(cr, "Noto Sans",
-                              CAIRO_FONT_SLANT_NORMAL,
-                              CAIRO_FONT_WEIGHT_NORMAL);
-          cairo_set_font_size(cr, 12);
-          sprintf(temp,"%0lld.%03lld",f2/1000000,(f2%1000000)/1000);
-          cairo_text_extents(cr, temp, &extents);
-          cairo_move_to(cr, (double)x-(extents.width/2.0), (rx->panadapter_height - 6));
-          cairo_show_text(cr, temp);
-        } else if((f2%divisor2)==00LL) {
-          SetColour(cr, DARK_LINES);
-          cairo_set_dash(cr, dashed2, len2, 0);
-          cairo_move_to(cr,(double)x,0);
-          cairo_line_to(cr,(double)x,(double)display_height-20);
-          cairo_stroke(cr);
-        }
-      }
-      f2=f2+divisor2;
-    } while(x<display_width);
-    
 
+    // nothing to draw while pan is outside the analyzer span
+    if(span>0) {
+      trace_decimate(&samples[offset*oversample],span,display_width,rx->trace_min,rx->trace_max,rx->trace_avg);
 
-    if(rx->band_a!=band60) {
-      // band edges
-      if(band->frequencyMin!=0LL) {
-        SetColour(cr, WARNING);
-        cairo_set_line_width(cr, 2.0);
-        if((min_display<band->frequencyMin)&&(max_display>band->frequencyMin)) {
-          i=(int)(((double)band->frequencyMin-(double)min_display)/rx->hz_per_pixel);
-          cairo_move_to(cr,(double)i,0.0);
-          cairo_line_to(cr,(double)i,(double)display_height-20);
-          cairo_stroke(cr);
-        }
-        if((min_display<band->frequencyMax)&&(max_display>band->frequencyMax)) {
-          i=(int)(((double)band->frequencyMax-(double)min_display)/rx->hz_per_pixel);
-          cairo_move_to(cr,(double)i,0.0);
-          cairo_line_to(cr,(double)i,(double)display_height-20);
-          cairo_stroke(cr);
+      // signal
+      double s2;
+
+      if(view->panadapter_peaks) {
+        s2=(double)rx->trace_max[0]+attenuation+radio->panadapter_calibration;
+        s2 = floor((view->panadapter_high - s2) *dbm_per_line);
+        if (s2 >= rx->panadapter_height-20) {
+          s2 = rx->panadapter_height-20;
         }
-        cairo_set_line_width(cr, 1.0);
-      }
-    }
-    
-    cairo_set_dash(cr, 0, 0, 0);
-    // agc
-    if(rx->agc!=AGC_OFF) {
-      double hang=0.0;
-      double thresh=0.0;
-      double x=80.0;
-
-      GetRXAAGCHangLevel(rx->channel, &hang);
-      GetRXAAGCThresh(rx->channel, &thresh, 4096.0, (double)rx->sample_rate);
-    
-      if(rx->panadapter_agc_line) {
-        double knee_y=thresh+attenuation+radio->panadapter_calibration;      
-        knee_y = floor((rx->panadapter_high - knee_y)*dbm_per_line);
-  
-        double hang_y=hang+attenuation+radio->panadapter_calibration;    
-        hang_y = floor((rx->panadapter_high - hang_y)*dbm_per_line);
-  
-        if(rx->agc!=AGC_MEDIUM && rx->agc!=AGC_FAST) {
-          SetColour(cr, TEXT_A);
-          cairo_move_to(cr,x,hang_y-8.0);
-          cairo_rectangle(cr, x, hang_y-8.0,8.0,8.0);
-          cairo_fill(cr);
-          cairo_move_to(cr,x,hang_y);
-          cairo_line_to(cr,(double)display_width-x,hang_y);
-          cairo_stroke(cr);
-          cairo_move_to(cr,x+8.0,hang_y);
-          cairo_show_text(cr, "-H");
+        cairo_move_to(cr, 0.0, s2);
+        for(i=1;i<display_width;i++) {
+          s2=(double)rx->trace_max[i]+attenuation+radio->panadapter_calibration;
+          s2 = floor((view->panadapter_high - s2) *dbm_per_line);
+          if (s2 >= rx->panadapter_height-20) {
+            s2 = rx->panadapter_height-20;
+          }
+          cairo_line_to(cr, (double)i, s2);
         }
-  
-        SetColour(cr, TEXT_C);
-        cairo_move_to(cr,x,knee_y-8.0);
-        cairo_rectangle(cr, x, knee_y-8.0,8.0,8.0);
-        cairo_fill(cr);
-        cairo_move_to(cr,x,knee_y);
-        cairo_line_to(cr,(double)display_width-x,knee_y);
+        cairo_set_source_rgba(cr, 0.804,	0.635,	0.859, 0.5);
         cairo_stroke(cr);
-        cairo_move_to(cr,x+8.0,knee_y);
-        cairo_show_text(cr, "-G");      
       }
-    }
 
-    // signal
-    double s2;
+      rx->trace_avg[display_width-1]=-200;
     
-    samples[display_width-1+offset]=-200;
-    
-    cairo_move_to(cr, 0.0, display_height-20);
+      cairo_move_to(cr, 0.0, display_height-20);
 
-    for(i=1;i<display_width;i++) {
-      s2=(double)samples[i+offset]+attenuation+radio->panadapter_calibration;
-      s2 = floor((rx->panadapter_high - s2) *dbm_per_line);
-      if (s2 >= rx->panadapter_height-20) {
-        s2 = rx->panadapter_height-20;
+      for(i=1;i<display_width;i++) {
+        s2=(double)rx->trace_avg[i]+attenuation+radio->panadapter_calibration;
+        s2 = floor((view->panadapter_high - s2) *dbm_per_line);
+        if (s2 >= rx->panadapter_height-20) {
+          s2 = rx->panadapter_height-20;
+        }
+        cairo_line_to(cr, (double)i, s2);
       }
-      cairo_line_to(cr, (double)i, s2);
-    }
   
 
       
-    if(rx->panadapter_filled) {
-      cairo_close_path (cr);
-      cairo_pattern_t *pat=cairo_pattern_create_linear(0.624,	0.427,	0.690,(rx->panadapter_height-20));     
-      cairo_pattern_add_color_stop_rgba(pat,0.0,0.804,	0.635,	0.859,0.5);
-      cairo_pattern_add_color_stop_rgba(pat,1.0,0.804,	0.635,	0.859,0.5);
-      cairo_set_source (cr, pat);
-      cairo_fill_preserve(cr);
-      cairo_pattern_destroy(pat);
+      if(view->panadapter_filled) {
+        cairo_close_path (cr);
+        cairo_pattern_t *pat=cairo_pattern_create_linear(0.624,	0.427,	0.690,(rx->panadapter_height-20));     
+        cairo_pattern_add_color_stop_rgba(pat,0.0,0.804,	0.635,	0.859,0.5);
+        cairo_pattern_add_color_stop_rgba(pat,1.0,0.804,	0.635,	0.859,0.5);
+        cairo_set_source (cr, pat);
+        cairo_fill_preserve(cr);
+        cairo_pattern_destroy(pat);
+      }
+      cairo_set_source_rgb(cr, 0.804,	0.635,	0.859);
+      cairo_stroke(cr);
     }
-    cairo_set_source_rgb(cr, 0.804,	0.635,	0.859);
-    cairo_stroke(cr);
 
     //SetColour(cr, BACKGROUND);
     //cairo_rectangle(cr,0,(rx->panadapter_height - 18),display_width,18);
     //cairo_fill(cr);
 
     cairo_destroy (cr);
-    gtk_widget_queue_draw (rx->panadapter);
+
+    // hand the finished frame to the draw callback
+    cairo_surface_flush (rx->panadapter_back);
+    g_mutex_lock(&rx->surface_mutex);
+    cairo_surface_t *surface=rx->panadapter_surface;
+    rx->panadapter_surface=rx->panadapter_back;
+    rx->panadapter_back=surface;
+    g_mutex_unlock(&rx->surface_mutex);
   }
 }
@@ -0,0 +1,83 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+#include <string.h>
+
+#include "sequence.h"
+
+void sequence_reset(SEQUENCE_STATS *s) {
+  memset(s,0,sizeof(SEQUENCE_STATS));
+}
+
+static void sequence_restart(SEQUENCE_STATS *s,guint32 sequence) {
+  s->next=sequence+1;
+  // anything before the restart is treated as already seen
+  s->history=~(guint64)0;
+}
+
+//
+// account for a received packet
+// returns the number of packets lost immediately before this one (0 if
+// it follows on) or -1 if it is a duplicate or arrived after the packets
+// that follow it and should be dropped
+//
+gint sequence_check(SEQUENCE_STATS *s,guint32 sequence) {
+  gint32 diff;
+  gint age;
+
+  s->packets++;
+  if(!s->started) {
+    s->started=TRUE;
+    sequence_restart(s,sequence);
+    return 0;
+  }
+
+  diff=(gint32)(sequence-s->next);
+  if(diff>=0) {
+    if(diff>SEQUENCE_MAX_GAP) {
+      s->restarts++;
+      sequence_restart(s,sequence);
+      return 0;
+    }
+    s->lost+=diff;
+    s->history=(diff+1>=SEQUENCE_WINDOW)?1:((s->history<<(diff+1))|1);
+    s->next=sequence+1;
+    return diff;
+  }
+
+  age=-diff-1;
+  if(age>SEQUENCE_MAX_GAP) {
+    s->restarts++;
+    sequence_restart(s,sequence);
+    return 0;
+  }
+  if(age<SEQUENCE_WINDOW && (s->history&((guint64)1<<age))) {
+    s->duplicates++;
+    return -1;
+  }
+  // it was counted as lost when the gap was seen
+  if(age<SEQUENCE_WINDOW) {
+    s->history|=(guint64)1<<age;
+    s->lost--;
+  }
+  s->reordered++;
+  return -1;
+}
@@ -0,0 +1,51 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+// how far back duplicates and late packets are recognised
+#define SEQUENCE_WINDOW 64
+// a bigger jump than this is taken as the radio restarting the stream
+#define SEQUENCE_MAX_GAP 4096
+// never conceal more than this many lost packets in one go
+#define SEQUENCE_MAX_CONCEAL 32
+
+//
+// per stream sequence number tracking
+// history has bit n set if packet next-1-n has been seen
+//
+typedef struct _sequence_stats {
+  gboolean started;
+  guint32 next;
+  guint64 history;
+  glong packets;
+  glong lost;
+  glong duplicates;
+  glong reordered;
+  glong restarts;
+  // packets (Protocol 1: ozy frames) dropped because they could not be parsed
+  glong malformed;
+} SEQUENCE_STATS;
+
+extern void sequence_reset(SEQUENCE_STATS *s);
+extern gint sequence_check(SEQUENCE_STATS *s,guint32 sequence);
+
+#endif
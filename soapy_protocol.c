@@ -39,6 +39,7 @@
 #include "mode.h"
 #include "filter.h"
 #include "receiver.h"
+#include "receiver_dsp.h"
 #include "transmitter.h"
 #include "wideband.h"
 #include "adc.h"
@@ -247,13 +248,10 @@ g_print("soapy_protocol_init: SoapySDRDevice_make\n");
 }
 
 static void *receive_thread(void *arg) {
-  double isample;
-  double qsample;
   int elements;
   int flags=0;
   long long timeNs=0;
   long timeoutUs=100000L;
-  int i;
 #ifdef TIMING
   struct timeval tv;
   long start_time, end_time;
@@ -270,67 +268,22 @@ g_print("%s: receive_thread\n",__FUNCTION__);
     if(elements<0) {
       g_print("%s: elements=%d max_samples=%d\n",__FUNCTION__,elements,max_samples);
     }
-    for(i=0;i<elements;i++) {
-      rx->buffer[i*2]=(double)buffer[i*2];
-      rx->buffer[(i*2)+1]=(double)buffer[(i*2)+1];
-    }
-/*
-    if(rx->resampler!=NULL) {
-      int out_elements=xresample(rx->resampler);
-g_print("resampler: elements in=%d out=%d\n",elements,out_elements);
-      for(i=0;i<out_elements;i++) {
-        if(radio->iqswap) {
-          qsample=rx->resampled_buffer[i*2];
-          isample=rx->resampled_buffer[(i*2)+1];
-        } else {
-          isample=rx->resampled_buffer[i*2];
-          qsample=rx->resampled_buffer[(i*2)+1];
-        }
-        add_iq_samples(rx,isample,qsample);
-      }
-*/
+    if(elements<=0) continue;
     if(rx->sample_rate!=radio->sample_rate) {
-      for(int i=0;i<elements;i+=rx->resample_step) {
-/*
-        isample=0.0;
-        qsample=0.0;
-        for(int j=0;j<rx->resample_step;j++) {
-          isample+=rx->buffer[(i+j)*2];
-          qsample+=rx->buffer[((i+j)*2)+1];
-        }
-        if(radio->iqswap) {
-          add_iq_samples(rx,qsample/(double)rx->resample_step,isample/(double)rx->resample_step);
-        } else {
-          add_iq_samples(rx,isample/(double)rx->resample_step,qsample/(double)rx->resample_step);
-        }
-*/
-        isample=rx->buffer[i*2];
-        qsample=rx->buffer[(i*2)+1];
-        if(radio->iqswap) {
-          add_iq_samples(rx,qsample,isample);
-        } else {
-          add_iq_samples(rx,isample,qsample);
-        }
-      }
+      // decimate by taking every resample_step'th sample
+      add_iq_block(rx,(unsigned char *)buffer,IQ_FLOAT32,sizeof(float)*2*rx->resample_step,
+                   (elements+rx->resample_step-1)/rx->resample_step,1.0,radio->iqswap);
     } else {
-      for(i=0;i<elements;i++) {
-        isample=rx->buffer[i*2];
-        qsample=rx->buffer[(i*2)+1];
-        if(radio->iqswap) {
-          add_iq_samples(rx,qsample,isample);
-        } else {
-          add_iq_samples(rx,isample,qsample);
-        }
+      add_iq_block(rx,(unsigned char *)buffer,IQ_FLOAT32,sizeof(float)*2,elements,1.0,radio->iqswap);
 #ifdef TIMING
-        rate_samples++;
-        if(rate_samples>=rx->sample_rate) {
-          gettimeofday(&tv, NULL); end_time=tv.tv_usec + 1000000 * tv.tv_sec;
-          g_print("%d samples in %ld usec\n",rx->sample_rate,end_time-start_time);
-          rate_samples=0;
-          start_time=end_time;
-        }
-#endif
+      rate_samples+=elements;
+      if(rate_samples>=rx->sample_rate) {
+        gettimeofday(&tv, NULL); end_time=tv.tv_usec + 1000000 * tv.tv_sec;
+        g_print("%d samples in %ld usec\n",rx->sample_rate,end_time-start_time);
+        rate_samples=0;
+        start_time=end_time;
       }
+#endif
     }
   }
 
@@ -0,0 +1,89 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+
+#include "spectrum_snapshot.h"
+
+SPECTRUM_SNAPSHOT *spectrum_snapshot_new(int pixels) {
+  int i;
+  SPECTRUM_SNAPSHOT *snapshot=g_new0(SPECTRUM_SNAPSHOT,1);
+  snapshot->pixels=pixels;
+  for(i=0;i<SNAPSHOT_FRAMES;i++) {
+    snapshot->frames[i].pixel_samples=g_new0(gfloat,pixels);
+    snapshot->frames[i].pixels_valid=FALSE;
+    snapshot->frames[i].meter_db=-121.0;
+  }
+  snapshot->front=0;
+  snapshot->middle=1;
+  snapshot->back=2;
+  return snapshot;
+}
+
+void spectrum_snapshot_free(SPECTRUM_SNAPSHOT *snapshot) {
+  int i;
+  if(snapshot==NULL) return;
+  for(i=0;i<SNAPSHOT_FRAMES;i++) {
+    g_free(snapshot->frames[i].pixel_samples);
+  }
+  g_free(snapshot);
+}
+
+//
+// producer: the frame to fill for the next spectrum_snapshot_publish()
+//
+SPECTRUM_FRAME *spectrum_snapshot_back(SPECTRUM_SNAPSHOT *snapshot) {
+  return &snapshot->frames[snapshot->back];
+}
+
+//
+// producer: make the back frame the latest one
+// a frame the GUI has not picked up yet is simply replaced
+//
+void spectrum_snapshot_publish(SPECTRUM_SNAPSHOT *snapshot) {
+  gint middle;
+  do {
+    middle=g_atomic_int_get(&snapshot->middle);
+  } while(!g_atomic_int_compare_and_exchange(&snapshot->middle,middle,snapshot->back|SNAPSHOT_FRESH));
+  snapshot->back=middle&~SNAPSHOT_FRESH;
+}
+
+//
+// consumer: take the latest frame if one has been published since the last
+// call, returns FALSE and keeps the current front frame otherwise
+//
+gboolean spectrum_snapshot_acquire(SPECTRUM_SNAPSHOT *snapshot) {
+  gint middle;
+  if(!(g_atomic_int_get(&snapshot->middle)&SNAPSHOT_FRESH)) {
+    return FALSE;
+  }
+  do {
+    middle=g_atomic_int_get(&snapshot->middle);
+  } while(!g_atomic_int_compare_and_exchange(&snapshot->middle,middle,snapshot->front));
+  snapshot->front=middle&~SNAPSHOT_FRESH;
+  return TRUE;
+}
+
+//
+// consumer: the frame to draw, only changes in spectrum_snapshot_acquire()
+//
+SPECTRUM_FRAME *spectrum_snapshot_front(SPECTRUM_SNAPSHOT *snapshot) {
+  return &snapshot->frames[snapshot->front];
+}
@@ -0,0 +1,57 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef SPECTRUM_SNAPSHOT_H
+#define SPECTRUM_SNAPSHOT_H
+
+#define SNAPSHOT_FRAMES 3
+#define SNAPSHOT_FRESH 0x4
+
+//
+// one display update: the panadapter pixels and the S meter reading
+//
+typedef struct _spectrum_frame {
+  gfloat *pixel_samples;
+  gboolean pixels_valid;
+  gdouble meter_db;
+} SPECTRUM_FRAME;
+
+//
+// triple buffer between the DSP thread and the GUI
+// the DSP thread fills the back frame and swaps it with the middle one, the
+// GUI swaps its front frame with the middle one when a new frame has been
+// published, so neither side ever waits for the other
+//
+typedef struct _spectrum_snapshot {
+  gint pixels;
+  SPECTRUM_FRAME frames[SNAPSHOT_FRAMES];
+  gint back;
+  gint middle;
+  gint front;
+} SPECTRUM_SNAPSHOT;
+
+extern SPECTRUM_SNAPSHOT *spectrum_snapshot_new(int pixels);
+extern void spectrum_snapshot_free(SPECTRUM_SNAPSHOT *snapshot);
+extern SPECTRUM_FRAME *spectrum_snapshot_back(SPECTRUM_SNAPSHOT *snapshot);
+extern void spectrum_snapshot_publish(SPECTRUM_SNAPSHOT *snapshot);
+extern gboolean spectrum_snapshot_acquire(SPECTRUM_SNAPSHOT *snapshot);
+extern SPECTRUM_FRAME *spectrum_snapshot_front(SPECTRUM_SNAPSHOT *snapshot);
+
+#endif
@@ -179,10 +179,10 @@ g_print("%s: rx=%d\n",__FUNCTION__,rx->channel);
 
 }
 
-void subrx_iq_buffer(RECEIVER *rx) {
+void subrx_iq_buffer(RECEIVER *rx,gdouble *iq_buffer) {
   SUBRX *subrx=(SUBRX *)rx->subrx;
   gint error;
-  fexchange0(subrx->channel, rx->iq_input_buffer, subrx->audio_output_buffer, &error);
+  fexchange0(subrx->channel, iq_buffer, subrx->audio_output_buffer, &error);
 }
 
 void subrx_volume_changed(RECEIVER *rx) {
@@ -34,7 +34,7 @@ typedef struct _subrx {
 
 extern void create_subrx(RECEIVER *rx);
 extern void destroy_subrx(RECEIVER *rx);
-extern void subrx_iq_buffer(RECEIVER *rx);
+extern void subrx_iq_buffer(RECEIVER *rx,gdouble *iq_buffer);
 extern void subrx_frequency_changed(RECEIVER *rx);
 extern void subrx_mode_changed(RECEIVER *rx);
 extern void subrx_filter_changed(RECEIVER *rx);
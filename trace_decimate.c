@@ -0,0 +1,83 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#include <glib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "trace_decimate.h"
+
+void trace_decimate(const float *samples,int count,int columns,float *min,float *max,float *avg) {
+  int c;
+  int i;
+
+  if(count<=0 || columns<=0) return;
+
+  // the usual case, the analyzer already returns one value per column
+  if(count==columns) {
+    if(min!=NULL) memcpy(min,samples,columns*sizeof(float));
+    if(max!=NULL) memcpy(max,samples,columns*sizeof(float));
+    if(avg!=NULL) memcpy(avg,samples,columns*sizeof(float));
+    return;
+  }
+
+  for(c=0;c<columns;c++) {
+    int first=(int)(((gint64)c*count)/columns);
+    int last=(int)(((gint64)(c+1)*count)/columns);
+    if(last<=first) last=first+1;
+    const float *s=samples+first;
+    int n=last-first;
+    float lo=s[0];
+    float hi=s[0];
+    float sum=0.0f;
+
+    i=0;
+#ifdef __SSE2__
+    if(n>=8) {
+      float l[4],h[4],t[4];
+      __m128 vlo=_mm_loadu_ps(s);
+      __m128 vhi=vlo;
+      __m128 vsum=_mm_setzero_ps();
+      for(;i+4<=n;i+=4) {
+        __m128 v=_mm_loadu_ps(s+i);
+        vlo=_mm_min_ps(vlo,v);
+        vhi=_mm_max_ps(vhi,v);
+        vsum=_mm_add_ps(vsum,v);
+      }
+      _mm_storeu_ps(l,vlo);
+      _mm_storeu_ps(h,vhi);
+      _mm_storeu_ps(t,vsum);
+      lo=MIN(MIN(l[0],l[1]),MIN(l[2],l[3]));
+      hi=MAX(MAX(h[0],h[1]),MAX(h[2],h[3]));
+      sum=(t[0]+t[1])+(t[2]+t[3]);
+    }
+#endif
+    for(;i<n;i++) {
+      if(s[i]<lo) lo=s[i];
+      if(s[i]>hi) hi=s[i];
+      sum+=s[i];
+    }
+
+    if(min!=NULL) min[c]=lo;
+    if(max!=NULL) max[c]=hi;
+    if(avg!=NULL) avg[c]=sum/(float)n;
+  }
+}
@@ -0,0 +1,31 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#ifndef TRACE_DECIMATE_H
+#define TRACE_DECIMATE_H
+
+//
+// reduces count spectrum samples to columns values for drawing, column c
+// covers samples [c*count/columns,(c+1)*count/columns) and always at least
+// one sample, so a span narrower than the display repeats samples rather
+// than leaving gaps. min, max and avg may each be NULL
+//
+extern void trace_decimate(const float *samples,int count,int columns,float *min,float *max,float *avg);
+
+#endif
@@ -38,6 +38,8 @@
 #include "radio.h"
 #include "protocol1.h"
 #include "protocol2.h"
+#include "tx_ring.h"
+#include "tx_scheduler.h"
 #include "tx_panadapter.h"
 #include "main.h"
 #include "vox.h"
@@ -49,12 +51,6 @@
 #include "soapy_protocol.h"
 #endif
 
-// Ring buffer for sending 126 tx iq samples in a packet
-#define QUEUE_ELEMENTS 10000
-#define QUEUE_SIZE (QUEUE_ELEMENTS + 1)
-long Queue[QUEUE_SIZE];
-long QueueIn, QueueOut;
-
 double ctcss_frequencies[CTCSS_FREQUENCIES]= {
   67.0,71.9,74.4,77.0,79.7,82.5,85.4,88.5,91.5,94.8,
   97.4,100.0,103.5,107.2,110.9,114.8,118.8,123.0,127.3,131.8,
@@ -62,33 +58,6 @@ double ctcss_frequencies[CTCSS_FREQUENCIES]= {
   192.8,203.5,210.7,218.1,225.7,233.6,241.8,250.3
 };
 
-const int protocol1_tx_scheduler[20][26] = {
-//  Three receivers - 25 Tx queue events per set of 63, 126, 252, 504  received frames
-{0, 3, 5, 8, 10, 13, 15, 18, 20, 23, 25, 28, 30, 33, 35, 38, 40, 43, 45, 48, 50, 53, 55, 58, 60, -1}, // 25 frames per 63
-{0, 6, 10, 16, 20, 26, 30, 36, 40, 46, 50, 56, 60, 66, 70, 76, 80, 86, 90, 96, 100, 106, 110, 116, 120, -1}, // 25 frames per 126
-{0, 12, 20, 32, 40, 52, 60, 72, 80, 92, 100, 112, 120, 132, 140, 152, 160, 172, 180, 192, 200, 212, 220, 232, 240}, // 25 frames per 252
-{0, 24, 40, 64, 80, 104, 120, 144, 160, 184, 200, 224,240, 264, 280, 304, 320, 344, 360, 384, 400, 424, 440, 464, 480}, // 25 frames per 504
-// Four receivers - 19 Tx queue events per set of 63, 126, 252, 504  received frames
-{3, 6, 10, 13, 16, 20, 23, 26, 30, 33, 36, 40, 43, 46, 50, 53, 56, 59, 62, -1, -1, -1, -1, -1, -1, -1}, // 19 frames per 63
-{6, 12, 20, 26, 32, 40, 46, 52, 60, 66, 72, 80, 86, 92, 100, 106, 112, 118, 124, -1, -1, -1, -1, -1, -1, -1}, // 19 frames per 126
-{12, 24, 40, 52, 64, 80, 92, 104, 120, 132, 144, 160, 172, 184, 200, 212, 224, 236, 248, -1, -1, -1, -1, -1, -1, -1},  // 19 frames per 252
-{24, 48, 80, 104, 128, 160, 184, 208, 240, 264, 288, 320, 344, 368, 400, 424, 448, 472, 496,-1, -1, -1, -1, -1, -1, -1},  // 19 frames per 504
-// Five receivers - 15 Tx queue events per set of 63, 126, 252, 504  received frames
-{4, 8, 12, 16, 21, 25, 29, 33, 37, 42, 46, 50, 54, 58, 62, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // 15 frames per 63
-{8, 16, 24, 32, 42, 50, 58, 66, 74, 84, 92, 100, 108, 116, 124, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // 15 frames per 126
-{ 16, 32, 48, 64, 84, 100, 116, 132, 148, 168, 184, 200, 216, 232, 248, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},  // 15 frames per 252
-{ 32, 64, 96, 128, 168, 200, 232, 264, 296, 336, 368, 400, 432, 464, 496, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},  // 15 frames per 504
-// Six receivers - 13 Tx queue events per set of 63, 126, 252, 504  received frames
-{ 5, 10, 15, 20, 24, 29, 34, 39, 44, 48, 53, 58, 62, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1}, // 13 frames per 63
-{ 10, 20, 30, 40, 48, 58, 68, 78, 88, 96, 106, 116, 124, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1}, // 13 frames per 126
-{ 20, 40, 60, 80, 96, 116, 136, 156, 176, 192, 212, 232, 248, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1},  // 13 frames per 252
-{ 40, 80, 120, 160, 192, 232, 272, 312, 352, 384, 424, 464, 496, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1},  // 13 frames per 504
-//  Seven receivers - 11 Tx queue events per set of 63, 126, 252, 504  received frames
-{6, 12, 17, 23, 29, 34, 40, 45, 51, 57, 62, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1}, // 11 frames per 63
-{12, 24, 34, 46, 58, 68, 80, 90, 102, 114, 124, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1}, // 11 frames per 126
-{24, 48, 68, 92, 116, 136, 160, 180, 204, 228, 248, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1},  // 11 frames per 252
-{48, 96, 136, 184, 232, 272, 320, 360, 408, 456, 496, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1}};  // 11 frames per 504   
-
 void transmitter_save_state(TRANSMITTER *tx) {
   char name[80];
   char value[80];
@@ -365,14 +334,13 @@ static gboolean update_timer_cb(void *data) {
   int fwd_cal_offset=6;
 
   TRANSMITTER *tx=(TRANSMITTER *)data;
-  //if(isTransmitting(radio)) {
+  if(!headless) {
     GetPixels(tx->channel,0,tx->pixel_samples,&rc);
     if(rc) {
       update_tx_panadapter(radio);
     }
-  //}
-
-  update_mic_level(radio);
+    update_mic_level(radio);
+  }
 
   if(isTransmitting(radio)) {
     tx->alc=GetTXAMeter(tx->channel,tx->alc_meter);
@@ -524,140 +492,41 @@ void transmitter_set_ps_sample_rate(TRANSMITTER *tx,int rate) {
   SetPSFeedbackRate (tx->channel,rate);
 }
 
-//Initialise the ring buffer
-void QueueInit(void) {
-    QueueIn = QueueOut = 0;
-}
-
-//Put sample on the ring buffer
-int QueuePut(long new) {
-  if(QueueIn == (( QueueOut - 1 + QUEUE_SIZE) % QUEUE_SIZE)) {
-    return -1; // Queue Full
-  }
-
-  Queue[QueueIn] = new;
-  QueueIn = (QueueIn + 1) % QUEUE_SIZE;
-  return 0; // No errors
-}
-
-//Get sample from the ring buffer
-int QueueGet(long *old) {
-  // Queue Empty - nothing to get
-  if(QueueIn == QueueOut) return -1; 
-
-  *old = Queue[QueueOut];
-  QueueOut = (QueueOut + 1) % QUEUE_SIZE;
-  return 0; // No errors
-}
-
 // Tx packet schedule synched to the rx packets
-// Credit to N5EG for most most of the code
-// https://github.com/Tom-McDermott/gr-hpsdr/blob/master/lib/HermesProxy.cc
 int SendTXpacketQuery(TRANSMITTER *tx) {
-  tx->packet_counter++;
-  
-  switch (radio->receivers) {
-    case 1: {
-      // one Tx frame for each Rx frame
-      if(radio->sample_rate == 48000)	return 1;
-	    // one Tx frame for each two Rx frames
-		  if(radio->sample_rate == 96000)	{
-		    if((tx->packet_counter & 0x1) == 0) return 1;
-        break;
-      }
-	
-      // one Tx frame for each four Tx frames  
-		  if(radio->sample_rate == 192000) {
-		    if((tx->packet_counter & 0x3) == 0) return 1;
-        break;
-      }
-
-      // one Tx frame for each eight Tx frames
-		  if(radio->sample_rate == 384000) {
-		    if((tx->packet_counter & 0x7) == 0) return 1;
-        break;
-      }	
-    }
-    
-    case 2: {
-      // one Tx frame for each 1.75 Rx frame
-      if(radio->sample_rate == 48000)	{
-        if(((tx->packet_counter % 0x7) & 0x01) == 0) return 1;
-        break;
-      }
-        
-	    // one Tx frame for each 3.5 Rx frames
-		  if(radio->sample_rate == 96000)	{
-		    if(((tx->packet_counter % 0x7) & 0x03) == 0) return 1;
-        break;
-      }
-	
-      // one Tx frame for each four Tx frames  
-		  if(radio->sample_rate == 192000) {
-		    if((tx->packet_counter % 0x7) == 0) return 1;
-        break;
-      }
+  int receivers=radio->receivers;
 
-      // one Tx frame for each eight Tx frames
-		  if(radio->sample_rate == 384000) {
-		    if((tx->packet_counter % 14) == 0) return 1;
-        break;
-      }	
-    }
-    
-    default: {
-      int FrameIndex;
-		  int RxNumIndex = radio->receivers-3;	  //   3,  4,  5,  6,  7  -->  0, 1, 2, 3, 4
-
-		  int SpeedIndex = (radio->sample_rate) / 48000;  // 48k, 96k, 192k, 384k -->  1, 2, 4, 8
-		  SpeedIndex = SpeedIndex >> 1;		  // 48k, 96k, 192k, 384k -->  0, 1, 2, 4
-		  if (SpeedIndex == 4)  SpeedIndex = 3;	  // 48k, 96k, 192k, 384k -->  0, 1, 2, 3
-
-		  int selector = RxNumIndex * 4 + SpeedIndex;	//  0 .. 19
-
-	    // Compute the frame number within a vector
-		  if(radio->sample_rate == 48000) FrameIndex = tx->packet_counter % 63;	// FrameIndex is 0..62
-	  	if(radio->sample_rate == 96000) FrameIndex = tx->packet_counter % 126;	// FrameIndex is 0..125
-	  	if(radio->sample_rate == 192000) FrameIndex = tx->packet_counter % 252;	// FrameIndex is 0..251
-	  	if(radio->sample_rate == 384000) FrameIndex = tx->packet_counter % 504;	// FrameIndex is 0..503      
-      
-      for (int i = 0; i < 26; i++) {
-        if (FrameIndex == protocol1_tx_scheduler[selector][i]) return 1; 
-      }
-      break;
-    }   
-  }
-  return 0;
+  if(receivers>MAX_RECEIVERS) receivers=MAX_RECEIVERS;
+  return tx_scheduler_query(&tx->p1_schedule,receivers,radio->sample_rate,tx->iq_output_rate,tx->p1_packet_size);
 }
 
 
 // Protocol 1 receive thread calls this, to send 126 iq samples in a 
 // tx packet
 void full_tx_buffer(TRANSMITTER *tx) {
-  if (!isTransmitting(radio) && radio->discovered->device!=DEVICE_HERMES_LITE2) return;
-  if ((isTransmitting(radio)) && (radio->classE)) return;
+  TX_RING *ring=(TX_RING *)tx->iq_ring;
+
+  if ((!isTransmitting(radio) && radio->discovered->device!=DEVICE_HERMES_LITE2) ||
+      (isTransmitting(radio) && radio->classE)) {
+    // nothing is being sent so don't let stale samples build up
+    tx_ring_flush(ring);
+    tx->iq_ring_primed=FALSE;
+    return;
+  }
   
   // Work out if we are going to send a tx packet or return
   if (!SendTXpacketQuery(tx)) return;
-    
-  for (int j = 0; j < tx->p1_packet_size ; j++) {  
-    long isample = 0;
-    long qsample = 0;           
-    g_mutex_lock((&tx->queue_mutex));
-    QueueGet(&isample);
-    QueueGet(&qsample);    
-    g_mutex_unlock((&tx->queue_mutex));
-    protocol1_iq_samples(isample, qsample);
-  }
-  //}
-  /*
-  else {
-    for (int j=0; j<126; j++) {
-      QueueGet(&isample);
-      QueueGet(&qsample);            
-      protocol1_iq_samples(isample, qsample);
+
+  // hold off until a full DSP buffer is queued so the first packets
+  // after key down don't count as underruns
+  if (!tx->iq_ring_primed) {
+    if (tx_ring_depth(ring) < tx->output_samples) {
+      protocol1_iq_frames(NULL, tx->p1_packet_size);
+      return;
     }
-  }*/
+    tx->iq_ring_primed=TRUE;
+  }
+  protocol1_iq_frames(ring, tx->p1_packet_size);
 }
 
 
@@ -698,19 +567,14 @@ void full_tx_buffer_process(TRANSMITTER *tx) {
     fprintf(stderr,"full_tx_buffer_process: channel=%d fexchange0: error=%d\n",tx->channel,error);
   }
 
-  Spectrum0(1, tx->channel, 0, 0, tx->iq_output_buffer);
+  if(!headless) {
+    Spectrum0(1, tx->channel, 0, 0, tx->iq_output_buffer);
+  }
   
   if ((radio->discovered->protocol == PROTOCOL_1) && (!radio->classE)) {
     // not going to send out packets now, put them in the ring buffer
     // then every rx packet, we send a tx packet @48k  
-    for(int j = 0; j < tx->output_samples; j++) {
-      long isample = ROUNDHTZ(tx->iq_output_buffer[j*2]);
-      long qsample = ROUNDHTZ(tx->iq_output_buffer[(j*2)+1]);  
-      g_mutex_lock((&tx->queue_mutex));    
-      QueuePut(isample);
-      QueuePut(qsample);    
-      g_mutex_unlock(&tx->queue_mutex);
-    }
+    tx_ring_put((TX_RING *)tx->iq_ring, tx->iq_output_buffer, tx->output_samples, gain);
     return;
   }
   
@@ -732,6 +596,19 @@ void full_tx_buffer_process(TRANSMITTER *tx) {
 
     }
 
+    if(radio->discovered->protocol==PROTOCOL_2) {
+      if(radio->classE) {
+        for(j=0;j<tx->output_samples;j++) {
+          tx->iq_output_buffer[j*2]=tx->inI[j];
+          tx->iq_output_buffer[(j*2)+1]=tx->inQ[j];
+        }
+      } else if(radio->iqswap) {
+        iq_swap(tx->iq_output_buffer,tx->output_samples);
+      }
+      protocol2_iq_block(tx->iq_output_buffer,tx->output_samples,gain);
+      return;
+    }
+
     for(j=0;j<tx->output_samples;j++) {
       if(radio->classE) {
         isample=ROUNDHTZ(tx->inI[j]);
@@ -757,9 +634,6 @@ void full_tx_buffer_process(TRANSMITTER *tx) {
             return;
           }
           break;
-        case PROTOCOL_2:
-          protocol2_iq_samples(isample,qsample);
-          break;
 #ifdef SOAPYSDR
         case PROTOCOL_SOAPYSDR:
           soapy_protocol_iq_samples((float)isample,(float)qsample);
@@ -977,7 +851,6 @@ void transmitter_init_analyzer(TRANSMITTER *tx) {
 }
 
 TRANSMITTER *create_transmitter(int channel) {
-  QueueInit();
   gint rc;
 g_print("create_transmitter: channel=%d\n",channel);
   TRANSMITTER *tx=g_new0(TRANSMITTER,1);
@@ -987,8 +860,6 @@ g_print("create_transmitter: channel=%d\n",channel);
   tx->mic_gain=0.0;
   tx->rx=NULL;
 
-  g_mutex_init(&tx->queue_mutex);
-
   tx->alc_meter=TXA_ALC_PK;
   tx->exciter_power=0;
   tx->alex_forward_power=0;
@@ -1022,7 +893,9 @@ g_print("create_transmitter: channel=%d\n",channel);
       tx->buffer_size=1024;
       tx->output_samples=1024;
       tx->p1_packet_size = 126;
-      tx->packet_counter = 0;
+      tx->p1_schedule = 0;
+      tx->iq_ring=tx_ring_new(TX_RING_FRAMES);
+      tx->iq_ring_primed=FALSE;
       break;
     case PROTOCOL_2:
       tx->mic_sample_rate=48000;
@@ -1175,7 +1048,9 @@ g_print("create_transmitter: channel=%d\n",channel);
 
   transmitter_set_mode(tx,mode);
 
-  create_visual(tx);
+  if(!headless) {
+    create_visual(tx);
+  }
 
   XCreateAnalyzer(tx->channel, &rc, 262144, 1, 1, "");
   if (rc != 0) {
@@ -28,7 +28,10 @@ typedef struct _transmitter {
 
   gint dac;
   
-  GMutex queue_mutex;  
+  void *iq_ring;
+  gboolean iq_ring_primed;
+  GtkWidget *iq_ring_stats_label;
+  guint iq_ring_stats_timer_id;
 
   gint alex_antenna;
   gdouble mic_gain;
@@ -81,7 +84,7 @@ typedef struct _transmitter {
   gdouble *mic_input_buffer;
   gdouble *iq_output_buffer;
   //
-  guint packet_counter;
+  gint64 p1_schedule;
   
   gfloat *inI, *inQ, *outMI, *outMQ; // for EER
   gint mic_sample_rate;
@@ -168,7 +171,6 @@ extern void transmitter_set_ps(TRANSMITTER *tx,gboolean state);
 extern void transmitter_set_twotone(TRANSMITTER *tx,gboolean state);
 extern void transmitter_set_ps_sample_rate(TRANSMITTER *tx,int rate);
 
-extern void QueueInit(void);
 extern void full_tx_buffer(TRANSMITTER *tx);
 
 extern void transmitter_enable_eer(TRANSMITTER *tx,gboolean state);
@@ -42,6 +42,7 @@
 #include "audio.h"
 #include "band.h"
 #include "tx_panadapter.h"
+#include "tx_ring.h"
 
 
 static GtkWidget *microphone_frame;
@@ -257,6 +258,31 @@ g_print("adding: %s\n",input_devices[i].description);
   g_signal_handler_unblock(G_OBJECT(tx->microphone_choice_b),tx->microphone_choice_signal_id);
 }
 
+static gboolean iq_ring_stats_timeout_cb(gpointer data) {
+  TRANSMITTER *tx=(TRANSMITTER *)data;
+  TX_RING *ring=(TX_RING *)tx->iq_ring;
+  char text[128];
+
+  if(tx->iq_ring_stats_label==NULL) {
+    tx->iq_ring_stats_timer_id=0;
+    return FALSE;
+  }
+  if(ring!=NULL) {
+    sprintf(text,"Queue: %d/%d (max %d)\nOverruns: %ld\nUnderruns: %ld",tx_ring_depth(ring),ring->frames,ring->max_depth,ring->overruns,ring->underruns);
+    gtk_label_set_text(GTK_LABEL(tx->iq_ring_stats_label),text);
+  }
+  return TRUE;
+}
+
+static void iq_ring_stats_destroy_cb(GtkWidget *widget,gpointer data) {
+  TRANSMITTER *tx=(TRANSMITTER *)data;
+  if(tx->iq_ring_stats_timer_id!=0) {
+    g_source_remove(tx->iq_ring_stats_timer_id);
+    tx->iq_ring_stats_timer_id=0;
+  }
+  tx->iq_ring_stats_label=NULL;
+}
+
 GtkWidget *create_transmitter_dialog(TRANSMITTER *tx) {
   int i;
   char temp[32];
@@ -462,6 +488,22 @@ g_print("%s: tx=%d\n",__FUNCTION__,tx->channel);
   g_signal_connect(G_OBJECT(panadapter_low_scale),"value_changed",G_CALLBACK(panadapter_low_value_changed_cb),tx);
   gtk_grid_attach(GTK_GRID(panadapter_grid),panadapter_low_scale,1,2,1,1);
 
+  if(tx->iq_ring!=NULL) {
+    GtkWidget *iq_frame=gtk_frame_new("TX IQ");
+    GtkWidget *iq_grid=gtk_grid_new();
+    gtk_grid_set_row_homogeneous(GTK_GRID(iq_grid),FALSE);
+    gtk_grid_set_column_homogeneous(GTK_GRID(iq_grid),FALSE);
+    gtk_container_add(GTK_CONTAINER(iq_frame),iq_grid);
+    gtk_grid_attach(GTK_GRID(grid),iq_frame,col,row++,1,1);
+
+    tx->iq_ring_stats_label=gtk_label_new(NULL);
+    gtk_widget_set_halign(tx->iq_ring_stats_label,GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(iq_grid),tx->iq_ring_stats_label,0,0,1,1);
+    g_signal_connect(iq_frame,"destroy",G_CALLBACK(iq_ring_stats_destroy_cb),tx);
+    iq_ring_stats_timeout_cb(tx);
+    tx->iq_ring_stats_timer_id=g_timeout_add(500,iq_ring_stats_timeout_cb,tx);
+  }
+
   col++;
   row=1;
 
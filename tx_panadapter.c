@@ -111,6 +111,8 @@ GtkWidget *create_tx_panadapter(TRANSMITTER *tx) {
 
 void update_tx_panadapter(RADIO *r) {
   TRANSMITTER *tx=r->transmitter;
+  if(tx==NULL || tx->panadapter==NULL) return;
+
   int width=gtk_widget_get_allocated_width(tx->panadapter);
   int height=gtk_widget_get_allocated_height(tx->panadapter);
   float *samples=tx->pixel_samples;
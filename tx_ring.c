@@ -0,0 +1,106 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tx_ring.h"
+#include "iq_convert.h"
+
+TX_RING *tx_ring_new(int frames) {
+  TX_RING *ring=g_new0(TX_RING,1);
+  ring->frames=frames;
+  ring->buffer=g_new0(guchar,frames*TX_RING_FRAME_SIZE);
+  ring->head=0;
+  ring->tail=0;
+  ring->max_depth=0;
+  ring->overruns=0;
+  ring->underruns=0;
+  return ring;
+}
+
+void tx_ring_free(TX_RING *ring) {
+  if(ring==NULL) return;
+  g_free(ring->buffer);
+  g_free(ring);
+}
+
+//
+// consumer: throw away everything queued
+//
+void tx_ring_flush(TX_RING *ring) {
+  g_atomic_int_set(&ring->tail,(guint)g_atomic_int_get(&ring->head));
+}
+
+gint tx_ring_depth(TX_RING *ring) {
+  return (gint)((guint)g_atomic_int_get(&ring->head)-(guint)g_atomic_int_get(&ring->tail));
+}
+
+//
+// producer: scale, round and pack count I/Q pairs
+// samples that do not fit are dropped and counted as overruns
+//
+gint tx_ring_put(TX_RING *ring,gdouble *iq,int count,gdouble gain) {
+  guint head=(guint)g_atomic_int_get(&ring->head);
+  gint depth=(gint)(head-(guint)g_atomic_int_get(&ring->tail));
+  gint space=ring->frames-depth;
+  gint offset=head%ring->frames;
+  gint first;
+
+  if(count>space) {
+    ring->overruns+=count-space;
+    count=space;
+  }
+  // pack straight into the ring, in two pieces if it wraps
+  first=count<ring->frames-offset?count:ring->frames-offset;
+  iq_pack_frames(iq,&ring->buffer[offset*TX_RING_FRAME_SIZE],first,4,gain);
+  if(count>first) {
+    iq_pack_frames(&iq[first*2],ring->buffer,count-first,4,gain);
+  }
+  g_atomic_int_set(&ring->head,head+count);
+  if(depth+count>ring->max_depth) {
+    ring->max_depth=depth+count;
+  }
+  return count;
+}
+
+//
+// consumer: copy count frames into frames
+// if the ring runs dry the rest is filled with silence and counted as underruns
+//
+gint tx_ring_get(TX_RING *ring,guchar *frames,int count) {
+  guint tail=(guint)g_atomic_int_get(&ring->tail);
+  gint depth=(gint)((guint)g_atomic_int_get(&ring->head)-tail);
+  gint n=count<depth?count:depth;
+  gint offset=tail%ring->frames;
+  gint first=n<ring->frames-offset?n:ring->frames-offset;
+
+  memcpy(frames,&ring->buffer[offset*TX_RING_FRAME_SIZE],first*TX_RING_FRAME_SIZE);
+  if(n>first) {
+    memcpy(&frames[first*TX_RING_FRAME_SIZE],ring->buffer,(n-first)*TX_RING_FRAME_SIZE);
+  }
+  g_atomic_int_set(&ring->tail,tail+n);
+  if(n<count) {
+    memset(&frames[n*TX_RING_FRAME_SIZE],0,(count-n)*TX_RING_FRAME_SIZE);
+    ring->underruns+=count-n;
+  }
+  return n;
+}
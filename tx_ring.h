@@ -0,0 +1,50 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef TX_RING_H
+#define TX_RING_H
+
+// one Protocol 1 TX sample row: L,R,I,Q as 16 bit big endian
+#define TX_RING_FRAME_SIZE 8
+#define TX_RING_FRAMES 8192
+
+//
+// single producer/single consumer ring of Protocol 1 TX I/Q frames
+// the TX DSP converts and packs samples as they will be sent and the
+// protocol 1 receive thread copies them straight into the ozy buffer
+//
+typedef struct _tx_ring {
+  gint frames;
+  guchar *buffer;
+  guint head;
+  guint tail;
+  gint max_depth;
+  glong overruns;
+  glong underruns;
+} TX_RING;
+
+extern TX_RING *tx_ring_new(int frames);
+extern void tx_ring_free(TX_RING *ring);
+extern void tx_ring_flush(TX_RING *ring);
+extern gint tx_ring_depth(TX_RING *ring);
+extern gint tx_ring_put(TX_RING *ring,gdouble *iq,int count,gdouble gain);
+extern gint tx_ring_get(TX_RING *ring,guchar *frames,int count);
+
+#endif
@@ -0,0 +1,45 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+
+#include "tx_scheduler.h"
+
+// Each rx packet carries 2 ozy frames of (512-8)/(receivers*6+2) samples
+// at the radio sample rate and each tx packet carries packet_size samples
+// at output_rate. Received time is accumulated in units of
+// 1/(output_rate*sample_rate) seconds and a tx packet is due every time a
+// whole packet of tx time has been received, so the schedule is exact for
+// any receiver count and sample rate and never drifts.
+int tx_scheduler_query(gint64 *schedule,int receivers,int sample_rate,int output_rate,int packet_size) {
+  gint64 rx_time;
+  gint64 tx_time;
+
+  if(receivers<1) receivers=1;
+  rx_time=(gint64)(2*((512-8)/((receivers*6)+2)))*output_rate;
+  tx_time=(gint64)packet_size*sample_rate;
+
+  *schedule+=rx_time;
+  if(*schedule>=tx_time) {
+    *schedule-=tx_time;
+    return 1;
+  }
+  return 0;
+}
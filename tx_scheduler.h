@@ -0,0 +1,33 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <glib.h>
+
+//
+// Protocol 1 tx packet schedule, called once per rx packet with the
+// transmitter's accumulator. Returns 1 when a tx packet of packet_size
+// samples at output_rate is due
+//
+extern int tx_scheduler_query(gint64 *schedule,int receivers,int sample_rate,int output_rate,int packet_size);
+
+#endif
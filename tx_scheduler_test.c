@@ -0,0 +1,269 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+//
+// Checks the Protocol 1 tx packet schedule against the table based
+// scheduler it replaced and for drift over a long run. make test runs it.
+//
+// ./tx_scheduler_test            (an hour of simulated rx packets)
+// ./tx_scheduler_test -H 24
+//
+
+#include <glib.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tx_scheduler.h"
+
+// the receivers and sample rates the legacy scheduler covered
+#define LEGACY_MAX_RECEIVERS 7
+#define LEGACY_MAX_RATE 384000
+// rx packets compared with it, a whole number of every table period
+#define LEGACY_PACKETS (504*8)
+
+#define MAX_RECEIVERS 8
+#define MAX_RATE 1536000
+#define OUTPUT_RATE 48000
+#define PACKET_SIZE 126
+
+static double hours=1.0;
+static int failures=0;
+
+// the legacy scheduler, by N5EG
+// https://github.com/Tom-McDermott/gr-hpsdr/blob/master/lib/HermesProxy.cc
+static const int protocol1_tx_scheduler[20][26] = {
+//  Three receivers - 25 Tx queue events per set of 63, 126, 252, 504  received frames
+{0, 3, 5, 8, 10, 13, 15, 18, 20, 23, 25, 28, 30, 33, 35, 38, 40, 43, 45, 48, 50, 53, 55, 58, 60, -1}, // 25 frames per 63
+{0, 6, 10, 16, 20, 26, 30, 36, 40, 46, 50, 56, 60, 66, 70, 76, 80, 86, 90, 96, 100, 106, 110, 116, 120, -1}, // 25 frames per 126
+{0, 12, 20, 32, 40, 52, 60, 72, 80, 92, 100, 112, 120, 132, 140, 152, 160, 172, 180, 192, 200, 212, 220, 232, 240}, // 25 frames per 252
+{0, 24, 40, 64, 80, 104, 120, 144, 160, 184, 200, 224,240, 264, 280, 304, 320, 344, 360, 384, 400, 424, 440, 464, 480}, // 25 frames per 504
+// Four receivers - 19 Tx queue events per set of 63, 126, 252, 504  received frames
+{3, 6, 10, 13, 16, 20, 23, 26, 30, 33, 36, 40, 43, 46, 50, 53, 56, 59, 62, -1, -1, -1, -1, -1, -1, -1}, // 19 frames per 63
+{6, 12, 20, 26, 32, 40, 46, 52, 60, 66, 72, 80, 86, 92, 100, 106, 112, 118, 124, -1, -1, -1, -1, -1, -1, -1}, // 19 frames per 126
+{12, 24, 40, 52, 64, 80, 92, 104, 120, 132, 144, 160, 172, 184, 200, 212, 224, 236, 248, -1, -1, -1, -1, -1, -1, -1},  // 19 frames per 252
+{24, 48, 80, 104, 128, 160, 184, 208, 240, 264, 288, 320, 344, 368, 400, 424, 448, 472, 496,-1, -1, -1, -1, -1, -1, -1},  // 19 frames per 504
+// Five receivers - 15 Tx queue events per set of 63, 126, 252, 504  received frames
+{4, 8, 12, 16, 21, 25, 29, 33, 37, 42, 46, 50, 54, 58, 62, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // 15 frames per 63
+{8, 16, 24, 32, 42, 50, 58, 66, 74, 84, 92, 100, 108, 116, 124, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, // 15 frames per 126
+{ 16, 32, 48, 64, 84, 100, 116, 132, 148, 168, 184, 200, 216, 232, 248, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},  // 15 frames per 252
+{ 32, 64, 96, 128, 168, 200, 232, 264, 296, 336, 368, 400, 432, 464, 496, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},  // 15 frames per 504
+// Six receivers - 13 Tx queue events per set of 63, 126, 252, 504  received frames
+{ 5, 10, 15, 20, 24, 29, 34, 39, 44, 48, 53, 58, 62, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1}, // 13 frames per 63
+{ 10, 20, 30, 40, 48, 58, 68, 78, 88, 96, 106, 116, 124, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1}, // 13 frames per 126
+{ 20, 40, 60, 80, 96, 116, 136, 156, 176, 192, 212, 232, 248, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1},  // 13 frames per 252
+{ 40, 80, 120, 160, 192, 232, 272, 312, 352, 384, 424, 464, 496, -1, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1},  // 13 frames per 504
+//  Seven receivers - 11 Tx queue events per set of 63, 126, 252, 504  received frames
+{6, 12, 17, 23, 29, 34, 40, 45, 51, 57, 62, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1}, // 11 frames per 63
+{12, 24, 34, 46, 58, 68, 80, 90, 102, 114, 124, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1}, // 11 frames per 126
+{24, 48, 68, 92, 116, 136, 160, 180, 204, 228, 248, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1},  // 11 frames per 252
+{48, 96, 136, 184, 232, 272, 320, 360, 408, 456, 496, -1, -1, -1, -1, -1, -1, -1 , -1, -1, -1, -1, -1, -1, -1, -1}};  // 11 frames per 504
+static int legacy_query(guint *packet_counter,int receivers,int sample_rate) {
+  (*packet_counter)++;
+
+  switch (receivers) {
+    case 1: {
+      // one Tx frame for each Rx frame
+      if(sample_rate == 48000) return 1;
+      // one Tx frame for each two Rx frames
+      if(sample_rate == 96000) {
+        if((*packet_counter & 0x1) == 0) return 1;
+        break;
+      }
+      // one Tx frame for each four Tx frames
+      if(sample_rate == 192000) {
+        if((*packet_counter & 0x3) == 0) return 1;
+        break;
+      }
+      // one Tx frame for each eight Tx frames
+      if(sample_rate == 384000) {
+        if((*packet_counter & 0x7) == 0) return 1;
+        break;
+      }
+    }
+
+    case 2: {
+      // one Tx frame for each 1.75 Rx frame
+      if(sample_rate == 48000) {
+        if(((*packet_counter % 0x7) & 0x01) == 0) return 1;
+        break;
+      }
+      // one Tx frame for each 3.5 Rx frames
+      if(sample_rate == 96000) {
+        if(((*packet_counter % 0x7) & 0x03) == 0) return 1;
+        break;
+      }
+      // one Tx frame for each four Tx frames
+      if(sample_rate == 192000) {
+        if((*packet_counter % 0x7) == 0) return 1;
+        break;
+      }
+      // one Tx frame for each eight Tx frames
+      if(sample_rate == 384000) {
+        if((*packet_counter % 14) == 0) return 1;
+        break;
+      }
+    }
+
+    default: {
+      int FrameIndex=0;
+      int RxNumIndex = receivers-3;           //   3,  4,  5,  6,  7  -->  0, 1, 2, 3, 4
+
+      int SpeedIndex = sample_rate / 48000;   // 48k, 96k, 192k, 384k -->  1, 2, 4, 8
+      SpeedIndex = SpeedIndex >> 1;           // 48k, 96k, 192k, 384k -->  0, 1, 2, 4
+      if (SpeedIndex == 4)  SpeedIndex = 3;   // 48k, 96k, 192k, 384k -->  0, 1, 2, 3
+
+      int selector = RxNumIndex * 4 + SpeedIndex;   //  0 .. 19
+
+      // Compute the frame number within a vector
+      if(sample_rate == 48000) FrameIndex = *packet_counter % 63;    // FrameIndex is 0..62
+      if(sample_rate == 96000) FrameIndex = *packet_counter % 126;   // FrameIndex is 0..125
+      if(sample_rate == 192000) FrameIndex = *packet_counter % 252;  // FrameIndex is 0..251
+      if(sample_rate == 384000) FrameIndex = *packet_counter % 504;  // FrameIndex is 0..503
+
+      for (int i = 0; i < 26; i++) {
+        if (FrameIndex == protocol1_tx_scheduler[selector][i]) return 1;
+      }
+      break;
+    }
+  }
+  return 0;
+}
+
+static void fail(const char *format,...) {
+  va_list args;
+  va_start(args,format);
+  vfprintf(stderr,format,args);
+  va_end(args);
+  failures++;
+}
+
+// rx packets per period of the legacy schedule
+static int legacy_period(int receivers,int sample_rate) {
+  if(receivers==1) return sample_rate/48000;
+  if(receivers==2) return sample_rate==384000?14:7;
+  return 63*(sample_rate/48000);
+}
+
+//
+// 1 and 2 receivers must send on the same rx packets as the legacy
+// scheduler. The rows for 3 to 7 receivers are not evenly spaced (the
+// 96k to 384k rows are the 48k row stretched) so there the packet count
+// must be the same at the end of every table period and never more than
+// one packet apart in between.
+//
+static void check_legacy(int receivers,int sample_rate) {
+  gint64 schedule=0;
+  guint packet_counter=0;
+  int period=legacy_period(receivers,sample_rate);
+  int sent=0;
+  int legacy_sent=0;
+  int tx;
+  int legacy_tx;
+  int n;
+
+  for(n=1;n<=LEGACY_PACKETS;n++) {
+    tx=tx_scheduler_query(&schedule,receivers,sample_rate,OUTPUT_RATE,PACKET_SIZE);
+    legacy_tx=legacy_query(&packet_counter,receivers,sample_rate);
+    sent+=tx;
+    legacy_sent+=legacy_tx;
+    if(receivers<=2 && tx!=legacy_tx) {
+      fail("%d receivers at %d: rx packet %d sends %d, legacy %d\n",receivers,sample_rate,n,tx,legacy_tx);
+      return;
+    }
+    if(abs(sent-legacy_sent)>1) {
+      fail("%d receivers at %d: rx packet %d has sent %d, legacy %d\n",receivers,sample_rate,n,sent,legacy_sent);
+      return;
+    }
+    if((n%period)==0 && sent!=legacy_sent) {
+      fail("%d receivers at %d: end of period at rx packet %d has sent %d, legacy %d\n",receivers,sample_rate,n,sent,legacy_sent);
+      return;
+    }
+  }
+  fprintf(stderr,"legacy %d receivers at %d: %d tx per %d rx packets\n",receivers,sample_rate,sent,LEGACY_PACKETS);
+}
+
+//
+// hours of rx packets, the tx packets sent must never be more than one
+// away from the tx time received
+//
+static void check_drift(int receivers,int sample_rate) {
+  gint64 schedule=0;
+  gint64 packets;
+  gint64 sent=0;
+  gint64 n;
+  int samples=2*((512-8)/((receivers*6)+2));
+  double ideal;
+  double error;
+  double max_error=0.0;
+
+  packets=(gint64)(hours*3600.0*(double)sample_rate/(double)samples);
+  for(n=1;n<=packets;n++) {
+    sent+=tx_scheduler_query(&schedule,receivers,sample_rate,OUTPUT_RATE,PACKET_SIZE);
+    if((n&0xFFF)==0 || n==packets) {
+      ideal=((double)n*(double)samples*(double)OUTPUT_RATE)/((double)sample_rate*(double)PACKET_SIZE);
+      error=(double)sent-ideal;
+      if(error<0.0) error=-error;
+      if(error>max_error) max_error=error;
+      if(error>=1.0) {
+        fail("%d receivers at %d: after %ld rx packets sent %ld, expected %.3f\n",
+             receivers,sample_rate,(long)n,(long)sent,ideal);
+        return;
+      }
+    }
+  }
+  fprintf(stderr,"drift %d receivers at %d: %ld rx %ld tx packets, max error %.3f packets\n",
+          receivers,sample_rate,(long)packets,(long)sent,max_error);
+}
+
+int main(int argc,char **argv) {
+  int receivers;
+  int rate;
+  int c;
+
+  while((c=getopt(argc,argv,"H:"))!=-1) {
+    switch(c) {
+      case 'H': hours=atof(optarg); break;
+      default:
+        fprintf(stderr,"usage: %s [-H hours]\n",argv[0]);
+        exit(-1);
+    }
+  }
+
+  for(receivers=1;receivers<=LEGACY_MAX_RECEIVERS;receivers++) {
+    for(rate=48000;rate<=LEGACY_MAX_RATE;rate*=2) {
+      check_legacy(receivers,rate);
+    }
+  }
+  for(receivers=1;receivers<=MAX_RECEIVERS;receivers++) {
+    for(rate=48000;rate<=MAX_RATE;rate*=2) {
+      check_drift(receivers,rate);
+    }
+  }
+
+  if(failures>0) {
+    fprintf(stderr,"tx_scheduler_test: %d failures\n",failures);
+    return 1;
+  }
+  fprintf(stderr,"tx_scheduler_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,151 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#define _GNU_SOURCE
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "udp_batch.h"
+
+UDP_BATCH *udp_batch_new(int size,PACKET_POOL *pool) {
+  int i;
+  UDP_BATCH *batch;
+
+  if(size<1) size=1;
+  if(size>MAX_UDP_BATCH_SIZE) size=MAX_UDP_BATCH_SIZE;
+
+  batch=g_new0(UDP_BATCH,1);
+  batch->size=size;
+  batch->count=0;
+  batch->pool=pool;
+  batch->packets=g_new0(PACKET *,size);
+  batch->discard=g_new0(unsigned char,pool->buffer_size);
+  batch->dropped=0;
+  batch->msgs=g_new0(struct mmsghdr,size);
+  batch->iovecs=g_new0(struct iovec,size);
+  batch->addrs=g_new0(struct sockaddr_in,size);
+
+  for(i=0;i<size;i++) {
+    batch->iovecs[i].iov_len=pool->buffer_size;
+    batch->msgs[i].msg_hdr.msg_iov=&batch->iovecs[i];
+    batch->msgs[i].msg_hdr.msg_iovlen=1;
+    batch->msgs[i].msg_hdr.msg_name=&batch->addrs[i];
+    batch->msgs[i].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+  }
+  return batch;
+}
+
+void udp_batch_free(UDP_BATCH *batch) {
+  int i;
+  if(batch==NULL) return;
+  for(i=0;i<batch->size;i++) {
+    packet_pool_release(batch->pool,batch->packets[i]);
+  }
+  g_free(batch->packets);
+  g_free(batch->discard);
+  g_free(batch->msgs);
+  g_free(batch->iovecs);
+  g_free(batch->addrs);
+  g_free(batch);
+}
+
+//
+// refill the slots handed out last time
+// returns the number of leading slots that have a buffer
+//
+int udp_batch_refill(UDP_BATCH *batch) {
+  int slots;
+
+  for(slots=0;slots<batch->size;slots++) {
+    if(batch->packets[slots]==NULL) {
+      batch->packets[slots]=packet_pool_get(batch->pool);
+      if(batch->packets[slots]==NULL) break;
+      batch->iovecs[slots].iov_base=batch->packets[slots]->buffer;
+    }
+    // the kernel updates msg_namelen so reset it each time
+    batch->msgs[slots].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+  }
+  return slots;
+}
+
+//
+// block until at least one datagram arrives and then take whatever else
+// is already queued on the socket, up to the batch size
+// returns the number of datagrams received or -1 on error (errno is set)
+//
+int udp_batch_receive(int socket,UDP_BATCH *batch) {
+  int i;
+  int slots;
+  int rc;
+
+  slots=udp_batch_refill(batch);
+  if(slots==0) {
+    // pool exhausted: keep the socket drained but drop the datagram
+    batch->iovecs[0].iov_base=batch->discard;
+    batch->msgs[0].msg_hdr.msg_namelen=sizeof(struct sockaddr_in);
+    rc=recvmmsg(socket,batch->msgs,1,0,NULL);
+    batch->count=0;
+    if(rc<0) return -1;
+    batch->dropped++;
+    return 0;
+  }
+
+  rc=recvmmsg(socket,batch->msgs,slots,MSG_WAITFORONE,NULL);
+  if(rc<0) {
+    batch->count=0;
+    return -1;
+  }
+  for(i=0;i<rc;i++) {
+    batch->packets[i]->length=batch->msgs[i].msg_len;
+    batch->packets[i]->port=ntohs(batch->addrs[i].sin_port);
+  }
+  batch->count=rc;
+  return rc;
+}
+
+//
+// hand datagram i of the last batch to the caller
+//
+PACKET *udp_batch_take(UDP_BATCH *batch,int i) {
+  PACKET *packet=batch->packets[i];
+  batch->packets[i]=NULL;
+  return packet;
+}
+
+void udp_set_receive_buffer(int socket,int size) {
+  int actual;
+  socklen_t length=sizeof(actual);
+
+  if(size<=0) return;
+  if(setsockopt(socket,SOL_SOCKET,SO_RCVBUF,&size,sizeof(size))<0) {
+    perror("udp_set_receive_buffer: SO_RCVBUF");
+    return;
+  }
+  if(getsockopt(socket,SOL_SOCKET,SO_RCVBUF,&actual,&length)==0) {
+    // linux doubles the requested value and caps it at net.core.rmem_max
+    if(actual<size) {
+      fprintf(stderr,"udp_set_receive_buffer: requested %d got %d (check net.core.rmem_max)\n",size,actual);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "packet_pool.h"
+
+#define DEFAULT_UDP_BATCH_SIZE 32
+#define MAX_UDP_BATCH_SIZE 256
+#define DEFAULT_UDP_RECEIVE_BUFFER (4*1024*1024)
+
+//
+// a set of datagram slots filled with a single recvmmsg call
+// the buffers come from a PACKET_POOL and are handed to the caller with
+// udp_batch_take(), which must give them back with packet_pool_release()
+//
+typedef struct _udp_batch {
+  int size;
+  int count;
+  PACKET_POOL *pool;
+  PACKET **packets;
+  unsigned char *discard;
+  long dropped;
+  struct mmsghdr *msgs;
+  struct iovec *iovecs;
+  struct sockaddr_in *addrs;
+} UDP_BATCH;
+
+extern UDP_BATCH *udp_batch_new(int size,PACKET_POOL *pool);
+extern void udp_batch_free(UDP_BATCH *batch);
+extern int udp_batch_refill(UDP_BATCH *batch);
+extern int udp_batch_receive(int socket,UDP_BATCH *batch);
+extern PACKET *udp_batch_take(UDP_BATCH *batch,int i);
+extern void udp_set_receive_buffer(int socket,int size);
+
+#endif
@@ -29,32 +29,28 @@
 #include "transmitter.h"
 #include "radio.h"
 #include "waterfall.h"
+#include "trace_decimate.h"
 #include "main.h"
 
-static int colorLowR=0; // black
-static int colorLowG=0;
-static int colorLowB=0;
-
-static int colorHighR=255; // yellow
-static int colorHighG=255;
-static int colorHighB=0;
-
 static gboolean resize_timeout(void *data) {
   RECEIVER *rx=(RECEIVER *)data;
+  g_mutex_lock(&rx->surface_mutex);
   rx->waterfall_width=rx->waterfall_resize_width;
   rx->waterfall_height=rx->waterfall_resize_height;
-  if(rx->waterfall_pixbuf) {
-    g_object_unref((gpointer)rx->waterfall_pixbuf);
-    rx->waterfall_pixbuf=NULL;
+  if(rx->waterfall_surface) {
+    cairo_surface_destroy(rx->waterfall_surface);
+    rx->waterfall_surface=NULL;
   }
   if(rx->waterfall!=NULL) {
-    rx->waterfall_pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, rx->waterfall_width, rx->waterfall_height);
-    guchar *pixels = gdk_pixbuf_get_pixels (rx->waterfall_pixbuf);
-    memset(pixels, 0, rx->waterfall_width*rx->waterfall_height*3);
+    // native 32 bit pixels (starts all black) so an expose is a plain blit
+    rx->waterfall_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, rx->waterfall_width, rx->waterfall_height);
   }
+  rx->waterfall_head=0;
+  rx->waterfall_offset=0;
   rx->waterfall_frequency=0;
   rx->waterfall_sample_rate=0;
   rx->waterfall_resize_timer=-1;
+  g_mutex_unlock(&rx->surface_mutex);
   return FALSE;
 }
 
@@ -75,10 +71,15 @@ static gboolean waterfall_configure_event_cb(GtkWidget *widget,GdkEventConfigure
 
 static gboolean waterfall_draw_cb(GtkWidget *widget,cairo_t *cr,gpointer data) {
   RECEIVER *rx=(RECEIVER *)data;
-  if(rx->waterfall_pixbuf) {
-    gdk_cairo_set_source_pixbuf (cr, rx->waterfall_pixbuf, 0, 0);
+  g_mutex_lock(&rx->surface_mutex);
+  if(rx->waterfall_surface) {
+    // repeating the ring puts the newest line at the top and wraps both
+    // the rows and the columns back into place in one paint
+    cairo_set_source_surface (cr, rx->waterfall_surface, -rx->waterfall_offset, -rx->waterfall_head);
+    cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_REPEAT);
     cairo_paint (cr);
   }
+  g_mutex_unlock(&rx->surface_mutex);
   return FALSE;
 }
 
@@ -89,7 +90,9 @@ GtkWidget *create_waterfall(RECEIVER *rx) {
   rx->waterfall_width=0;
   rx->waterfall_height=0;
   rx->waterfall_resize_timer=-1;
-  rx->waterfall_pixbuf=NULL;
+  rx->waterfall_surface=NULL;
+  rx->waterfall_head=0;
+  rx->waterfall_offset=0;
 
   waterfall = gtk_drawing_area_new ();
   //gtk_widget_set_size_request (waterfall, rx->width, rx->height/3);
@@ -113,125 +116,110 @@ GtkWidget *create_waterfall(RECEIVER *rx) {
   return waterfall;
 }
 
-void update_waterfall(RECEIVER *rx) {
+//
+// clear display columns first..first+count-1 of every line
+//
+static void clear_columns(RECEIVER *rx,guchar *pixels,int width,int height,int stride,int first,int count) {
   int i;
-  float *samples;
+  int column=(first+rx->waterfall_offset)%width;
+  int right=count;
+  if(column+right>width) {
+    right=width-column;
+  }
+  for(i=0;i<height;i++) {
+    guint32 *row=(guint32 *)&pixels[i*stride];
+    memset(&row[column], 0, right*sizeof(guint32));
+    if(right<count) {
+      memset(row, 0, (count-right)*sizeof(guint32));
+    }
+  }
+}
 
-  if(rx->waterfall_pixbuf && rx->waterfall_height>1) {
-    guchar *pixels = gdk_pixbuf_get_pixels (rx->waterfall_pixbuf);
+void update_waterfall(RECEIVER *rx,RENDER_VIEW *view) {
+  int i;
+  float *samples;
 
-    int width=gdk_pixbuf_get_width(rx->waterfall_pixbuf);
-    int height=gdk_pixbuf_get_height(rx->waterfall_pixbuf);
-    int rowstride=gdk_pixbuf_get_rowstride(rx->waterfall_pixbuf);
+  // may run on the render worker, the surface and the ring position are
+  // only changed with surface_mutex held so the draw callback sees a
+  // whole line
+  g_mutex_lock(&rx->surface_mutex);
+  if(rx->waterfall_surface && rx->waterfall_height>1) {
+    cairo_surface_flush(rx->waterfall_surface);
+    guchar *pixels = cairo_image_surface_get_data (rx->waterfall_surface);
+
+    int width=cairo_image_surface_get_width(rx->waterfall_surface);
+    int height=cairo_image_surface_get_height(rx->waterfall_surface);
+    int stride=cairo_image_surface_get_stride(rx->waterfall_surface);
+    gboolean blank=FALSE;
+    gboolean shifted=FALSE;
     
-    if(rx->waterfall_frequency!=0 && (rx->sample_rate==rx->waterfall_sample_rate)) {
-      if(rx->waterfall_frequency!=rx->frequency_a) {
+    if(rx->waterfall_frequency!=0 && (view->sample_rate==rx->waterfall_sample_rate)) {
+      if(rx->waterfall_frequency!=view->frequency_a) {
         // scrolled or band change
-        long long half=((long long)(rx->sample_rate/2))/(rx->zoom);      
-        if(rx->waterfall_frequency<(rx->frequency_a-half) || rx->waterfall_frequency>(rx->frequency_a+half)) {
+        long long half=((long long)(view->sample_rate/2))/(view->zoom);      
+        if(rx->waterfall_frequency<(view->frequency_a-half) || rx->waterfall_frequency>(view->frequency_a+half)) {
           // outside of the range - blank waterfall
-          memset(pixels, 0, width*height*3);
+          blank=TRUE;
         } else {
-          // rotate waterfall
-          gint64 diff=rx->waterfall_frequency-rx->frequency_a;
-          int rotate_pixels=(int)((double)diff/rx->hz_per_pixel);
-          if(rotate_pixels<0) {
-            memmove(pixels,&pixels[-rotate_pixels*3],((width*height)+rotate_pixels)*3);
-            //now clear the right hand side
-            for(i=0;i<height;i++) {
-              memset(&pixels[((i*width)+(width+rotate_pixels))*3], 0, -rotate_pixels*3);
-            }
+          // shift waterfall by moving column 0, only the uncovered columns are cleared
+          gint64 diff=rx->waterfall_frequency-view->frequency_a;
+          int rotate_pixels=(int)((double)diff/view->hz_per_pixel);
+          if(rotate_pixels>=width || rotate_pixels<=-width) {
+            blank=TRUE;
           } else {
-            memmove(&pixels[rotate_pixels*3],pixels,((width*height)-rotate_pixels)*3);
-            //now clear the left hand side
-            for(i=0;i<height;i++) {
-              memset(&pixels[(i*width)*3], 0, rotate_pixels*3);
+            rx->waterfall_offset=(rx->waterfall_offset-rotate_pixels+width)%width;
+            if(rotate_pixels<0) {
+              //now clear the right hand side
+              clear_columns(rx,pixels,width,height,stride,width+rotate_pixels,-rotate_pixels);
+            } else if(rotate_pixels>0) {
+              //now clear the left hand side
+              clear_columns(rx,pixels,width,height,stride,0,rotate_pixels);
             }
+            shifted=rotate_pixels!=0;
           }
         }
       }
     } else {
-      memset(pixels, 0, width*height*3);
+      blank=TRUE;
     }
 
-    rx->waterfall_frequency=rx->frequency_a;
-    rx->waterfall_sample_rate=rx->sample_rate;
-
-    memmove(&pixels[rowstride],pixels,(height-1)*rowstride);
-
-    float sample;
-    int average=0;
-    guchar *p;
-    p=pixels;
-    samples=rx->pixel_samples;
-    //int offset=((rx->zoom-1)/2)*rx->panadapter_width;
-    int offset=rx->pan;
-    for(i=0;i<width;i++) {
-            sample=samples[i+offset]+radio->adc[rx->adc].attenuation;
-            if(i>1 || i<(width-1)) {
-              average+=(int)sample;
-            }
-            if(sample<(float)rx->waterfall_low) {
-                *p++=colorLowR;
-                *p++=colorLowG;
-                *p++=colorLowB;
-            } else if(sample>(float)rx->waterfall_high) {
-                *p++=colorHighR;
-                *p++=colorHighG;
-                *p++=colorHighB;
-            } else {
-                float range=(float)rx->waterfall_high-(float)rx->waterfall_low;
-                float offset=sample-(float)rx->waterfall_low;
-                float percent=offset/range;
-                if(percent<(2.0f/9.0f)) {
-                    float local_percent = percent / (2.0f/9.0f);
-                    *p++ = (int)((1.0f-local_percent)*colorLowR);
-                    *p++ = (int)((1.0f-local_percent)*colorLowG);
-                    *p++ = (int)(colorLowB + local_percent*(255-colorLowB));
-                } else if(percent<(3.0f/9.0f)) {
-                    float local_percent = (percent - 2.0f/9.0f) / (1.0f/9.0f);
-                    *p++ = 0;
-                    *p++ = (int)(local_percent*255);
-                    *p++ = (char)255;
-                } else if(percent<(4.0f/9.0f)) {
-                     float local_percent = (percent - 3.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = 0;
-                     *p++ = (char)255;
-                     *p++ = (int)((1.0f-local_percent)*255);
-                } else if(percent<(5.0f/9.0f)) {
-                     float local_percent = (percent - 4.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = (int)(local_percent*255);
-                     *p++ = (char)255;
-                     *p++ = 0;
-                } else if(percent<(7.0f/9.0f)) {
-                     float local_percent = (percent - 5.0f/9.0f) / (2.0f/9.0f);
-                     *p++ = (char)255;
-                     *p++ = (int)((1.0f-local_percent)*255);
-                     *p++ = 0;
-                } else if(percent<(8.0f/9.0f)) {
-                     float local_percent = (percent - 7.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = (char)255;
-                     *p++ = 0;
-                     *p++ = (int)(local_percent*255);
-                } else {
-                     float local_percent = (percent - 8.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = (int)((0.75f + 0.25f*(1.0f-local_percent))*255.0f);
-                     *p++ = (int)(local_percent*255.0f*0.5f);
-                     *p++ = (char)255;
-                }
-            }
+    if(blank) {
+      memset(pixels, 0, height*stride);
+      rx->waterfall_offset=0;
+    }
+
+    rx->waterfall_frequency=view->frequency_a;
+    rx->waterfall_sample_rate=view->sample_rate;
+
+    // the new line replaces the oldest one
+    rx->waterfall_head=(rx->waterfall_head+height-1)%height;
+    guint32 *row=(guint32 *)&pixels[rx->waterfall_head*stride];
+
+    int average;
+    samples=&rx->pixel_samples[view->pan*view->pixel_oversample];
+    if(view->pixel_oversample>1) {
+      // one value per column, the strongest so narrow carriers still show
+      if(rx->waterfall_columns!=width) {
+        g_free(rx->waterfall_samples);
+        rx->waterfall_samples=g_new0(gfloat,width);
+        rx->waterfall_columns=width;
+      }
+      trace_decimate(samples,width*view->pixel_oversample,width,NULL,rx->waterfall_samples,NULL);
+      samples=rx->waterfall_samples;
     }
+    float attenuation=(float)radio->adc[rx->adc].attenuation;
+    int right=width-rx->waterfall_offset;
+    waterfall_palette_update(&rx->waterfall_lut,view->waterfall_palette,view->waterfall_low,view->waterfall_high);
+    average=waterfall_palette_row(&rx->waterfall_lut,samples,right,attenuation,(float)view->waterfall_low,&row[rx->waterfall_offset]);
+    average+=waterfall_palette_row(&rx->waterfall_lut,&samples[right],width-right,attenuation,(float)view->waterfall_low,row);
 
-    if(rx->waterfall_ft8_marker) {
+    if(view->waterfall_ft8_marker) {
         static int tim0=0;
         int tim=time(NULL);
         if(tim%15==0) {
           if(tim0==0) {
-            p=pixels;
             for(i=0;i<width;i++) {
-              *p++=(char)255;
-              *p++=0;
-              *p++=0;
+              row[i]=0xFFFF0000; // red
             }
             tim0=1;
           }
@@ -240,11 +228,18 @@ void update_waterfall(RECEIVER *rx) {
         }
     } 
 
-    if(rx->waterfall_automatic) {
-      rx->waterfall_low=(average/(width-2))-14;
-      rx->waterfall_high=rx->waterfall_low+80;
+    if(view->waterfall_automatic) {
+      // handed back to rx under rx->mutex with the next view
+      view->waterfall_low=(average/(width-2))-14;
+      view->waterfall_high=view->waterfall_low+80;
+      view->waterfall_levels=TRUE;
     }
 
-    gtk_widget_queue_draw (rx->waterfall);
+    if(blank || shifted) {
+      cairo_surface_mark_dirty(rx->waterfall_surface);
+    } else {
+      cairo_surface_mark_dirty_rectangle(rx->waterfall_surface,0,rx->waterfall_head,width,1);
+    }
   }
+  g_mutex_unlock(&rx->surface_mutex);
 }
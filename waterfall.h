@@ -18,4 +18,4 @@
 */
 
 extern GtkWidget *create_waterfall(RECEIVER *rx);
-extern void update_waterfall(RECEIVER *rx);
+extern void update_waterfall(RECEIVER *rx,RENDER_VIEW *view);
@@ -0,0 +1,194 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#include <glib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "waterfall_palette.h"
+
+const char *palette_names[PALETTES]={
+  "Default",
+  "Grayscale",
+  "Hot",
+  "Blue"
+};
+
+typedef struct _palette_stop {
+  float percent;
+  guchar r,g,b;
+} PALETTE_STOP;
+
+static const PALETTE_STOP grayscale_stops[]={
+  {0.0f,0,0,0},
+  {1.0f,255,255,255}
+};
+
+static const PALETTE_STOP hot_stops[]={
+  {0.0f,0,0,0},
+  {0.4f,255,0,0},
+  {0.8f,255,255,0},
+  {1.0f,255,255,255}
+};
+
+static const PALETTE_STOP blue_stops[]={
+  {0.0f,0,0,0},
+  {0.5f,0,0,255},
+  {0.8f,0,255,255},
+  {1.0f,255,255,255}
+};
+
+static guint32 rgb(int r,int g,int b) {
+  return 0xFF000000 | ((guint32)(r&0xFF)<<16) | ((guint32)(g&0xFF)<<8) | (guint32)(b&0xFF);
+}
+
+//
+// the original linhpsdr gradient, black to blue, cyan, green, yellow, red,
+// magenta and then towards white
+//
+static guint32 default_colour(float percent) {
+  if(percent<(2.0f/9.0f)) {
+    float local_percent = percent / (2.0f/9.0f);
+    return rgb(0,0,(int)(local_percent*255));
+  } else if(percent<(3.0f/9.0f)) {
+    float local_percent = (percent - 2.0f/9.0f) / (1.0f/9.0f);
+    return rgb(0,(int)(local_percent*255),255);
+  } else if(percent<(4.0f/9.0f)) {
+    float local_percent = (percent - 3.0f/9.0f) / (1.0f/9.0f);
+    return rgb(0,255,(int)((1.0f-local_percent)*255));
+  } else if(percent<(5.0f/9.0f)) {
+    float local_percent = (percent - 4.0f/9.0f) / (1.0f/9.0f);
+    return rgb((int)(local_percent*255),255,0);
+  } else if(percent<(7.0f/9.0f)) {
+    float local_percent = (percent - 5.0f/9.0f) / (2.0f/9.0f);
+    return rgb(255,(int)((1.0f-local_percent)*255),0);
+  } else if(percent<(8.0f/9.0f)) {
+    float local_percent = (percent - 7.0f/9.0f) / (1.0f/9.0f);
+    return rgb(255,0,(int)(local_percent*255));
+  }
+  float local_percent = (percent - 8.0f/9.0f) / (1.0f/9.0f);
+  return rgb((int)((0.75f + 0.25f*(1.0f-local_percent))*255.0f),(int)(local_percent*255.0f*0.5f),255);
+}
+
+static guint32 stops_colour(const PALETTE_STOP *stops,int n,float percent) {
+  int i;
+  for(i=1;i<n-1 && percent>stops[i].percent;i++);
+  float local_percent=(percent-stops[i-1].percent)/(stops[i].percent-stops[i-1].percent);
+  return rgb((int)(stops[i-1].r+local_percent*(stops[i].r-stops[i-1].r)),
+             (int)(stops[i-1].g+local_percent*(stops[i].g-stops[i-1].g)),
+             (int)(stops[i-1].b+local_percent*(stops[i].b-stops[i-1].b)));
+}
+
+void waterfall_palette_init(WATERFALL_PALETTE *lut) {
+  lut->palette=-1;
+  lut->range=0;
+  lut->scale=0.0f;
+}
+
+//
+// rebuild the table if the palette or the level range has changed
+//
+void waterfall_palette_update(WATERFALL_PALETTE *lut,int palette,int low,int high) {
+  int i;
+  int range=high-low;
+  if(range<1) range=1;
+  if(palette<0 || palette>=PALETTES) palette=PALETTE_DEFAULT;
+  if(lut->palette==palette && lut->range==range) return;
+
+  for(i=0;i<WATERFALL_PALETTE_SIZE;i++) {
+    float percent=(float)i/(float)(WATERFALL_PALETTE_SIZE-1);
+    switch(palette) {
+      case PALETTE_GRAYSCALE:
+        lut->table[i+1]=stops_colour(grayscale_stops,G_N_ELEMENTS(grayscale_stops),percent);
+        break;
+      case PALETTE_HOT:
+        lut->table[i+1]=stops_colour(hot_stops,G_N_ELEMENTS(hot_stops),percent);
+        break;
+      case PALETTE_BLUE:
+        lut->table[i+1]=stops_colour(blue_stops,G_N_ELEMENTS(blue_stops),percent);
+        break;
+      default:
+        lut->table[i+1]=default_colour(percent);
+        break;
+    }
+  }
+  if(palette==PALETTE_DEFAULT) {
+    lut->table[0]=rgb(0,0,0); // black
+    lut->table[WATERFALL_PALETTE_SIZE+1]=rgb(255,255,0); // yellow
+  } else {
+    lut->table[0]=lut->table[1];
+    lut->table[WATERFALL_PALETTE_SIZE+1]=lut->table[WATERFALL_PALETTE_SIZE];
+  }
+  lut->palette=palette;
+  lut->range=range;
+  lut->scale=(float)(WATERFALL_PALETTE_SIZE-1)/(float)range;
+}
+
+//
+// map count samples (dBm, plus bias) to pixels at dst through the table
+// levels between low and low+range index the gradient, anything outside
+// gets the below/above entries
+// returns the sum of the truncated levels for the automatic waterfall levels
+//
+gint waterfall_palette_row(const WATERFALL_PALETTE *lut,const float *samples,int count,float bias,float low,guint32 *dst) {
+  const float top=(float)WATERFALL_PALETTE_SIZE;
+  const float high=low+(float)lut->range;
+  gint sum=0;
+  int i=0;
+
+#ifdef __SSE2__
+  __m128 vbias=_mm_set1_ps(bias);
+  __m128 vlow=_mm_set1_ps(low);
+  __m128 vscale=_mm_set1_ps(lut->scale);
+  __m128 vone=_mm_set1_ps(1.0f);
+  __m128 vzero=_mm_setzero_ps();
+  __m128 vtop=_mm_set1_ps(top);
+  __m128 vhigh=_mm_set1_ps(high);
+  __m128i vabove=_mm_set1_epi32(WATERFALL_PALETTE_SIZE+1);
+  __m128i vsum=_mm_setzero_si128();
+  gint32 index[4] __attribute__((aligned(16)));
+  gint32 sums[4] __attribute__((aligned(16)));
+
+  for(;i+4<=count;i+=4) {
+    __m128 s=_mm_add_ps(_mm_loadu_ps(&samples[i]),vbias);
+    vsum=_mm_add_epi32(vsum,_mm_cvttps_epi32(s));
+    __m128 f=_mm_add_ps(_mm_mul_ps(_mm_sub_ps(s,vlow),vscale),vone);
+    // NaN fails max and becomes 0
+    f=_mm_min_ps(_mm_max_ps(f,vzero),vtop);
+    __m128i above=_mm_castps_si128(_mm_cmpgt_ps(s,vhigh));
+    __m128i idx=_mm_or_si128(_mm_andnot_si128(above,_mm_cvttps_epi32(f)),_mm_and_si128(above,vabove));
+    _mm_store_si128((__m128i *)index,idx);
+    _mm_storeu_si128((__m128i *)&dst[i],_mm_set_epi32(lut->table[index[3]],lut->table[index[2]],lut->table[index[1]],lut->table[index[0]]));
+  }
+  _mm_store_si128((__m128i *)sums,vsum);
+  sum=sums[0]+sums[1]+sums[2]+sums[3];
+#endif
+
+  for(;i<count;i++) {
+    float s=samples[i]+bias;
+    sum+=(int)s;
+    float f=((s-low)*lut->scale)+1.0f;
+    if(!(f>0.0f)) f=0.0f;
+    if(f>top) f=top;
+    dst[i]=lut->table[s>high?WATERFALL_PALETTE_SIZE+1:(int)f];
+  }
+  return sum;
+}
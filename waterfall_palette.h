@@ -0,0 +1,55 @@
+/* Copyright (C)
+* 2018 - John Melton, G0ORX/N6LYT
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+*/
+
+
+#ifndef WATERFALL_PALETTE_H
+#define WATERFALL_PALETTE_H
+
+#define WATERFALL_PALETTE_SIZE 1024
+
+enum {
+  PALETTE_DEFAULT=0,
+  PALETTE_GRAYSCALE,
+  PALETTE_HOT,
+  PALETTE_BLUE,
+  PALETTES
+};
+
+extern const char *palette_names[PALETTES];
+
+//
+// colour lookup table for one waterfall, entries are native cairo 32 bit
+// pixels 0xFFRRGGBB so a row can be written straight into an image surface
+// [0] is below the low level, [1..WATERFALL_PALETTE_SIZE] is the gradient
+// from low to high and [WATERFALL_PALETTE_SIZE+1] is above the high level
+// the table only depends on the palette and high-low, so automatic levels
+// moving up and down do not rebuild it
+//
+typedef struct _waterfall_palette {
+  gint palette;
+  gint range;
+  gfloat scale;
+  guint32 table[WATERFALL_PALETTE_SIZE+2];
+} WATERFALL_PALETTE;
+
+extern void waterfall_palette_init(WATERFALL_PALETTE *lut);
+extern void waterfall_palette_update(WATERFALL_PALETTE *lut,int palette,int low,int high);
+extern gint waterfall_palette_row(const WATERFALL_PALETTE *lut,const float *samples,int count,float bias,float low,guint32 *dst);
+
+#endif
@@ -322,6 +322,7 @@ g_print("create_wideband: channel=%d\n",channel);
   w->waterfall_high=0;
   w->waterfall_low=-140;
   w->waterfall_automatic=TRUE;
+  waterfall_palette_init(&w->waterfall_lut);
 
   wideband_restore_state(w);
 
@@ -20,6 +20,8 @@
 #ifndef WIDEBAND_H
 #define WIDEBAND_H
 
+#include "waterfall_palette.h"
+
 typedef struct _wideband {
   gint channel; // WDSP channel
   gint adc;
@@ -52,6 +54,14 @@ typedef struct _wideband {
   gint panadapter_resize_height;
   guint panadapter_resize_timer;
   cairo_surface_t *panadapter_surface;
+  // grid, labels and cursor, redrawn only when one of the static_ values
+  // it was drawn for changes
+  cairo_surface_t *panadapter_static;
+  gint static_width;
+  gint static_height;
+  gint static_low;
+  gint static_high;
+  gint64 static_cursor;
 
   gint panadapter_low;
   gint panadapter_high;
@@ -62,11 +72,13 @@ typedef struct _wideband {
   gint waterfall_resize_width;
   gint waterfall_resize_height;
   guint waterfall_resize_timer;
-  GdkPixbuf *waterfall_pixbuf;
+  cairo_surface_t *waterfall_surface;
+  gint waterfall_head;
 
   gint waterfall_low;
   gint waterfall_high;
   gboolean waterfall_automatic;
+  WATERFALL_PALETTE waterfall_lut;
   gint64 waterfall_frequency;
   gint waterfall_sample_rate;
   
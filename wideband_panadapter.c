@@ -54,6 +54,10 @@ static gboolean resize_timeout(void *data) {
   if (w->panadapter_surface) {
     cairo_surface_destroy (w->panadapter_surface);
   }
+  if (w->panadapter_static) {
+    cairo_surface_destroy (w->panadapter_static);
+    w->panadapter_static=NULL;
+  }
 
   if(w->panadapter!=NULL) {
     w->panadapter_surface = gdk_window_create_similar_surface (gtk_widget_get_window (w->panadapter),
@@ -121,6 +125,7 @@ GtkWidget *create_wideband_panadapter(WIDEBAND *w) {
   w->panadapter_width=0;
   w->panadapter_height=0;
   w->panadapter_surface=NULL;
+  w->panadapter_static=NULL;
   w->panadapter_resize_timer=-1;
 
   panadapter = gtk_drawing_area_new ();
@@ -144,24 +149,22 @@ GtkWidget *create_wideband_panadapter(WIDEBAND *w) {
   return panadapter;
 }
 
-void update_wideband_panadapter(WIDEBAND *w) {
+// The background is drawn at half alpha, which lets the previous trace fade
+// out rather than vanish. The static layer therefore keeps an alpha channel
+// and is painted over the last frame instead of copied.
+static void draw_wideband_layer(WIDEBAND *w,int display_height,gint64 cursor) {
   long i;
-  float *samples;
   cairo_text_extents_t extents;
   gdouble hz_per_pixel;
   gdouble x;
 
-  int display_height=gtk_widget_get_allocated_height (w->panadapter);
-
-  if(display_height<=1) return;
-
   hz_per_pixel=(gdouble)61440000/(gdouble)w->pixels;
-    
-  samples=w->pixel_samples;
 
-  //clear_panadater_surface();
   cairo_t *cr;
-  cr = cairo_create (w->panadapter_surface);
+  cr = cairo_create (w->panadapter_static);
+  cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
   cairo_set_line_width(cr, 1.0);
 #ifdef GRADIANT
     cairo_pattern_t *pat=cairo_pattern_create_linear(0.0,0.0,0.0,w->panadapter_height);
@@ -220,15 +223,55 @@ void update_wideband_panadapter(WIDEBAND *w) {
   cairo_stroke(cr);
 
   // cursor
-  if(radio->active_receiver!=NULL) {
+  if(cursor>=0) {
     cairo_set_source_rgb (cr, 1.0, 0.0, 0.0);
     cairo_set_line_width(cr, 1.0);
-    x=(gdouble)radio->active_receiver->frequency_a/hz_per_pixel;
+    x=(gdouble)cursor/hz_per_pixel;
     cairo_move_to(cr,x,0.0);
     cairo_line_to(cr,x,(double)display_height);
     cairo_stroke(cr);
   }
 
+  cairo_destroy (cr);
+}
+
+void update_wideband_panadapter(WIDEBAND *w) {
+  long i;
+  float *samples;
+
+  int display_height=gtk_widget_get_allocated_height (w->panadapter);
+
+  if(display_height<=1 || w->panadapter_surface==NULL) return;
+
+  samples=w->pixel_samples;
+
+  // resize_timeout drops the layer along with panadapter_surface
+  gint64 cursor=radio->active_receiver!=NULL?radio->active_receiver->frequency_a:-1;
+  if(w->panadapter_static==NULL) {
+    w->panadapter_static=cairo_surface_create_similar(w->panadapter_surface,
+                                       CAIRO_CONTENT_COLOR_ALPHA,
+                                       w->panadapter_width,
+                                       w->panadapter_height);
+    w->static_width=-1;
+  }
+  if(w->static_width!=w->panadapter_width || w->static_height!=display_height ||
+     w->static_low!=w->panadapter_low || w->static_high!=w->panadapter_high ||
+     w->static_cursor!=cursor) {
+    draw_wideband_layer(w,display_height,cursor);
+    w->static_width=w->panadapter_width;
+    w->static_height=display_height;
+    w->static_low=w->panadapter_low;
+    w->static_high=w->panadapter_high;
+    w->static_cursor=cursor;
+  }
+
+  //clear_panadater_surface();
+  cairo_t *cr;
+  cr = cairo_create (w->panadapter_surface);
+  cairo_set_source_surface (cr, w->panadapter_static, 0.0, 0.0);
+  cairo_paint (cr);
+  cairo_set_line_width(cr, 1.0);
+
   // signal
   double s1,s2;
   samples[w->pixels]=-200.0;
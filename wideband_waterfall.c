@@ -23,30 +23,21 @@
 #include "wideband.h"
 #include "wideband_waterfall.h"
 
-static int colorLowR=0; // black
-static int colorLowG=0;
-static int colorLowB=0;
-
-static int colorHighR=255; // yellow
-static int colorHighG=255;
-static int colorHighB=0;
-
 static gboolean resize_timeout(void *data) {
   WIDEBAND *w=(WIDEBAND *)data;
 
   w->waterfall_width=w->waterfall_resize_width;
   w->waterfall_height=w->waterfall_resize_height;
 
-  if(w->waterfall_pixbuf) {
-    g_object_unref((gpointer)w->waterfall_pixbuf);
-    w->waterfall_pixbuf=NULL;
+  if(w->waterfall_surface) {
+    cairo_surface_destroy(w->waterfall_surface);
+    w->waterfall_surface=NULL;
   }
 
   if(w->waterfall!=NULL) {
-    w->waterfall_pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, w->waterfall_width, w->waterfall_height);
-    guchar *pixels = gdk_pixbuf_get_pixels (w->waterfall_pixbuf);
-    memset(pixels, 0, w->waterfall_width*w->waterfall_height*3);
+    w->waterfall_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w->waterfall_width, w->waterfall_height);
   }
+  w->waterfall_head=0;
   w->waterfall_frequency=0;
   w->waterfall_sample_rate=0;
   w->waterfall_resize_timer=-1;
@@ -71,8 +62,10 @@ static gboolean waterfall_configure_event_cb(GtkWidget *widget,GdkEventConfigure
 
 static gboolean waterfall_draw_cb(GtkWidget *widget,cairo_t *cr,gpointer data) {
   WIDEBAND *w=(WIDEBAND *)data;
-  if(w->waterfall_pixbuf) {
-    gdk_cairo_set_source_pixbuf (cr, w->waterfall_pixbuf, 0, 0);
+  if(w->waterfall_surface) {
+    // newest line is row waterfall_head, repeat the surface to wrap the rest
+    cairo_set_source_surface (cr, w->waterfall_surface, 0, -w->waterfall_head);
+    cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_REPEAT);
     cairo_paint (cr);
   }
   return FALSE;
@@ -84,7 +77,8 @@ GtkWidget *create_wideband_waterfall(WIDEBAND *w) {
   w->waterfall_width=0;
   w->waterfall_height=0;
   w->waterfall_resize_timer=-1;
-  w->waterfall_pixbuf=NULL;
+  w->waterfall_surface=NULL;
+  w->waterfall_head=0;
 
   waterfall = gtk_drawing_area_new ();
   //gtk_widget_set_size_request (waterfall, w->width, w->height/3);
@@ -109,87 +103,30 @@ GtkWidget *create_wideband_waterfall(WIDEBAND *w) {
 }
 
 void update_wideband_waterfall(WIDEBAND *w) {
-  int i;
-
-  float *samples;
-  if(w->waterfall_pixbuf && w->waterfall_height>1) {
-    guchar *pixels = gdk_pixbuf_get_pixels (w->waterfall_pixbuf);
-
-    int width=gdk_pixbuf_get_width(w->waterfall_pixbuf);
-    int height=gdk_pixbuf_get_height(w->waterfall_pixbuf);
-    int rowstride=gdk_pixbuf_get_rowstride(w->waterfall_pixbuf);
-
-    //memset(pixels, 0, width*height*3);
-
-    memmove(&pixels[rowstride],pixels,(height-1)*rowstride);
-
-    float sample;
-    int average=0;
-    guchar *p;
-    p=pixels;
-    samples=w->pixel_samples;
-    for(i=0;i<w->pixels;i++) {
-            sample=samples[i+w->pixels];
-            if(i>0 || i<(w->pixels-1)) {
-                average+=(int)sample;
-            }
-            if(sample<(float)w->waterfall_low) {
-                *p++=colorLowR;
-                *p++=colorLowG;
-                *p++=colorLowB;
-            } else if(sample>(float)w->waterfall_high) {
-                *p++=colorHighR;
-                *p++=colorHighG;
-                *p++=colorHighB;
-            } else {
-                float range=(float)w->waterfall_high-(float)w->waterfall_low;
-                float offset=sample-(float)w->waterfall_low;
-                float percent=offset/range;
-                if(percent<(2.0f/9.0f)) {
-                    float local_percent = percent / (2.0f/9.0f);
-                    *p++ = (int)((1.0f-local_percent)*colorLowR);
-                    *p++ = (int)((1.0f-local_percent)*colorLowG);
-                    *p++ = (int)(colorLowB + local_percent*(255-colorLowB));
-                } else if(percent<(3.0f/9.0f)) {
-                    float local_percent = (percent - 2.0f/9.0f) / (1.0f/9.0f);
-                    *p++ = 0;
-                    *p++ = (int)(local_percent*255);
-                    *p++ = (char)255;
-                } else if(percent<(4.0f/9.0f)) {
-                     float local_percent = (percent - 3.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = 0;
-                     *p++ = (char)255;
-                     *p++ = (int)((1.0f-local_percent)*255);
-                } else if(percent<(5.0f/9.0f)) {
-                     float local_percent = (percent - 4.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = (int)(local_percent*255);
-                     *p++ = (char)255;
-                     *p++ = 0;
-                } else if(percent<(7.0f/9.0f)) {
-                     float local_percent = (percent - 5.0f/9.0f) / (2.0f/9.0f);
-                     *p++ = (char)255;
-                     *p++ = (int)((1.0f-local_percent)*255);
-                     *p++ = 0;
-                } else if(percent<(8.0f/9.0f)) {
-                     float local_percent = (percent - 7.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = (char)255;
-                     *p++ = 0;
-                     *p++ = (int)(local_percent*255);
-                } else {
-                     float local_percent = (percent - 8.0f/9.0f) / (1.0f/9.0f);
-                     *p++ = (int)((0.75f + 0.25f*(1.0f-local_percent))*255.0f);
-                     *p++ = (int)(local_percent*255.0f*0.5f);
-                     *p++ = (char)255;
-                }
-            }
+  if(w->waterfall_surface && w->waterfall_height>1) {
+    cairo_surface_flush(w->waterfall_surface);
+    guchar *pixels = cairo_image_surface_get_data (w->waterfall_surface);
+
+    int width=cairo_image_surface_get_width(w->waterfall_surface);
+    int height=cairo_image_surface_get_height(w->waterfall_surface);
+    int stride=cairo_image_surface_get_stride(w->waterfall_surface);
+
+    // the new line replaces the oldest one
+    w->waterfall_head=(w->waterfall_head+height-1)%height;
+    guint32 *row=(guint32 *)&pixels[w->waterfall_head*stride];
+
+    waterfall_palette_update(&w->waterfall_lut,PALETTE_DEFAULT,w->waterfall_low,w->waterfall_high);
+    int average=waterfall_palette_row(&w->waterfall_lut,&w->pixel_samples[w->pixels],MIN(w->pixels,width),0.0f,(float)w->waterfall_low,row);
+    if(w->pixels<width) {
+      memset(&row[w->pixels], 0, (width-w->pixels)*sizeof(guint32));
     }
 
-
     if(w->waterfall_automatic) {
       w->waterfall_low=average/(width-2);
       w->waterfall_high=w->waterfall_low+50;
     }
 
+    cairo_surface_mark_dirty_rectangle(w->waterfall_surface,0,w->waterfall_head,width,1);
     gtk_widget_queue_draw (w->waterfall);
   }
 }